@@ -1,27 +1,124 @@
 #include "Activation.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 Matrix activation::relu(const Matrix& A)
 {
-    Matrix copy = Matrix(A.get_rows(), A.get_cols());
-    for (int i = 0; i < copy.get_cols() * copy.get_rows(); i++)
+    return lazy::relu(A);
+}
+
+Matrix activation::softmax(const Matrix& A)
+{
+    Matrix copy = Matrix(A);
+    softmax_inplace(copy);
+    return copy;
+}
+
+// helper: grow-only per-thread scratch, so steady-state inference
+// allocates nothing
+static float* scratch(std::vector<float>& buffer, int n)
+{
+    if (static_cast<int>(buffer.size()) < n)
+    {
+        buffer.resize(n);
+    }
+    return buffer.data();
+}
+
+// helper: a single column is contiguous, so every step is one SIMD pass
+static void softmax_column(float* a, int rows, activation::softmax_mode mode)
+{
+    static thread_local std::vector<float> exp_buffer;
+    const simd::exp_accuracy accuracy = mode == activation::softmax_mode::fast
+                                        ? simd::exp_accuracy::fast
+                                        : simd::exp_accuracy::accurate;
+
+    simd::offset(a, -simd::max_value(a, rows), a, rows);
+    if (mode == activation::softmax_mode::log)
+    {
+        float* e = scratch(exp_buffer, rows);
+        simd::exp(a, e, rows, accuracy);
+        simd::offset(a, -std::log(simd::sum(e, rows)), a, rows);
+        return;
+    }
+    simd::exp(a, a, rows, accuracy);
+    simd::scale(a, 1 / simd::sum(a, rows), a, rows);
+}
+
+// helper: a batch is stored row-major with one entry per column, so the
+// per-column reductions run across whole rows at a time
+static void softmax_batch(float* a, int rows, int cols,
+                          activation::softmax_mode mode)
+{
+    static thread_local std::vector<float> buffer;
+    float* shift = scratch(buffer, 3 * cols);
+    float* sums = shift + cols;
+    float* e = sums + cols;
+    const simd::exp_accuracy accuracy = mode == activation::softmax_mode::fast
+                                        ? simd::exp_accuracy::fast
+                                        : simd::exp_accuracy::accurate;
+
+    std::copy(a, a + cols, shift);
+    for (int i = 1; i < rows; i++)
+    {
+        simd::max(a + i * cols, shift, shift, cols);
+    }
+    simd::scale(shift, -1, shift, cols);
+    std::fill(sums, sums + cols, 0.0f);
+
+    for (int i = 0; i < rows; i++)
     {
-        if (A[i] > 0)
+        float* row = a + i * cols;
+        simd::add(row, shift, row, cols);
+        if (mode == activation::softmax_mode::log)
+        {
+            simd::exp(row, e, cols, accuracy);
+            simd::add(sums, e, sums, cols);
+        }
+        else
         {
-            copy[i] = A[i];
+            simd::exp(row, row, cols, accuracy);
+            simd::add(sums, row, sums, cols);
         }
     }
-    return copy;
+
+    if (mode == activation::softmax_mode::log)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            sums[j] = -std::log(sums[j]);
+        }
+        for (int i = 0; i < rows; i++)
+        {
+            simd::add(a + i * cols, sums, a + i * cols, cols);
+        }
+        return;
+    }
+    for (int j = 0; j < cols; j++)
+    {
+        sums[j] = 1 / sums[j];
+    }
+    for (int i = 0; i < rows; i++)
+    {
+        simd::mul(a + i * cols, sums, a + i * cols, cols);
+    }
 }
 
-Matrix activation::softmax(const Matrix& A)
+void activation::softmax_inplace(Matrix& A, softmax_mode mode)
 {
-    Matrix copy = Matrix(A);
-    float c = 0.0;
-    for (int i = 0; i < copy.get_cols() * copy.get_rows(); i++)
+    if (mode == softmax_mode::argmax || A.get_rows() == 0
+        || A.get_cols() == 0)
     {
-        copy[i] = std::exp(A[i]);
-        c += std::exp(A[i]);
+        return;
     }
-    copy = copy * (1/c);
-    return copy;
-}
\ No newline at end of file
+    if (A.get_cols() == 1)
+    {
+        softmax_column(A.data(), A.get_rows(), mode);
+    }
+    else
+    {
+        softmax_batch(A.data(), A.get_rows(), A.get_cols(), mode);
+    }
+}
@@ -1,13 +1,38 @@
-
 #ifndef ACTIVATION_H
 #define ACTIVATION_H
 #include "Matrix.h"
 
+// Lazy, fusable forms of the activations live in activation::lazy
+// (MatrixExpr.h); the functions here stay plain so they can be used as
+// ActivationType pointers.
 namespace activation
 {
+    /**
+     * What softmax_inplace() leaves in the matrix:
+     * accurate - probabilities, exp within about 1 ulp
+     * fast     - probabilities, shorter exp polynomial (~4e-5 relative)
+     * log      - log-probabilities, log(softmax(A))
+     * argmax   - A untouched: the largest logit is the most probable class,
+     *            so classification can skip the exp entirely
+     */
+    enum class softmax_mode
+    {
+        accurate,
+        fast,
+        log,
+        argmax
+    };
+
     Matrix relu(const Matrix& A);
 
+    // Normalizes each column of A independently (one batch entry each)
     Matrix softmax(const Matrix& A);
+
+    // softmax() without the copy, overwriting A with its probabilities.
+    // Each column has its maximum subtracted first, so large logits do not
+    // overflow; needs no heap allocation once a thread has warmed up.
+    void softmax_inplace(Matrix& A,
+                         softmax_mode mode = softmax_mode::accurate);
 }
 
 #endif //ACTIVATION_H
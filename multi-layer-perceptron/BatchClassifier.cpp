@@ -0,0 +1,139 @@
+#include "BatchClassifier.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+BatchClassifier::WorkerState::WorkerState(const MlpNetwork& mlp, int chunk,
+                                          int pixels) :
+        ws(mlp, chunk), images(chunk, pixels), batch(pixels, chunk)
+{}
+
+BatchClassifier::BatchClassifier(const MlpNetwork& mlp, ThreadPool& pool,
+                                 int chunk_size) :
+        mlp(mlp), pool(pool), chunk_size(chunk_size)
+{
+    for (int i = 0; i < pool.size(); i++)
+    {
+        states.push_back(std::make_unique<WorkerState>(
+                mlp, chunk_size, mlp.get_input_size()));
+    }
+}
+
+void BatchClassifier::classify_chunk(const std::vector<std::string>& paths,
+                                     int start, int end,
+                                     std::vector<batch_result>& results)
+{
+    WorkerState& state = *states[pool.worker_index()];
+    const int pixels = mlp.get_input_size();
+
+    // read the readable images of the chunk, one per row
+    int count = 0;
+    for (int i = start; i < end; i++)
+    {
+        results[i].ok = read_image(paths[i],
+                                   state.images.data() + count * pixels,
+                                   pixels);
+        count += results[i].ok ? 1 : 0;
+    }
+    if (count == 0)
+    {
+        return;
+    }
+
+    // repack as one image per column for the batched pass
+    const float* src = state.images.data();
+    float* dst = state.batch.data();
+    for (int n = 0; n < count; n++)
+    {
+        for (int p = 0; p < pixels; p++)
+        {
+            dst[p * count + n] = src[n * pixels + p];
+        }
+    }
+    const std::vector<digit>& digits = mlp.classify_batch(
+            Matrix::view(dst, pixels, count), state.ws);
+
+    int n = 0;
+    for (int i = start; i < end; i++)
+    {
+        if (results[i].ok)
+        {
+            results[i].prediction = digits[n++];
+        }
+    }
+}
+
+int BatchClassifier::chunk_for(std::size_t count) const
+{
+    const std::size_t tasks = static_cast<std::size_t>(BATCH_TASKS_PER_WORKER)
+                              * pool.size();
+    const std::size_t chunk = (count + tasks - 1) / tasks;
+    return static_cast<int>(std::max<std::size_t>(
+            1, std::min<std::size_t>(chunk_size, chunk)));
+}
+
+std::vector<batch_result>
+BatchClassifier::classify(const std::vector<std::string>& paths)
+noexcept(false)
+{
+    std::vector<batch_result> results(paths.size(), batch_result{false, {}});
+    const int count = static_cast<int>(paths.size());
+    const int chunk = chunk_for(paths.size());
+    for (int start = 0; start < count; start += chunk)
+    {
+        const int end = std::min(start + chunk, count);
+        pool.submit([this, &paths, start, end, &results] {
+            classify_chunk(paths, start, end, results);
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+std::vector<std::string> BatchClassifier::list_images(const std::string& source)
+noexcept(false)
+{
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+
+    if (fs::is_directory(source))
+    {
+        for (const fs::directory_entry& entry : fs::directory_iterator(source))
+        {
+            if (entry.is_regular_file())
+            {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    std::ifstream list(source);
+    if (!list)
+    {
+        throw std::runtime_error(LIST_OPEN_ERROR);
+    }
+    std::string line;
+    while (std::getline(list, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            paths.push_back(line);
+        }
+    }
+    return paths;
+}
+
+bool BatchClassifier::read_image(const std::string& path, float* dst, int len)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) { return false; }
+
+    in.read(reinterpret_cast<char*>(dst), len * sizeof(float));
+    return in.good();
+}
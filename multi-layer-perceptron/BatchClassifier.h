@@ -0,0 +1,89 @@
+#ifndef BATCHCLASSIFIER_H
+#define BATCHCLASSIFIER_H
+
+#include "MlpNetwork.h"
+#include "ThreadPool.h"
+#include "Workspace.h"
+#include <memory>
+#include <string>
+#include <vector>
+#define BATCH_CHUNK 64              // images per task, at most
+#define BATCH_TASKS_PER_WORKER 4    // fewer tasks than this shrink the chunks
+#define LIST_OPEN_ERROR "Failed to open the image list"
+
+// Outcome of classifying one image of a batch run
+typedef struct batch_result
+{
+    bool ok;            // false if the image file could not be read
+    digit prediction;
+} batch_result;
+
+/**
+ * Classifies many image files in parallel. The paths are cut into chunks
+ * (see chunk_for()); each chunk is one ThreadPool task that reads its
+ * images and classifies them with a single batched pass through the
+ * shared, read-only MlpNetwork, using the Workspace of the worker that
+ * runs it. Results are returned in input order.
+ */
+class BatchClassifier
+{
+private:
+    // Scratch owned by one pool worker
+    struct WorkerState
+    {
+        Workspace ws;
+        Matrix images;      // chunk x pixels, one image per row as read
+        Matrix batch;       // pixels x chunk, one image per column
+
+        WorkerState(const MlpNetwork& mlp, int chunk, int pixels);
+    };
+
+    const MlpNetwork& mlp;
+    ThreadPool& pool;
+    int chunk_size;
+    std::vector<std::unique_ptr<WorkerState>> states;
+
+    void classify_chunk(const std::vector<std::string>& paths, int start,
+                        int end, std::vector<batch_result>& results);
+
+public:
+    /**
+     * @brief Prepares one Workspace per pool worker.
+     * @param mlp Network shared by all workers; must outlive this object.
+     * @param pool Pool running the chunks; must outlive this object.
+     * @param chunk_size Images per task (and per batched pass), at most.
+     */
+    BatchClassifier(const MlpNetwork& mlp, ThreadPool& pool,
+                    int chunk_size = BATCH_CHUNK);
+
+    /**
+     * @brief Images per task when classifying `count` paths: chunk_size,
+     * unless that leaves fewer than BATCH_TASKS_PER_WORKER tasks per
+     * worker, in which case the chunks shrink (down to one image) so that
+     * every worker has several tasks to take or steal.
+     */
+    int chunk_for(std::size_t count) const;
+
+    /**
+     * @brief Classifies every image file.
+     * @param paths Raw float image files of the network's input size.
+     * @return One result per path, in the same order.
+     */
+    std::vector<batch_result> classify(const std::vector<std::string>& paths)
+    noexcept(false);
+
+    /**
+     * @brief Expands a batch source into image paths.
+     * @param source A directory (its regular files, sorted by name) or a
+     * list file with one image path per line.
+     * @exception std::runtime_error Thrown if the list cannot be opened.
+     */
+    static std::vector<std::string> list_images(const std::string& source)
+    noexcept(false);
+
+    // Reads one raw float image of `len` pixels into dst; false if the
+    // file cannot be opened or is too short
+    static bool read_image(const std::string& path, float* dst, int len);
+};
+
+#endif //BATCHCLASSIFIER_H
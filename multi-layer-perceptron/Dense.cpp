@@ -1,26 +1,244 @@
 #include "Dense.h"
+#include "Gemm.h"
+#include "Simd.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
 
-Dense::Dense(const Matrix& W, const Matrix& b, ActivationType af)  :
-weights(W), bias(b), activation_func(af) {}
+// Grow-only per-thread list of the nonzero input indices
+static thread_local std::vector<int> nonzero_scratch;
 
-Matrix Dense::get_weights() const
+// helper: which part of the activation can be fused into the GEMM
+static FusedActivation fusable(ActivationType af)
+{
+    if (af == activation::relu)
+    {
+        return FusedActivation::relu;
+    }
+    if (af == activation::softmax)
+    {
+        return FusedActivation::softmax;
+    }
+    return FusedActivation::none;
+}
+
+Dense::SparsityCounters::SparsityCounters(const SparsityCounters& other)
+noexcept :
+        inputs(other.inputs.load()), nonzeros(other.nonzeros.load()),
+        sparse(other.sparse.load())
+{}
+
+Dense::SparsityCounters& Dense::SparsityCounters::operator=(
+        const SparsityCounters& other) noexcept
+{
+    inputs.store(other.inputs.load());
+    nonzeros.store(other.nonzeros.load());
+    sparse.store(other.sparse.load());
+    return *this;
+}
+
+Dense::Dense(Matrix W, Matrix b, ActivationType af)  :
+weights(std::move(W)), bias(std::move(b)), activation_func(af),
+fused(fusable(af)) {}
+
+const Matrix& Dense::get_weights() const
 {
     return this->weights;
 }
 
-Matrix Dense::get_bias() const
+const Matrix& Dense::get_bias() const
 {
     return this->bias;
 }
 
+void Dense::set_softmax_mode(activation::softmax_mode mode)
+{
+    output_mode = mode;
+}
+
+activation::softmax_mode Dense::get_softmax_mode() const
+{
+    return output_mode;
+}
+
 ActivationType Dense::get_activation() const
 {
     return this->activation_func;
 }
 
+void Dense::enable_sparse_input(float max_density)
+{
+    weights_t = Matrix(weights.get_cols(), weights.get_rows());
+    weights.transpose_into(weights_t);
+    sparse_density = max_density;
+}
+
+bool Dense::has_sparse_input() const
+{
+    return sparse_density > 0.0f;
+}
+
+sparsity_stats Dense::get_sparsity() const
+{
+    return sparsity_stats{counters.inputs.load(std::memory_order_relaxed),
+                          counters.nonzeros.load(std::memory_order_relaxed),
+                          counters.sparse.load(std::memory_order_relaxed)};
+}
+
+void Dense::reset_sparsity()
+{
+    counters.inputs.store(0, std::memory_order_relaxed);
+    counters.nonzeros.store(0, std::memory_order_relaxed);
+    counters.sparse.store(0, std::memory_order_relaxed);
+}
+
+matrix_dims Dense::get_dims() const
+{
+    return matrix_dims{weights.get_rows(), weights.get_cols()};
+}
+
 Matrix Dense::operator() (const Matrix& A) const
 {
-    Matrix to_be_activated = this->weights * A + this->bias;
-    return this->activation_func(to_be_activated);
+    Matrix out = Matrix(weights.get_rows(), A.get_cols());
+    (*this)(A, out);
+    return out;
 }
 
+// helper: the part of the activation the GEMM epilogue cannot do
+static void finish_activation(FusedActivation fused, ActivationType af,
+                              activation::softmax_mode mode, Matrix& out)
+{
+    if (fused == FusedActivation::softmax)
+    {
+        activation::softmax_inplace(out, mode);
+    }
+    else if (fused == FusedActivation::none)
+    {
+        // copy back rather than assign, so a view `out` keeps its memory
+        Matrix activated = af(out);
+        std::copy(activated.data(),
+                  activated.data() + out.get_rows() * out.get_cols(),
+                  out.data());
+    }
+}
+
+void Dense::operator() (const Matrix& A, Matrix& out) const noexcept(false)
+{
+    // A holds one input per column; a single column is the GEMV case.
+    if (A.get_cols() == 1)
+    {
+        forward(A, nullptr, 0, out, nullptr);
+        return;
+    }
+    if (weights.get_cols() != A.get_rows() ||
+        out.get_rows() != weights.get_rows() ||
+        out.get_cols() != A.get_cols())
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+
+    gemm::epilogue ep;
+    ep.bias = bias.data();
+    ep.relu = fused == FusedActivation::relu;
+    gemm::sgemm(weights.get_rows(), A.get_cols(), weights.get_cols(),
+                weights.data(), weights.get_cols(), 1,
+                A.data(), A.get_cols(), 1,
+                out.data(), out.get_cols(), ep);
+    finish_activation(fused, activation_func, output_mode, out);
+}
+
+int Dense::forward(const Matrix& x, const int* x_nz, int x_nnz, Matrix& out,
+                   int* out_nz) const noexcept(false)
+{
+    const int m = weights.get_rows();
+    const int k = weights.get_cols();
+    if (x.get_cols() != 1 || x.get_rows() != k ||
+        out.get_rows() != m || out.get_cols() != 1)
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+
+    gemm::epilogue ep;
+    ep.bias = bias.data();
+    ep.relu = fused == FusedActivation::relu;
+
+    if (has_sparse_input())
+    {
+        if (x_nz == nullptr)
+        {
+            // find the nonzeros once; sparse enough inputs skip the rest
+            if (static_cast<int>(nonzero_scratch.size()) < k)
+            {
+                nonzero_scratch.resize(k);
+            }
+            x_nnz = simd::nonzero(x.data(), k, nonzero_scratch.data());
+            x_nz = nonzero_scratch.data();
+        }
+        const bool sparse = x_nnz <= sparse_density * k;
+        counters.inputs.fetch_add(1, std::memory_order_relaxed);
+        counters.nonzeros.fetch_add(x_nnz, std::memory_order_relaxed);
+        if (sparse)
+        {
+            counters.sparse.fetch_add(1, std::memory_order_relaxed);
+            gemm::sgemv_sparse(m, weights_t.data(), m, x_nz, x_nnz,
+                               x.data(), out.data(), ep);
+        }
+        else
+        {
+            gemm::sgemv(m, k, weights.data(), k, x.data(), out.data(), ep);
+        }
+    }
+    else
+    {
+        gemm::sgemv(m, k, weights.data(), k, x.data(), out.data(), ep);
+    }
+    finish_activation(fused, activation_func, output_mode, out);
+
+    return out_nz == nullptr ? 0 : simd::nonzero(out.data(), m, out_nz);
+}
+
+void Dense::backward(const Matrix& A, const Matrix& out, Matrix& delta,
+                     Matrix& grad_w, Matrix& grad_b, Matrix* delta_in) const
+noexcept(false)
+{
+    const int m = weights.get_rows();
+    const int k = weights.get_cols();
+    const int n = A.get_cols();
+    if (fused == FusedActivation::none)
+    {
+        throw std::invalid_argument(UNTRAINABLE_ACTIVATION);
+    }
+    if (A.get_rows() != k || out.get_rows() != m || out.get_cols() != n ||
+        delta.get_rows() != m || delta.get_cols() != n ||
+        grad_w.get_rows() != m || grad_w.get_cols() != k ||
+        grad_b.get_rows() != m || grad_b.get_cols() != 1 ||
+        (delta_in != nullptr && (delta_in->get_rows() != k ||
+                                 delta_in->get_cols() != n)))
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+
+    // ReLU passes the gradient only where it let the value through
+    if (fused == FusedActivation::relu)
+    {
+        float* d = delta.data();
+        const float* o = out.data();
+        for (int i = 0; i < m * n; i++)
+        {
+            d[i] = o[i] > 0.0f ? d[i] : 0.0f;
+        }
+    }
+
+    // dW = delta A^T and dA = W^T delta: the transposes are strides
+    gemm::sgemm(m, k, n, delta.data(), n, 1, A.data(), 1, n,
+                grad_w.data(), k);
+    for (int i = 0; i < m; i++)
+    {
+        grad_b.data()[i] = simd::sum(delta.data() + i * n, n);
+    }
+    if (delta_in != nullptr)
+    {
+        gemm::sgemm(k, n, m, weights.data(), 1, k, delta.data(), n, 1,
+                    delta_in->data(), n);
+    }
+}
@@ -2,31 +2,154 @@
 #define DENSE_H
 #include "Matrix.h"
 #include "Activation.h"
+#include <atomic>
+// Inputs with at most this fraction of nonzeros take the sparse GEMV
+#define DENSE_SPARSE_DENSITY 0.5f
+#define UNTRAINABLE_ACTIVATION "Only ReLU and softmax layers can be trained"
 
 typedef Matrix (*ActivationType) (const Matrix& A);
 
+// How much of the activation the fused kernel can do in the GEMM epilogue
+enum class FusedActivation
+{
+    none,       // unknown function: bias is fused, activation applied after
+    relu,       // bias and ReLU both fused into the tile store
+    softmax     // bias fused, then softmax in-place on the output
+};
+
+// What the sparse path of a layer has seen since the last reset
+typedef struct sparsity_stats
+{
+    long long inputs;       // single input columns evaluated
+    long long nonzeros;     // nonzero entries, summed over those inputs
+    long long sparse;       // inputs sparse enough for the sparse kernel
+} sparsity_stats;
+
 class Dense {
 private:
     Matrix weights;
     Matrix bias;
     ActivationType activation_func;
+    FusedActivation fused;
+    activation::softmax_mode output_mode = activation::softmax_mode::accurate;
+    Matrix weights_t;               // column-major weights, sparse path only
+    float sparse_density = 0.0f;    // sparse path threshold; 0 = disabled
+
+    // Relaxed atomics, so concurrent inference can count; copying (or
+    // moving) a layer copies the current totals. noexcept keeps Dense
+    // nothrow-movable, so vectors of layers move instead of copying.
+    struct SparsityCounters
+    {
+        std::atomic<long long> inputs{0};
+        std::atomic<long long> nonzeros{0};
+        std::atomic<long long> sparse{0};
+
+        SparsityCounters() = default;
+        SparsityCounters(const SparsityCounters& other) noexcept;
+        SparsityCounters& operator=(const SparsityCounters& other) noexcept;
+    };
+    mutable SparsityCounters counters;
 
 public:
-    // Constructor
-    Dense(const Matrix &W, const Matrix &b, ActivationType af);
+    // Constructor; W and b are taken by value, so temporaries (and
+    // views) are moved in instead of copied
+    Dense(Matrix W, Matrix b, ActivationType af);
+
+    // Copies duplicate owned weights; moves only transfer the buffers
+    Dense(const Dense& other) = default;
+    Dense(Dense&& other) = default;
+    Dense& operator=(const Dense& other) = default;
+    Dense& operator=(Dense&& other) = default;
 
-    // Getter for the weights
-    Matrix get_weights() const;
+    // Getter for the weights (no copy)
+    const Matrix& get_weights() const;
 
-    // Getter for the bias
-    Matrix get_bias() const;
+    // Getter for the bias (no copy)
+    const Matrix& get_bias() const;
 
     // Getter for the activation
     ActivationType get_activation() const;
 
-    // Applying dense layer
+    // What a softmax layer leaves in its output (no effect on other
+    // activations); accurate probabilities by default
+    void set_softmax_mode(activation::softmax_mode mode);
+
+    // Getter for the softmax mode
+    activation::softmax_mode get_softmax_mode() const;
+
+    /**
+     * @brief Enables the sparse-input path: keeps a column-major copy of
+     * the weights (twice the weight memory) so that a single input column
+     * with at most `max_density` nonzeros is multiplied through only the
+     * weight columns of its nonzero entries. Batches and denser inputs
+     * keep the dense kernels; results are the same either way up to
+     * rounding.
+     */
+    void enable_sparse_input(float max_density = DENSE_SPARSE_DENSITY);
+
+    // Whether enable_sparse_input was called
+    bool has_sparse_input() const;
+
+    // Inputs and nonzeros seen by the sparse-input path (zero when it is
+    // disabled); nonzeros / (inputs * get_dims().cols) is the input density
+    sparsity_stats get_sparsity() const;
+
+    // Clears the get_sparsity() totals
+    void reset_sparsity();
+
+    // Getter for the weights' shape (output rows x input cols)
+    matrix_dims get_dims() const;
+
+    // Applying dense layer to one input per column of A
     Matrix operator() (const Matrix& A) const;
 
+    /**
+     * @brief Fused layer kernel: computes activation(W * A + b) in a single
+     * pass, adding the bias (and applying ReLU) while each output tile is
+     * still in registers, and writes the result straight into `out`.
+     * @param A Input, one column per batch entry.
+     * @param out Caller-provided output of shape
+     * (weights rows) x (A columns); overwritten.
+     * @exception std::invalid_argument Thrown if the shapes mismatch.
+     */
+    void operator() (const Matrix& A, Matrix& out) const noexcept(false);
+
+    /**
+     * @brief Single-input form of the fused kernel that passes activation
+     * sparsity from layer to layer: the nonzero rows of x, when already
+     * known, are not searched again, and the nonzero rows of the output are
+     * listed for the next layer.
+     * @param x Input column.
+     * @param x_nz The x_nnz nonzero rows of x in increasing order (e.g. the
+     * previous layer's out_nz), or nullptr to find them here.
+     * @param out Output column; overwritten.
+     * @param out_nz If not null, receives the nonzero rows of out; needs
+     * room for every row.
+     * @return The number of rows written to out_nz (0 if it is null).
+     * @exception std::invalid_argument Thrown if x is not a single column
+     * or the shapes mismatch.
+     */
+    int forward(const Matrix& x, const int* x_nz, int x_nnz, Matrix& out,
+                int* out_nz) const noexcept(false);
+
+    /**
+     * @brief Backward pass of operator()(A, out), for training.
+     * @param A The layer input, one column per sample.
+     * @param out The output the layer computed from A.
+     * @param delta On entry dL/d(out). A ReLU layer masks it in place to
+     * dL/dz, z = W A + b. A softmax layer (trained with cross-entropy)
+     * expects the combined dL/dz = out - one_hot(label) and keeps it.
+     * @param grad_w Receives dL/dW (the weights' shape); overwritten.
+     * @param grad_b Receives dL/db (the bias' shape); overwritten.
+     * @param delta_in If not null, receives dL/dA (A's shape), the delta
+     * of the previous layer.
+     * @exception std::invalid_argument Thrown if the shapes mismatch or
+     * the activation is neither ReLU nor softmax.
+     */
+    void backward(const Matrix& A, const Matrix& out, Matrix& delta,
+                  Matrix& grad_w, Matrix& grad_b, Matrix* delta_in) const
+    noexcept(false);
+
 };
 
 #endif //DENSE_H
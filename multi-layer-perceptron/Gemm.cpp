@@ -0,0 +1,517 @@
+#include "Gemm.h"
+#include "Simd.h"
+#include <algorithm>
+#include <new>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define PACK_ALIGNMENT 64
+
+namespace
+{
+    // C tile = Ap * Bp over kc steps, either stored or added into C, then
+    // (on the last kc block) bias[i] added and ReLU applied if requested.
+    typedef void (*MicroKernel)(int kc, const float* ap, const float* bp,
+                                float* c, int ldc, bool accumulate,
+                                const float* bias, bool relu);
+
+    typedef void (*GemvKernel)(int m, int k, const float* a, int lda,
+                               const float* x, float* y,
+                               const float* bias, bool relu);
+
+    typedef void (*SparseGemvKernel)(int m, const float* at, int ldat,
+                                     const int* idx, int nnz, const float* x,
+                                     float* y, const float* bias, bool relu);
+
+    inline float finish(float v, const float* bias, int i, bool relu)
+    {
+        if (bias != nullptr)
+        {
+            v += bias[i];
+        }
+        return (relu && v < 0.0f) ? 0.0f : v;
+    }
+
+    // Grow-only packing buffer, kept per thread and reused across calls so
+    // steady-state multiplication does not touch the heap.
+    class PackBuffer
+    {
+    private:
+        float* buffer = nullptr;
+        int capacity = 0;
+
+    public:
+        ~PackBuffer()
+        {
+            ::operator delete[](buffer, std::align_val_t(PACK_ALIGNMENT));
+        }
+
+        float* get(int size)
+        {
+            if (size > capacity)
+            {
+                ::operator delete[](buffer, std::align_val_t(PACK_ALIGNMENT));
+                buffer = static_cast<float*>(::operator new[](
+                        size * sizeof(float),
+                        std::align_val_t(PACK_ALIGNMENT)));
+                capacity = size;
+            }
+            return buffer;
+        }
+    };
+
+    thread_local PackBuffer packed_a;
+    thread_local PackBuffer packed_b;
+
+    // Copies an mc x kc block of A into GEMM_MR-row slivers, each stored
+    // column by column, zero-padding the last sliver.
+    void pack_a(int mc, int kc, const float* a, int rsa, int csa, float* ap)
+    {
+        for (int i0 = 0; i0 < mc; i0 += GEMM_MR)
+        {
+            int mr = std::min(GEMM_MR, mc - i0);
+            for (int p = 0; p < kc; p++)
+            {
+                for (int i = 0; i < mr; i++)
+                {
+                    ap[i] = a[(i0 + i) * rsa + p * csa];
+                }
+                for (int i = mr; i < GEMM_MR; i++)
+                {
+                    ap[i] = 0.0f;
+                }
+                ap += GEMM_MR;
+            }
+        }
+    }
+
+    // Copies a kc x nc panel of B into GEMM_NR-column slivers, each stored
+    // row by row, zero-padding the last sliver.
+    void pack_b(int kc, int nc, const float* b, int rsb, int csb, float* bp)
+    {
+        for (int j0 = 0; j0 < nc; j0 += GEMM_NR)
+        {
+            int nr = std::min(GEMM_NR, nc - j0);
+            for (int p = 0; p < kc; p++)
+            {
+                const float* row = b + p * rsb + j0 * csb;
+                if (csb == 1)
+                {
+                    std::copy(row, row + nr, bp);
+                }
+                else
+                {
+                    for (int j = 0; j < nr; j++)
+                    {
+                        bp[j] = row[j * csb];
+                    }
+                }
+                std::fill(bp + nr, bp + GEMM_NR, 0.0f);
+                bp += GEMM_NR;
+            }
+        }
+    }
+
+    void kernel_generic(int kc, const float* ap, const float* bp,
+                        float* c, int ldc, bool accumulate,
+                        const float* bias, bool relu)
+    {
+        float acc[GEMM_MR][GEMM_NR] = {};
+        for (int p = 0; p < kc; p++)
+        {
+            for (int i = 0; i < GEMM_MR; i++)
+            {
+                float ai = ap[i];
+                for (int j = 0; j < GEMM_NR; j++)
+                {
+                    acc[i][j] += ai * bp[j];
+                }
+            }
+            ap += GEMM_MR;
+            bp += GEMM_NR;
+        }
+        for (int i = 0; i < GEMM_MR; i++)
+        {
+            for (int j = 0; j < GEMM_NR; j++)
+            {
+                float v = accumulate ? c[i * ldc + j] + acc[i][j]
+                                     : acc[i][j];
+                c[i * ldc + j] = finish(v, bias, i, relu);
+            }
+        }
+    }
+
+    void gemv_generic(int m, int k, const float* a, int lda,
+                      const float* x, float* y,
+                      const float* bias, bool relu)
+    {
+        for (int i = 0; i < m; i++)
+        {
+            const float* row = a + i * lda;
+            float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+            int p = 0;
+            for (; p + 4 <= k; p += 4)
+            {
+                s0 += row[p] * x[p];
+                s1 += row[p + 1] * x[p + 1];
+                s2 += row[p + 2] * x[p + 2];
+                s3 += row[p + 3] * x[p + 3];
+            }
+            for (; p < k; p++)
+            {
+                s0 += row[p] * x[p];
+            }
+            y[i] = finish((s0 + s1) + (s2 + s3), bias, i, relu);
+        }
+    }
+
+    // One column of A (contiguous in `at`) per nonzero of x, accumulated
+    // into y; the compiler vectorizes the inner loop over the rows.
+    void gemv_sparse_generic(int m, const float* at, int ldat,
+                             const int* idx, int nnz, const float* x,
+                             float* y, const float* bias, bool relu)
+    {
+        std::fill(y, y + m, 0.0f);
+        for (int t = 0; t < nnz; t++)
+        {
+            const float xp = x[idx[t]];
+            const float* col = at + idx[t] * ldat;
+            for (int i = 0; i < m; i++)
+            {
+                y[i] += xp * col[i];
+            }
+        }
+        for (int i = 0; i < m; i++)
+        {
+            y[i] = finish(y[i], bias, i, relu);
+        }
+    }
+
+#ifdef SIMD_X86
+    // 6x16 tile: two 8-wide accumulators per row, 12 of the 16 ymm
+    // registers, leaving room for the two B vectors and the broadcast.
+    __attribute__((target("avx2,fma")))
+    void kernel_avx2(int kc, const float* ap, const float* bp,
+                     float* c, int ldc, bool accumulate,
+                     const float* bias, bool relu)
+    {
+        __m256 acc[GEMM_MR][2];
+        for (int i = 0; i < GEMM_MR; i++)
+        {
+            acc[i][0] = _mm256_setzero_ps();
+            acc[i][1] = _mm256_setzero_ps();
+        }
+        for (int p = 0; p < kc; p++)
+        {
+            __m256 b0 = _mm256_load_ps(bp);
+            __m256 b1 = _mm256_load_ps(bp + 8);
+            for (int i = 0; i < GEMM_MR; i++)
+            {
+                __m256 ai = _mm256_broadcast_ss(ap + i);
+                acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+                acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+            }
+            ap += GEMM_MR;
+            bp += GEMM_NR;
+        }
+        for (int i = 0; i < GEMM_MR; i++)
+        {
+            float* row = c + i * ldc;
+            if (accumulate)
+            {
+                acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(row));
+                acc[i][1] = _mm256_add_ps(acc[i][1],
+                                          _mm256_loadu_ps(row + 8));
+            }
+            if (bias != nullptr)
+            {
+                __m256 bi = _mm256_broadcast_ss(bias + i);
+                acc[i][0] = _mm256_add_ps(acc[i][0], bi);
+                acc[i][1] = _mm256_add_ps(acc[i][1], bi);
+            }
+            if (relu)
+            {
+                acc[i][0] = _mm256_max_ps(acc[i][0], _mm256_setzero_ps());
+                acc[i][1] = _mm256_max_ps(acc[i][1], _mm256_setzero_ps());
+            }
+            _mm256_storeu_ps(row, acc[i][0]);
+            _mm256_storeu_ps(row + 8, acc[i][1]);
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline float hsum_avx2(__m256 v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+                              _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_movehdup_ps(s));
+        return _mm_cvtss_f32(s);
+    }
+
+    // Four rows per pass share every load of x; two accumulators per row
+    // keep eight independent FMA chains in flight.
+    __attribute__((target("avx2,fma")))
+    void gemv_avx2(int m, int k, const float* a, int lda,
+                   const float* x, float* y,
+                   const float* bias, bool relu)
+    {
+        int i = 0;
+        for (; i + 4 <= m; i += 4)
+        {
+            const float* r0 = a + i * lda;
+            const float* r1 = r0 + lda;
+            const float* r2 = r1 + lda;
+            const float* r3 = r2 + lda;
+            __m256 s0 = _mm256_setzero_ps(), t0 = _mm256_setzero_ps();
+            __m256 s1 = _mm256_setzero_ps(), t1 = _mm256_setzero_ps();
+            __m256 s2 = _mm256_setzero_ps(), t2 = _mm256_setzero_ps();
+            __m256 s3 = _mm256_setzero_ps(), t3 = _mm256_setzero_ps();
+            int p = 0;
+            for (; p + 16 <= k; p += 16)
+            {
+                __m256 x0 = _mm256_loadu_ps(x + p);
+                __m256 x1 = _mm256_loadu_ps(x + p + 8);
+                s0 = _mm256_fmadd_ps(_mm256_loadu_ps(r0 + p), x0, s0);
+                t0 = _mm256_fmadd_ps(_mm256_loadu_ps(r0 + p + 8), x1, t0);
+                s1 = _mm256_fmadd_ps(_mm256_loadu_ps(r1 + p), x0, s1);
+                t1 = _mm256_fmadd_ps(_mm256_loadu_ps(r1 + p + 8), x1, t1);
+                s2 = _mm256_fmadd_ps(_mm256_loadu_ps(r2 + p), x0, s2);
+                t2 = _mm256_fmadd_ps(_mm256_loadu_ps(r2 + p + 8), x1, t2);
+                s3 = _mm256_fmadd_ps(_mm256_loadu_ps(r3 + p), x0, s3);
+                t3 = _mm256_fmadd_ps(_mm256_loadu_ps(r3 + p + 8), x1, t3);
+            }
+            for (; p + 8 <= k; p += 8)
+            {
+                __m256 x0 = _mm256_loadu_ps(x + p);
+                s0 = _mm256_fmadd_ps(_mm256_loadu_ps(r0 + p), x0, s0);
+                s1 = _mm256_fmadd_ps(_mm256_loadu_ps(r1 + p), x0, s1);
+                s2 = _mm256_fmadd_ps(_mm256_loadu_ps(r2 + p), x0, s2);
+                s3 = _mm256_fmadd_ps(_mm256_loadu_ps(r3 + p), x0, s3);
+            }
+            float y0 = hsum_avx2(_mm256_add_ps(s0, t0));
+            float y1 = hsum_avx2(_mm256_add_ps(s1, t1));
+            float y2 = hsum_avx2(_mm256_add_ps(s2, t2));
+            float y3 = hsum_avx2(_mm256_add_ps(s3, t3));
+            for (; p < k; p++)
+            {
+                y0 += r0[p] * x[p];
+                y1 += r1[p] * x[p];
+                y2 += r2[p] * x[p];
+                y3 += r3[p] * x[p];
+            }
+            y[i] = finish(y0, bias, i, relu);
+            y[i + 1] = finish(y1, bias, i + 1, relu);
+            y[i + 2] = finish(y2, bias, i + 2, relu);
+            y[i + 3] = finish(y3, bias, i + 3, relu);
+        }
+        if (i < m)
+        {
+            gemv_generic(m - i, k, a + i * lda, lda, x, y + i,
+                         bias == nullptr ? nullptr : bias + i, relu);
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void store_finished_avx2(float* y, __m256 v, const float* bias,
+                                    bool relu)
+    {
+        if (bias != nullptr)
+        {
+            v = _mm256_add_ps(v, _mm256_loadu_ps(bias));
+        }
+        if (relu)
+        {
+            v = _mm256_max_ps(v, _mm256_setzero_ps());
+        }
+        _mm256_storeu_ps(y, v);
+    }
+
+    // 64 rows of y stay in eight accumulators while every listed column
+    // streams past, so y is stored once instead of once per nonzero.
+    __attribute__((target("avx2,fma")))
+    void gemv_sparse_avx2(int m, const float* at, int ldat,
+                          const int* idx, int nnz, const float* x,
+                          float* y, const float* bias, bool relu)
+    {
+        int i = 0;
+        for (; i + 64 <= m; i += 64)
+        {
+            __m256 acc[8];
+            for (int r = 0; r < 8; r++)
+            {
+                acc[r] = _mm256_setzero_ps();
+            }
+            for (int t = 0; t < nnz; t++)
+            {
+                const __m256 xp = _mm256_set1_ps(x[idx[t]]);
+                const float* col = at + idx[t] * ldat + i;
+                for (int r = 0; r < 8; r++)
+                {
+                    acc[r] = _mm256_fmadd_ps(xp, _mm256_loadu_ps(col + 8 * r),
+                                             acc[r]);
+                }
+            }
+            for (int r = 0; r < 8; r++)
+            {
+                store_finished_avx2(y + i + 8 * r, acc[r],
+                                    bias == nullptr ? nullptr
+                                                    : bias + i + 8 * r,
+                                    relu);
+            }
+        }
+        for (; i + 8 <= m; i += 8)
+        {
+            __m256 acc = _mm256_setzero_ps();
+            for (int t = 0; t < nnz; t++)
+            {
+                acc = _mm256_fmadd_ps(_mm256_set1_ps(x[idx[t]]),
+                                      _mm256_loadu_ps(at + idx[t] * ldat + i),
+                                      acc);
+            }
+            store_finished_avx2(y + i, acc,
+                                bias == nullptr ? nullptr : bias + i, relu);
+        }
+        if (i < m)
+        {
+            gemv_sparse_generic(m - i, at + i, ldat, idx, nnz, x, y + i,
+                                bias == nullptr ? nullptr : bias + i, relu);
+        }
+    }
+#endif
+
+    bool has_avx2_fma()
+    {
+        return simd::active_isa() >= simd::isa::avx2;
+    }
+
+    MicroKernel micro_kernel()
+    {
+#ifdef SIMD_X86
+        static const MicroKernel kernel = has_avx2_fma() ? kernel_avx2
+                                                         : kernel_generic;
+#else
+        static const MicroKernel kernel = kernel_generic;
+#endif
+        return kernel;
+    }
+
+    GemvKernel gemv_kernel()
+    {
+#ifdef SIMD_X86
+        static const GemvKernel kernel = has_avx2_fma() ? gemv_avx2
+                                                        : gemv_generic;
+#else
+        static const GemvKernel kernel = gemv_generic;
+#endif
+        return kernel;
+    }
+
+    SparseGemvKernel gemv_sparse_kernel()
+    {
+#ifdef SIMD_X86
+        static const SparseGemvKernel kernel = has_avx2_fma()
+                                               ? gemv_sparse_avx2
+                                               : gemv_sparse_generic;
+#else
+        static const SparseGemvKernel kernel = gemv_sparse_generic;
+#endif
+        return kernel;
+    }
+}
+
+
+void gemm::sgemm(int m, int n, int k,
+                 const float* a, int rsa, int csa,
+                 const float* b, int rsb, int csb,
+                 float* c, int ldc, const epilogue& ep)
+{
+    if (k <= 0)
+    {
+        for (int i = 0; i < m; i++)
+        {
+            std::fill(c + i * ldc, c + i * ldc + n,
+                      finish(0.0f, ep.bias, i, ep.relu));
+        }
+        return;
+    }
+
+    MicroKernel kernel = micro_kernel();
+    int nc_max = std::min(n, GEMM_NC);
+    int kc_max = std::min(k, GEMM_KC);
+    int mc_max = std::min(m, GEMM_MC);
+    float* bp = packed_b.get(kc_max * ((nc_max + GEMM_NR - 1) / GEMM_NR)
+                             * GEMM_NR);
+    float* ap = packed_a.get(kc_max * ((mc_max + GEMM_MR - 1) / GEMM_MR)
+                             * GEMM_MR);
+    alignas(PACK_ALIGNMENT) float tile[GEMM_MR * GEMM_NR];
+
+    for (int jc = 0; jc < n; jc += GEMM_NC)
+    {
+        int nc = std::min(GEMM_NC, n - jc);
+        for (int pc = 0; pc < k; pc += GEMM_KC)
+        {
+            int kc = std::min(GEMM_KC, k - pc);
+            bool accumulate = pc > 0;
+            bool last = pc + kc == k;
+            pack_b(kc, nc, b + pc * rsb + jc * csb, rsb, csb, bp);
+
+            for (int ic = 0; ic < m; ic += GEMM_MC)
+            {
+                int mc = std::min(GEMM_MC, m - ic);
+                pack_a(mc, kc, a + ic * rsa + pc * csa, rsa, csa, ap);
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR)
+                {
+                    int nr = std::min(GEMM_NR, nc - jr);
+                    for (int ir = 0; ir < mc; ir += GEMM_MR)
+                    {
+                        int mr = std::min(GEMM_MR, mc - ir);
+                        float* ct = c + (ic + ir) * ldc + jc + jr;
+                        const float* a_sliver = ap + ir * kc;
+                        const float* b_sliver = bp + jr * kc;
+                        const float* bias = (last && ep.bias != nullptr)
+                                            ? ep.bias + ic + ir : nullptr;
+                        bool relu = last && ep.relu;
+
+                        if (mr == GEMM_MR && nr == GEMM_NR)
+                        {
+                            kernel(kc, a_sliver, b_sliver, ct, ldc,
+                                   accumulate, bias, relu);
+                            continue;
+                        }
+
+                        // Edge tile: compute the full register tile into
+                        // scratch and copy out only the valid part.
+                        kernel(kc, a_sliver, b_sliver, tile, GEMM_NR, false,
+                               nullptr, false);
+                        for (int i = 0; i < mr; i++)
+                        {
+                            for (int j = 0; j < nr; j++)
+                            {
+                                float v = tile[i * GEMM_NR + j];
+                                v = accumulate ? ct[i * ldc + j] + v : v;
+                                ct[i * ldc + j] = finish(v, bias, i, relu);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void gemm::sgemv(int m, int k, const float* a, int lda,
+                 const float* x, float* y, const epilogue& ep)
+{
+    gemv_kernel()(m, k, a, lda, x, y, ep.bias, ep.relu);
+}
+
+void gemm::sgemv_sparse(int m, const float* at, int ldat,
+                        const int* idx, int nnz, const float* x, float* y,
+                        const epilogue& ep)
+{
+    gemv_sparse_kernel()(m, at, ldat, idx, nnz, x, y, ep.bias, ep.relu);
+}
@@ -0,0 +1,74 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+// Register tile computed by one micro-kernel call (rows x cols of C).
+#define GEMM_MR 6
+#define GEMM_NR 16
+// Cache blocking: an MC x KC block of A stays in L2, a KC x NR sliver of
+// B stays in L1, and a KC x NC panel of B is shared by all A blocks.
+#define GEMM_MC 120
+#define GEMM_KC 256
+#define GEMM_NC 4096
+
+namespace gemm
+{
+    /**
+     * @brief Work fused into the final store of every C tile, while the
+     * tile is still in registers: c(i, j) = act(c(i, j) + bias[i]).
+     */
+    struct epilogue
+    {
+        const float* bias = nullptr;    // one value per row of C, or none
+        bool relu = false;              // clamp negative results to zero
+    };
+
+    /**
+     * @brief Computes C = A * B with cache blocking and a register-tiled
+     * micro-kernel.
+     * A and B are addressed through a row stride and a column stride,
+     * so a transposed operand costs nothing more than swapped strides.
+     * @param m Rows of A and C.
+     * @param n Columns of B and C.
+     * @param k Columns of A / rows of B.
+     * @param a Pointer to A, element (i, p) at a[i * rsa + p * csa].
+     * @param b Pointer to B, element (p, j) at b[p * rsb + j * csb].
+     * @param c Pointer to the row-major output, element (i, j) at
+     * c[i * ldc + j]. Its previous content is overwritten.
+     * @param ep Bias / activation applied to each finished tile.
+     */
+    void sgemm(int m, int n, int k,
+               const float* a, int rsa, int csa,
+               const float* b, int rsb, int csb,
+               float* c, int ldc, const epilogue& ep = epilogue());
+
+    /**
+     * @brief Computes y = A * x for a row-major A (the matrix-vector
+     * special case of sgemm, where packing would not pay off).
+     * @param m Rows of A and length of y.
+     * @param k Columns of A and length of x.
+     * @param a Pointer to A, element (i, p) at a[i * lda + p].
+     * @param x Input vector with unit stride.
+     * @param y Output vector with unit stride; overwritten.
+     * @param ep Bias / activation applied to each finished element.
+     */
+    void sgemv(int m, int k, const float* a, int lda,
+               const float* x, float* y, const epilogue& ep = epilogue());
+
+    /**
+     * @brief Computes y = A * x when most of x is zero, reading only the
+     * columns of A listed in `idx`. A is given column-major (as its
+     * row-major transpose), so every listed column is one contiguous run.
+     * @param m Rows of A and length of y.
+     * @param at Pointer to A, element (i, p) at at[p * ldat + i].
+     * @param idx The nnz indices p to accumulate, e.g. from
+     * simd::nonzero(x); any other entry of x is treated as zero.
+     * @param x Input vector with unit stride.
+     * @param y Output vector with unit stride; overwritten.
+     * @param ep Bias / activation applied to each finished element.
+     */
+    void sgemv_sparse(int m, const float* at, int ldat,
+                      const int* idx, int nnz, const float* x, float* y,
+                      const epilogue& ep = epilogue());
+}
+
+#endif //GEMM_H
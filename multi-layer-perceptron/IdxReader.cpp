@@ -0,0 +1,164 @@
+#include "IdxReader.h"
+#include "Simd.h"
+#include "Workspace.h"
+#include <algorithm>
+#include <limits>
+
+// Counts and dimensions are ints once read
+static const std::uint32_t IDX_MAX_FIELD = std::numeric_limits<int>::max();
+
+// helper: one big-endian 32-bit header field
+static bool read_be32(std::ifstream& in, std::uint32_t& value)
+{
+    unsigned char bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+    {
+        return false;
+    }
+    value = (std::uint32_t(bytes[0]) << 24) | (std::uint32_t(bytes[1]) << 16)
+            | (std::uint32_t(bytes[2]) << 8) | std::uint32_t(bytes[3]);
+    return true;
+}
+
+// helper: bytes left after the current position
+static std::streamoff bytes_left(std::ifstream& in)
+{
+    const std::streamoff here = in.tellg();
+    in.seekg(0, std::ios::end);
+    const std::streamoff end = in.tellg();
+    in.seekg(here);
+    return end - here;
+}
+
+IdxReader::IdxReader(const std::string& path) noexcept(false) :
+        in(path, std::ios::binary)
+{
+    if (!in)
+    {
+        throw std::runtime_error(IDX_OPEN_ERROR);
+    }
+    std::uint32_t magic, n, r, c;
+    if (!read_be32(in, magic) || magic != IDX_IMAGE_MAGIC
+        || !read_be32(in, n) || !read_be32(in, r) || !read_be32(in, c)
+        || r == 0 || c == 0 || n > IDX_MAX_FIELD || r > IDX_MAX_FIELD
+        || c > IDX_MAX_FIELD
+        || std::uint64_t(r) * c > IDX_MAX_FIELD)    // pixels per image
+    {
+        throw std::runtime_error(IDX_FORMAT_ERROR);
+    }
+    count = static_cast<int>(n);
+    rows = static_cast<int>(r);
+    cols = static_cast<int>(c);
+    if (bytes_left(in) < static_cast<std::streamoff>(count) * rows * cols)
+    {
+        throw std::runtime_error(IDX_FORMAT_ERROR);
+    }
+}
+
+int IdxReader::get_count() const
+{
+    return count;
+}
+
+int IdxReader::get_rows() const
+{
+    return rows;
+}
+
+int IdxReader::get_cols() const
+{
+    return cols;
+}
+
+int IdxReader::remaining() const
+{
+    return count - next;
+}
+
+int IdxReader::read(float* out, int max_images) noexcept(false)
+{
+    const int n = std::min(max_images, remaining());
+    if (n <= 0)
+    {
+        return 0;
+    }
+    const int pixels = rows * cols;
+    const std::size_t size = static_cast<std::size_t>(n) * pixels;
+    if (raw.size() < size)
+    {
+        raw.resize(size);
+        staging.resize(size);
+    }
+    if (!in.read(reinterpret_cast<char*>(raw.data()), size))
+    {
+        throw std::runtime_error(IDX_READ_ERROR);
+    }
+    next += n;
+
+    // widen as stored (one image per row), then turn images into columns
+    simd::u8_to_float(raw.data(), IDX_PIXEL_SCALE, staging.data(),
+                      static_cast<int>(size));
+    Matrix columns = Matrix::view(out, pixels, n);
+    Matrix::view(staging.data(), n, pixels).transpose_into(columns);
+    return n;
+}
+
+std::vector<std::uint8_t> IdxReader::read_labels(const std::string& path)
+noexcept(false)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error(IDX_OPEN_ERROR);
+    }
+    std::uint32_t magic, n;
+    if (!read_be32(in, magic) || magic != IDX_LABEL_MAGIC
+        || !read_be32(in, n) || n > IDX_MAX_FIELD)
+    {
+        throw std::runtime_error(IDX_FORMAT_ERROR);
+    }
+    // a corrupt count must not allocate more than the file holds
+    if (bytes_left(in) < static_cast<std::streamoff>(n))
+    {
+        throw std::runtime_error(IDX_FORMAT_ERROR);
+    }
+    std::vector<std::uint8_t> labels(n);
+    if (!in.read(reinterpret_cast<char*>(labels.data()), n))
+    {
+        throw std::runtime_error(IDX_READ_ERROR);
+    }
+    return labels;
+}
+
+accuracy_report IdxReader::evaluate(const MlpNetwork& mlp, IdxReader& images,
+                                    const std::vector<std::uint8_t>& labels,
+                                    int batch_size) noexcept(false)
+{
+    const int pixels = images.get_rows() * images.get_cols();
+    if (pixels != mlp.get_input_size())
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+    if (static_cast<int>(labels.size()) != images.get_count())
+    {
+        throw std::invalid_argument(IDX_LABEL_MISMATCH);
+    }
+
+    Workspace ws(mlp, batch_size);
+    std::vector<float> batch(static_cast<std::size_t>(pixels) * batch_size);
+    accuracy_report report{0, 0};
+    int first = images.get_count() - images.remaining();
+    int n;
+    while ((n = images.read(batch.data(), batch_size)) > 0)
+    {
+        const std::vector<digit>& digits = mlp.classify_batch(
+                Matrix::view(batch.data(), pixels, n), ws);
+        for (int i = 0; i < n; i++)
+        {
+            report.correct += digits[i].value == labels[first + i] ? 1 : 0;
+        }
+        report.total += n;
+        first += n;
+    }
+    return report;
+}
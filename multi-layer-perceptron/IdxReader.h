@@ -0,0 +1,95 @@
+#ifndef IDXREADER_H
+#define IDXREADER_H
+
+#include "Matrix.h"
+#include "MlpNetwork.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#define IDX_OPEN_ERROR "Failed to open the IDX file"
+#define IDX_FORMAT_ERROR "Not an IDX file of the expected type"
+#define IDX_READ_ERROR "Failed to read the IDX file"
+#define IDX_LABEL_MISMATCH "Image and label files hold different counts"
+#define IDX_IMAGE_MAGIC 0x00000803     // unsigned bytes, 3 dimensions
+#define IDX_LABEL_MAGIC 0x00000801     // unsigned bytes, 1 dimension
+#define IDX_PIXEL_SCALE (1.0f / 255.0f)
+#define IDX_BATCH 256
+
+// Result of evaluating a network on a labelled IDX set
+typedef struct accuracy_report
+{
+    int total;
+    int correct;
+} accuracy_report;
+
+/**
+ * Streams the images of an IDX file (the MNIST distribution format: a
+ * big-endian header, then count x rows x cols unsigned bytes). Images are
+ * read a batch at a time with one read call, widened to floats scaled by
+ * IDX_PIXEL_SCALE with SIMD, and transposed into the one-image-per-column
+ * layout of MlpNetwork::classify_batch.
+ */
+class IdxReader
+{
+private:
+    std::ifstream in;
+    int count = 0;
+    int rows = 0;
+    int cols = 0;
+    int next = 0;
+    std::vector<std::uint8_t> raw;      // one batch as stored
+    std::vector<float> staging;         // one image per row, as floats
+
+public:
+    /**
+     * @brief Opens the file and validates its header.
+     * @exception std::runtime_error Thrown if the file cannot be opened,
+     * is not an unsigned-byte image file, has a count, row/column size or
+     * image size beyond INT_MAX, or is shorter than its header claims.
+     */
+    explicit IdxReader(const std::string& path) noexcept(false);
+
+    // Number of images in the file
+    int get_count() const;
+
+    // Height and width of every image
+    int get_rows() const;
+
+    int get_cols() const;
+
+    // Images not read yet
+    int remaining() const;
+
+    /**
+     * @brief Reads the next min(max_images, remaining()) images into `out`
+     * as a pixels x n row-major block, column n holding image n.
+     * @param out Buffer of at least pixels * max_images floats.
+     * @return The number of images read; 0 at the end of the file.
+     * @exception std::runtime_error Thrown if the read fails.
+     */
+    int read(float* out, int max_images) noexcept(false);
+
+    /**
+     * @brief Reads a whole IDX label file (one byte per label).
+     * @exception std::runtime_error Thrown if the file cannot be opened,
+     * is not an unsigned-byte vector file or is shorter than its count
+     * (checked before anything is allocated).
+     */
+    static std::vector<std::uint8_t> read_labels(const std::string& path)
+    noexcept(false);
+
+    /**
+     * @brief Classifies every remaining image in batches of `batch_size`
+     * through MlpNetwork::classify_batch and counts the predictions that
+     * match `labels`.
+     * @exception std::invalid_argument Thrown if the image size differs
+     * from the network input or the label count from the image count.
+     */
+    static accuracy_report evaluate(const MlpNetwork& mlp, IdxReader& images,
+                                    const std::vector<std::uint8_t>& labels,
+                                    int batch_size = IDX_BATCH)
+    noexcept(false);
+};
+
+#endif //IDXREADER_H
@@ -0,0 +1,566 @@
+#include "InferenceServer.h"
+#include "Workspace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A non-blocking client socket. The I/O thread reads its requests and
+// sends its replies; workers append replies to the outbox. Requests still
+// waiting for their reply keep it alive; closed with the last owner.
+struct InferenceServer::Connection
+{
+    int fd;
+    // I/O thread only
+    std::vector<char> pending;          // bytes of an incomplete request
+    std::uint32_t next_sequence = 0;    // requests read
+    std::uint64_t sent_bytes = 0;       // reply bytes sent
+    bool closed = false;                // end of file: no more reads
+    bool broken = false;                // peer gone: no reads or replies
+    // shared with the workers
+    std::mutex write_lock;
+    std::vector<char> outbox;           // replies not sent yet; guarded by it
+
+    explicit Connection(int fd) : fd(fd)
+    {}
+
+    ~Connection()
+    {
+        ::close(fd);
+    }
+
+    // Requests read whose reply has not been sent completely
+    std::uint32_t in_flight() const
+    {
+        return next_sequence - static_cast<std::uint32_t>(
+                sent_bytes / sizeof(server_response));
+    }
+
+    // Sends what the socket takes without blocking; true if some of the
+    // outbox is left
+    bool flush()
+    {
+        std::lock_guard<std::mutex> guard(write_lock);
+        std::size_t done = 0;
+        while (!broken && done < outbox.size())
+        {
+            ssize_t n = ::send(fd, outbox.data() + done, outbox.size() - done,
+                               MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            if (n <= 0)
+            {
+                broken = true;
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        sent_bytes += done;
+        outbox.erase(outbox.begin(), outbox.begin() + done);
+        return !broken && !outbox.empty();
+    }
+};
+
+// helper: make a descriptor non-blocking
+static bool set_nonblocking(int fd)
+{
+    const int flags = ::fcntl(fd, F_GETFL);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// helper: write all of `size` bytes (SIGPIPE suppressed)
+static bool send_all(int fd, const void* data, std::size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        ssize_t n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+// helper: read exactly `size` bytes; false on EOF or error
+static bool recv_all(int fd, void* data, std::size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        ssize_t n = ::recv(fd, bytes, size, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+// helper: the address of a socket file
+static sockaddr_un socket_address(const std::string& path) noexcept(false)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument(SERVER_PATH_TOO_LONG);
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+// helper: unlink the socket file of a server that is gone; a path that
+// is not a socket, or one a server still accepts on, is never removed
+static void remove_stale_socket(const std::string& path,
+                                const sockaddr_un& address) noexcept(false)
+{
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0)
+    {
+        return;                         // nothing there; bind reports errors
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        throw std::runtime_error(SERVER_PATH_NOT_SOCKET);
+    }
+    int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0)
+    {
+        throw std::runtime_error(SERVER_SOCKET_ERROR);
+    }
+    const bool refused =
+            ::connect(probe, reinterpret_cast<const sockaddr*>(&address),
+                      sizeof(address)) != 0 && errno == ECONNREFUSED;
+    ::close(probe);
+    if (!refused)
+    {
+        throw std::runtime_error(SERVER_PATH_IN_USE);
+    }
+    ::unlink(path.c_str());
+}
+
+InferenceServer::InferenceServer(const MlpNetwork& mlp,
+                                 const std::string& socket_path,
+                                 server_options options) noexcept(false) :
+        mlp(mlp), path(socket_path), options(options)
+{
+    if (options.max_batch <= 0 || options.max_delay_us <= 0
+        || options.workers <= 0 || options.max_queue <= 0
+        || options.max_pending <= 0)
+    {
+        throw std::invalid_argument(SERVER_OPTIONS_ERROR);
+    }
+    const sockaddr_un address = socket_address(path);
+    remove_stale_socket(path, address);
+    if (::pipe(wake_pipe) != 0)
+    {
+        throw std::runtime_error(SERVER_SOCKET_ERROR);
+    }
+    // a full pipe already holds a wake-up: neither end may block
+    if (!set_nonblocking(wake_pipe[0]) || !set_nonblocking(wake_pipe[1]))
+    {
+        ::close(wake_pipe[0]);
+        ::close(wake_pipe[1]);
+        throw std::runtime_error(SERVER_SOCKET_ERROR);
+    }
+    listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0
+        || ::bind(listen_fd, reinterpret_cast<const sockaddr*>(&address),
+                  sizeof(address)) != 0
+        || ::listen(listen_fd, SOMAXCONN) != 0)
+    {
+        if (listen_fd >= 0)
+        {
+            ::close(listen_fd);
+        }
+        ::close(wake_pipe[0]);
+        ::close(wake_pipe[1]);
+        throw std::runtime_error(SERVER_SOCKET_ERROR);
+    }
+
+    io_thread = std::thread(&InferenceServer::run_io, this);
+    for (int i = 0; i < options.workers; i++)
+    {
+        workers.emplace_back(&InferenceServer::run_worker, this);
+    }
+}
+
+InferenceServer::~InferenceServer()
+{
+    stop();
+}
+
+void InferenceServer::stop()
+{
+    if (!io_thread.joinable())
+    {
+        return;
+    }
+    // no new requests; the I/O thread returns once every request read
+    // is answered and sent (or the drain times out), then the workers
+    {
+        std::lock_guard<std::mutex> guard(queue_lock);
+        draining = true;
+    }
+    queue_ready.notify_all();           // close partial batches now
+    wake_io();
+    io_thread.join();
+    {
+        std::lock_guard<std::mutex> guard(queue_lock);
+        stopping = true;
+        queue.clear();
+    }
+    queue_ready.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+
+    ::close(listen_fd);
+    ::close(wake_pipe[0]);
+    ::close(wake_pipe[1]);
+    ::unlink(path.c_str());
+}
+
+server_stats InferenceServer::get_stats() const
+{
+    return server_stats{requests.load(), batches.load(), peak_queue.load()};
+}
+
+void InferenceServer::wake_io()
+{
+    const char byte = 0;
+    while (::write(wake_pipe[1], &byte, 1) < 0 && errno == EINTR)
+    {}
+}
+
+void InferenceServer::run_io()
+{
+    const std::size_t request_bytes =
+            static_cast<std::size_t>(mlp.get_input_size()) * sizeof(float);
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<pollfd> fds;
+    std::vector<char> chunk(SERVER_READ_CHUNK);
+    std::vector<Request> incoming;
+    bool stop_reading = false;
+    std::chrono::steady_clock::time_point drain_deadline;
+
+    for (;;)
+    {
+        // replies first: whatever each socket takes without blocking
+        bool output_left = false;
+        for (const std::shared_ptr<Connection>& c : connections)
+        {
+            output_left = c->flush() || output_left;
+        }
+        // queued requests keep a finished connection open for their
+        // replies; a broken one just drops them
+        connections.erase(
+                std::remove_if(connections.begin(), connections.end(),
+                               [](const std::shared_ptr<Connection>& c) {
+                                   return c->broken || (c->closed
+                                                 && c->in_flight() == 0);
+                               }),
+                connections.end());
+
+        int queued, computing;
+        bool drain;
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            queued = static_cast<int>(queue.size());
+            computing = busy;
+            drain = draining;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (drain && !stop_reading)
+        {
+            stop_reading = true;
+            drain_deadline = now + std::chrono::milliseconds(SERVER_DRAIN_MS);
+        }
+        if (stop_reading && ((queued == 0 && computing == 0 && !output_left)
+                             || now >= drain_deadline))
+        {
+            break;                      // stop(): everything answered
+        }
+
+        // no reads from a connection (or at all) without room for its
+        // requests: the client blocks on its own socket buffer instead
+        fds.clear();
+        fds.push_back(pollfd{wake_pipe[0], POLLIN, 0});
+        fds.push_back(pollfd{stop_reading ? -1 : listen_fd, POLLIN, 0});
+        for (const std::shared_ptr<Connection>& c : connections)
+        {
+            short events = 0;
+            if (!stop_reading && !c->closed && queued < options.max_queue
+                && static_cast<int>(c->in_flight()) < options.max_pending)
+            {
+                events |= POLLIN;
+            }
+            {
+                std::lock_guard<std::mutex> guard(c->write_lock);
+                if (!c->outbox.empty())
+                {
+                    events |= POLLOUT;
+                }
+            }
+            fds.push_back(pollfd{c->fd, events, 0});
+        }
+        const int timeout = !stop_reading ? -1 : static_cast<int>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                        drain_deadline - now).count()) + 1;
+        if (::poll(fds.data(), fds.size(), timeout) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents != 0)
+        {
+            char bytes[64];
+            while (::read(wake_pipe[0], bytes, sizeof(bytes)) > 0)
+            {}
+        }
+
+        // complete requests are cut out of whatever each recv returned,
+        // reading no more than the connection and the queue have room for
+        const auto arrival = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i + 2 < fds.size(); i++)
+        {
+            Connection& c = *connections[i];
+            if (fds[i + 2].revents & (POLLERR | POLLHUP))
+            {
+                c.broken = true;        // the peer closed both directions
+                continue;
+            }
+            if (!(fds[i + 2].revents & POLLIN))
+            {
+                continue;
+            }
+            const int room = std::min(
+                    options.max_pending - static_cast<int>(c.in_flight()),
+                    options.max_queue - queued
+                    - static_cast<int>(incoming.size()));
+            if (room <= 0)
+            {
+                continue;
+            }
+            const std::size_t want = std::min(
+                    chunk.size(),
+                    static_cast<std::size_t>(room) * request_bytes
+                    - c.pending.size());
+            ssize_t n = ::recv(c.fd, chunk.data(), want, 0);
+            if (n <= 0)
+            {
+                if (n == 0)
+                {
+                    c.closed = true;
+                }
+                else if (errno != EINTR && errno != EAGAIN
+                         && errno != EWOULDBLOCK)
+                {
+                    c.broken = true;
+                }
+                continue;
+            }
+            c.pending.insert(c.pending.end(), chunk.data(), chunk.data() + n);
+            std::size_t used = 0;
+            for (; c.pending.size() - used >= request_bytes;
+                   used += request_bytes)
+            {
+                Request request{connections[i], c.next_sequence++,
+                                std::vector<float>(mlp.get_input_size()),
+                                arrival};
+                std::memcpy(request.pixels.data(), c.pending.data() + used,
+                            request_bytes);
+                incoming.push_back(std::move(request));
+            }
+            c.pending.erase(c.pending.begin(), c.pending.begin() + used);
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0 && set_nonblocking(fd))
+            {
+                connections.push_back(std::make_shared<Connection>(fd));
+            }
+            else if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+
+        if (!incoming.empty())
+        {
+            {
+                std::lock_guard<std::mutex> guard(queue_lock);
+                for (Request& request : incoming)
+                {
+                    queue.push_back(std::move(request));
+                }
+                peak_queue.store(std::max(peak_queue.load(),
+                                          static_cast<long long>(
+                                                  queue.size())),
+                                 std::memory_order_relaxed);
+            }
+            incoming.clear();
+            queue_ready.notify_all();
+        }
+    }
+}
+
+void InferenceServer::run_worker()
+{
+    const int pixels = mlp.get_input_size();
+    const int max_batch = options.max_batch;
+    Workspace ws(mlp, max_batch);
+    std::vector<float> rows(static_cast<std::size_t>(pixels) * max_batch);
+    std::vector<float> columns(rows.size());
+    std::vector<Request> batch;
+    batch.reserve(max_batch);
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_lock);
+            queue_ready.wait(lock, [this] {
+                return stopping || !queue.empty();
+            });
+            if (stopping)
+            {
+                return;                 // drained (or given up) by stop()
+            }
+            // the oldest request sets the deadline of the whole batch
+            const auto deadline = queue.front().arrival
+                                  + std::chrono::microseconds(
+                                          options.max_delay_us);
+            queue_ready.wait_until(lock, deadline, [this, max_batch] {
+                return stopping || draining
+                       || static_cast<int>(queue.size()) >= max_batch;
+            });
+            while (!queue.empty() && static_cast<int>(batch.size())
+                                     < max_batch)
+            {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            if (!queue.empty())
+            {
+                queue_ready.notify_one();   // the rest for another worker
+            }
+            busy += batch.empty() ? 0 : 1;
+        }
+        if (batch.empty())
+        {
+            continue;                   // another worker took them
+        }
+
+        // one image per row as received, then one per column
+        const int n = static_cast<int>(batch.size());
+        for (int j = 0; j < n; j++)
+        {
+            std::copy(batch[j].pixels.begin(), batch[j].pixels.end(),
+                      rows.data() + static_cast<std::size_t>(j) * pixels);
+        }
+        Matrix images = Matrix::view(columns.data(), pixels, n);
+        Matrix::view(rows.data(), n, pixels).transpose_into(images);
+        const std::vector<digit>& digits = mlp.classify_batch(images, ws);
+
+        // the I/O thread sends them: a client that does not read its
+        // replies never blocks a worker
+        for (int j = 0; j < n; j++)
+        {
+            Connection& c = *batch[j].connection;
+            const server_response reply{batch[j].sequence, digits[j].value,
+                                        digits[j].probability};
+            const char* bytes = reinterpret_cast<const char*>(&reply);
+            std::lock_guard<std::mutex> guard(c.write_lock);
+            c.outbox.insert(c.outbox.end(), bytes, bytes + sizeof(reply));
+        }
+        requests.fetch_add(n, std::memory_order_relaxed);
+        batches.fetch_add(1, std::memory_order_relaxed);
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            busy--;
+        }
+        wake_io();
+    }
+}
+
+InferenceClient::InferenceClient(const std::string& socket_path)
+noexcept(false)
+{
+    const sockaddr_un address = socket_address(socket_path);
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                            sizeof(address)) != 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        throw std::runtime_error(CLIENT_CONNECT_ERROR);
+    }
+}
+
+InferenceClient::~InferenceClient()
+{
+    ::close(fd);
+}
+
+std::uint32_t InferenceClient::send(const Matrix& img) noexcept(false)
+{
+    if (!send_all(fd, img.data(), static_cast<std::size_t>(img.get_rows())
+                                  * img.get_cols() * sizeof(float)))
+    {
+        throw std::runtime_error(CLIENT_IO_ERROR);
+    }
+    return sent++;
+}
+
+server_response InferenceClient::receive() noexcept(false)
+{
+    server_response reply{};
+    if (!recv_all(fd, &reply, sizeof(reply)))
+    {
+        throw std::runtime_error(CLIENT_IO_ERROR);
+    }
+    return reply;
+}
+
+digit InferenceClient::classify(const Matrix& img) noexcept(false)
+{
+    send(img);
+    const server_response reply = receive();
+    return digit{reply.value, reply.probability};
+}
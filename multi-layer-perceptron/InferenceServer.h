@@ -0,0 +1,185 @@
+#ifndef INFERENCESERVER_H
+#define INFERENCESERVER_H
+
+#include "MlpNetwork.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#define SERVER_SOCKET_ERROR "Failed to listen on the server socket"
+#define SERVER_OPTIONS_ERROR "Server batch, delay, workers and limits must "\
+                             "be positive"
+#define SERVER_PATH_TOO_LONG "Socket path is too long"
+#define SERVER_PATH_NOT_SOCKET "Socket path exists and is not a socket"
+#define SERVER_PATH_IN_USE "Another server is listening on the socket path"
+#define CLIENT_CONNECT_ERROR "Failed to connect to the server socket"
+#define CLIENT_IO_ERROR "Connection to the server failed"
+#define SERVER_READ_CHUNK (1 << 16)    // bytes read per recv call
+#define SERVER_DRAIN_MS 2000            // longest stop() wait for replies
+
+// Batching policy of an InferenceServer
+typedef struct server_options
+{
+    int max_batch = 64;         // requests per classify_batch call
+    int max_delay_us = 2000;    // longest wait of a request for a full batch
+    int workers = 1;            // batches computed concurrently
+    int max_queue = 1024;       // queued requests before all reads pause
+    int max_pending = 256;      // unanswered requests of one connection
+                                // before its reads pause
+} server_options;
+
+// Totals since the server started
+typedef struct server_stats
+{
+    long long requests;
+    long long batches;          // requests / batches = mean batch size
+    long long peak_queue;       // most requests ever queued at once
+} server_stats;
+
+// One reply on the wire (native byte order: the socket is host-local)
+typedef struct server_response
+{
+    std::uint32_t sequence;     // index of the request on its connection
+    std::uint32_t value;
+    float probability;
+} server_response;
+
+/**
+ * Long-running classifier behind a Unix domain socket. A request is one
+ * raw image, get_input_size() native floats (the layout of the CLI image
+ * files); any number may be pipelined on a connection without waiting.
+ * An I/O thread polls every connection and queues complete requests;
+ * worker threads coalesce the queue into micro-batches, closed when
+ * max_batch requests are waiting or the oldest has waited max_delay_us,
+ * and run them through the shared network with one Workspace each. Each
+ * reply is a server_response, handed back to the I/O thread as soon as
+ * its batch finishes and sent without blocking; with several workers,
+ * replies on one connection may overtake each other and are matched by
+ * sequence number.
+ * Memory is bounded: the I/O thread stops reading a connection with
+ * max_pending unanswered requests (e.g. a client that never reads its
+ * replies) and stops reading altogether while max_queue requests wait,
+ * so slow clients are throttled by their own socket buffers.
+ */
+class InferenceServer
+{
+private:
+    struct Connection;
+
+    struct Request
+    {
+        std::shared_ptr<Connection> connection;
+        std::uint32_t sequence;
+        std::vector<float> pixels;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    const MlpNetwork& mlp;
+    std::string path;
+    server_options options;
+    int listen_fd = -1;
+    int wake_pipe[2] = {-1, -1};        // wakes the I/O thread (replies,
+                                        // room in the queue, stop())
+
+    std::mutex queue_lock;
+    std::condition_variable queue_ready;
+    std::deque<Request> queue;
+    int busy = 0;                       // workers computing a batch
+    bool draining = false;              // stop(): no new requests
+    bool stopping = false;              // stop(): workers exit
+
+    std::atomic<long long> requests{0};
+    std::atomic<long long> batches{0};
+    std::atomic<long long> peak_queue{0};
+    std::thread io_thread;
+    std::vector<std::thread> workers;
+
+    // helper: make poll() in the I/O thread return (never blocks)
+    void wake_io();
+
+    // helper: accept connections, read requests and send replies until
+    // stop() has drained them
+    void run_io();
+
+    // helper: take micro-batches off the queue and answer them
+    void run_worker();
+
+public:
+    /**
+     * @brief Binds `socket_path` and starts serving. A socket file left
+     * there by a server that is gone (connecting is refused) is replaced;
+     * anything else at the path is left alone. `mlp` must outlive the
+     * server.
+     * @exception std::invalid_argument Thrown if the options are not
+     * positive.
+     * @exception std::runtime_error Thrown if the path holds something
+     * other than a socket, another server is listening on it, or the
+     * socket cannot be created, bound or listened on.
+     */
+    InferenceServer(const MlpNetwork& mlp, const std::string& socket_path,
+                    server_options options = server_options())
+    noexcept(false);
+
+    // Stops serving (see stop())
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    /**
+     * @brief Stops accepting and reading, answers the requests already
+     * read (waiting at most SERVER_DRAIN_MS for clients to take their
+     * replies), joins the threads and removes the socket file.
+     * Idempotent.
+     */
+    void stop();
+
+    server_stats get_stats() const;
+};
+
+/**
+ * Blocking client of an InferenceServer, e.g. for tests and tools. send()
+ * and receive() may be interleaved freely to pipeline requests.
+ */
+class InferenceClient
+{
+private:
+    int fd = -1;
+    std::uint32_t sent = 0;
+
+public:
+    /**
+     * @brief Connects to the server socket.
+     * @exception std::runtime_error Thrown if the connection fails.
+     */
+    explicit InferenceClient(const std::string& socket_path) noexcept(false);
+
+    ~InferenceClient();
+
+    InferenceClient(const InferenceClient&) = delete;
+    InferenceClient& operator=(const InferenceClient&) = delete;
+
+    /**
+     * @brief Sends one image (every entry of `img`, row by row).
+     * @return The sequence number its reply will carry.
+     * @exception std::runtime_error Thrown if the write fails.
+     */
+    std::uint32_t send(const Matrix& img) noexcept(false);
+
+    /**
+     * @brief Waits for the next reply.
+     * @exception std::runtime_error Thrown if the connection closes.
+     */
+    server_response receive() noexcept(false);
+
+    // send() then receive(), for one request at a time
+    digit classify(const Matrix& img) noexcept(false);
+};
+
+#endif //INFERENCESERVER_H
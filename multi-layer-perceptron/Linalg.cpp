@@ -0,0 +1,197 @@
+#include "Linalg.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// helper: magnitude below which a pivot candidate counts as zero
+static float pivot_tolerance(const float* a, int rows, int cols, int ld)
+{
+    float largest = 0.0f;
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            largest = std::max(largest, std::abs(a[i * ld + j]));
+        }
+    }
+    return largest * std::numeric_limits<float>::epsilon()
+           * std::max(rows, cols);
+}
+
+// helper: row index of the largest |a(i, col)| over rows [first, rows)
+static int pivot_row(const float* a, int rows, int ld, int first, int col)
+{
+    int best = first;
+    for (int i = first + 1; i < rows; i++)
+    {
+        if (std::abs(a[i * ld + col]) > std::abs(a[best * ld + col]))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// helper: y += alpha * x; rows shorter than a couple of vectors stay
+// inline, where the dispatched call would cost more than the arithmetic
+static inline void row_axpy(float alpha, const float* x, float* y, int n)
+{
+    if (n >= LINALG_SIMD_MIN)
+    {
+        simd::axpy(alpha, x, y, n);
+        return;
+    }
+    for (int j = 0; j < n; j++)
+    {
+        y[j] += alpha * x[j];
+    }
+}
+
+// helper: runs update(first, last) over [first, last), split into one
+// chunk per worker when the step is large enough to pay for the tasks
+template<typename F>
+static void for_rows(ThreadPool* pool, int first, int last, int width,
+                     const F& update)
+{
+    const long work = static_cast<long>(last - first) * width;
+    if (pool == nullptr || pool->size() < 2 || work < LINALG_PARALLEL_MIN)
+    {
+        update(first, last);
+        return;
+    }
+    const int chunks = std::min(pool->size(), last - first);
+    for (int c = 0; c < chunks; c++)
+    {
+        const int begin = first + (last - first) * c / chunks;
+        const int end = first + (last - first) * (c + 1) / chunks;
+        pool->submit([&update, begin, end] { update(begin, end); });
+    }
+    pool->wait();
+}
+
+int linalg::eliminate(float* a, int rows, int cols, int ld, bool reduced,
+                      ThreadPool* pool)
+{
+    const float tolerance = pivot_tolerance(a, rows, cols, ld);
+    int rank = 0;
+    for (int col = 0; col < cols && rank < rows; col++)
+    {
+        const int p = pivot_row(a, rows, ld, rank, col);
+        if (std::abs(a[p * ld + col]) <= tolerance)
+        {
+            for (int i = rank; i < rows; i++)
+            {
+                a[i * ld + col] = 0.0f;
+            }
+            continue;
+        }
+        float* pivot = a + rank * ld;
+        if (p != rank)
+        {
+            std::swap_ranges(pivot + col, pivot + cols, a + p * ld + col);
+        }
+        const float inverse = 1 / pivot[col];
+        const int width = cols - col - 1;
+        if (reduced)
+        {
+            simd::scale(pivot + col + 1, inverse, pivot + col + 1, width);
+            pivot[col] = 1.0f;
+        }
+
+        // every other row (reduced) or every row below (echelon form)
+        const int r = rank;
+        auto update = [=](int begin, int end) {
+            for (int i = begin; i < end; i++)
+            {
+                float* row = a + i * ld;
+                if (i == r || row[col] == 0.0f)
+                {
+                    continue;
+                }
+                const float factor = reduced ? row[col] : row[col] * inverse;
+                row_axpy(-factor, pivot + col + 1, row + col + 1, width);
+                row[col] = 0.0f;
+            }
+        };
+        for_rows(pool, reduced ? 0 : rank + 1, rows, width, update);
+        ++rank;
+    }
+    return rank;
+}
+
+bool linalg::lu_factor(float* a, int n, int ld, int* perm, ThreadPool* pool)
+{
+    const float tolerance = pivot_tolerance(a, n, n, ld);
+    for (int i = 0; i < n; i++)
+    {
+        perm[i] = i;
+    }
+    for (int k = 0; k < n; k++)
+    {
+        const int p = pivot_row(a, n, ld, k, k);
+        if (std::abs(a[p * ld + k]) <= tolerance)
+        {
+            return false;
+        }
+        float* pivot = a + k * ld;
+        if (p != k)
+        {
+            // whole rows, so the stored multipliers follow their rows
+            std::swap_ranges(pivot, pivot + n, a + p * ld);
+            std::swap(perm[k], perm[p]);
+        }
+        const float inverse = 1 / pivot[k];
+        const int width = n - k - 1;
+        auto update = [=](int begin, int end) {
+            for (int i = begin; i < end; i++)
+            {
+                float* row = a + i * ld;
+                row[k] *= inverse;
+                row_axpy(-row[k], pivot + k + 1, row + k + 1, width);
+            }
+        };
+        for_rows(pool, k + 1, n, width, update);
+    }
+    return true;
+}
+
+void linalg::lu_solve(const float* lu, int n, int ld, const int* perm,
+                      float* b, int ldb, int nrhs)
+{
+    // B <- P B, one contiguous row at a time
+    std::vector<float> permuted(static_cast<size_t>(n) * nrhs);
+    for (int i = 0; i < n; i++)
+    {
+        std::memcpy(permuted.data() + static_cast<size_t>(i) * nrhs,
+                    b + static_cast<size_t>(perm[i]) * ldb,
+                    nrhs * sizeof(float));
+    }
+    for (int i = 0; i < n; i++)
+    {
+        std::memcpy(b + static_cast<size_t>(i) * ldb,
+                    permuted.data() + static_cast<size_t>(i) * nrhs,
+                    nrhs * sizeof(float));
+    }
+
+    // forward substitution with the unit lower triangle: L Y = P B
+    for (int k = 0; k < n; k++)
+    {
+        for (int i = k + 1; i < n; i++)
+        {
+            row_axpy(-lu[i * ld + k], b + k * ldb, b + i * ldb, nrhs);
+        }
+    }
+    // back substitution with the upper triangle: U X = Y
+    for (int k = n - 1; k >= 0; k--)
+    {
+        simd::scale(b + k * ldb, 1 / lu[k * ld + k], b + k * ldb, nrhs);
+        for (int i = 0; i < k; i++)
+        {
+            row_axpy(-lu[i * ld + k], b + k * ldb, b + i * ldb, nrhs);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef LINALG_H
+#define LINALG_H
+
+// Row updates of one elimination step run on the thread pool only when
+// they touch at least this many elements; below it the task overhead
+// outweighs the work.
+#define LINALG_PARALLEL_MIN (1 << 16)
+// Shorter row updates skip the SIMD dispatch
+#define LINALG_SIMD_MIN 32
+
+class ThreadPool;
+
+namespace linalg
+{
+    /**
+     * @brief Gaussian elimination with partial pivoting, in place on a
+     * row-major rows x cols block. Each step picks the largest remaining
+     * entry of the column as pivot; a column whose largest entry is below
+     * max|a| * epsilon * max(rows, cols) has no pivot and is zeroed.
+     * Row updates are SIMD AXPYs, split over `pool` for large matrices.
+     * @param a Pointer to the block, element (i, j) at a[i * ld + j].
+     * @param reduced True for reduced row echelon form (pivots scaled to 1,
+     * entries above them eliminated too); false stops at row echelon form.
+     * @param pool Optional pool for the row updates; must not be the pool
+     * this call runs on.
+     * @return The number of pivots, i.e. the rank.
+     */
+    int eliminate(float* a, int rows, int cols, int ld, bool reduced,
+                  ThreadPool* pool = nullptr);
+
+    /**
+     * @brief LU factorization with partial pivoting, P A = L U, in place
+     * on a row-major n x n block: U on and above the diagonal, the
+     * multipliers of the unit lower-triangular L below it.
+     * @param perm Receives n entries; row i of P A is row perm[i] of A.
+     * @param pool Optional pool for the row updates (see eliminate()).
+     * @return False if A is singular to working precision (a is then
+     * partially factored).
+     */
+    bool lu_factor(float* a, int n, int ld, int* perm,
+                   ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Solves A X = B from the factors of lu_factor(), overwriting
+     * the row-major n x nrhs block b with X.
+     */
+    void lu_solve(const float* lu, int n, int ld, const int* perm,
+                  float* b, int ldb, int nrhs);
+}
+
+#endif //LINALG_H
@@ -0,0 +1,56 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) noexcept(false)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::string(MAP_OPEN_ERROR) + ": " + path);
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error(std::string(MAP_ERROR) + ": " + path);
+    }
+    length = static_cast<std::size_t>(st.st_size);
+
+    if (length > 0)
+    {
+        base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            base = nullptr;
+            ::close(fd);
+            throw std::runtime_error(std::string(MAP_ERROR) + ": " + path);
+        }
+        // weights are read front to back on the first inference
+        ::madvise(base, length, MADV_WILLNEED);
+    }
+    // the mapping keeps the file referenced
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (base != nullptr)
+    {
+        ::munmap(base, length);
+    }
+}
+
+const void* MappedFile::data() const
+{
+    return this->base;
+}
+
+std::size_t MappedFile::size() const
+{
+    return this->length;
+}
@@ -0,0 +1,44 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#define MAP_OPEN_ERROR "Failed to open the file for mapping"
+#define MAP_ERROR "Failed to memory-map the file"
+
+/**
+ * Read-only, shared memory mapping of a whole file (POSIX mmap). The pages
+ * come straight from the page cache, so every process mapping the same
+ * file shares one physical copy and nothing is read up front.
+ */
+class MappedFile
+{
+private:
+    void* base = nullptr;
+    std::size_t length = 0;
+
+public:
+    /**
+     * @brief Maps the file.
+     * @param path File to map.
+     * @exception std::runtime_error Thrown if the file cannot be opened,
+     * sized or mapped.
+     */
+    explicit MappedFile(const std::string& path) noexcept(false);
+
+    /**
+     * @brief Unmaps the file; views into it become dangling.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Start of the mapping (page aligned), nullptr for an empty file
+    const void* data() const;
+
+    // Size of the file in bytes
+    std::size_t size() const;
+};
+
+#endif //MAPPEDFILE_H
@@ -0,0 +1,44 @@
+#include "MappedWeights.h"
+
+MappedWeights::MappedWeights(const std::vector<std::string>& layer_files)
+noexcept(false)
+{
+    if (layer_files.size() != 2 * MLP_SIZE)
+    {
+        throw std::runtime_error(DIMENSIONS_EXCEPTION);
+    }
+
+    weights.reserve(MLP_SIZE);
+    biases.reserve(MLP_SIZE);
+    for (int i = 0; i < MLP_SIZE; i++)
+    {
+        weights.push_back(map_matrix(layer_files[i], weights_dims[i]));
+        biases.push_back(map_matrix(layer_files[MLP_SIZE + i], bias_dims[i]));
+    }
+}
+
+Matrix MappedWeights::map_matrix(const std::string& path, matrix_dims dims)
+noexcept(false)
+{
+    files.push_back(std::make_unique<MappedFile>(path));
+    const MappedFile& file = *files.back();
+
+    std::size_t needed = static_cast<std::size_t>(dims.rows) * dims.cols
+                         * sizeof(float);
+    if (file.size() < needed)
+    {
+        throw std::length_error(FILE_TOO_SHORT);
+    }
+    return Matrix::view(static_cast<const float*>(file.data()),
+                        dims.rows, dims.cols);
+}
+
+const Matrix* MappedWeights::get_weights() const
+{
+    return weights.data();
+}
+
+const Matrix* MappedWeights::get_biases() const
+{
+    return biases.data();
+}
@@ -0,0 +1,48 @@
+#ifndef MAPPEDWEIGHTS_H
+#define MAPPEDWEIGHTS_H
+
+#include "MappedFile.h"
+#include "MlpNetwork.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Zero-copy loader for the eight raw weight/bias files. Each file is
+ * memory-mapped and exposed as a Matrix view of the shape given by
+ * weights_dims / bias_dims; an MlpNetwork built from these views keeps
+ * them as views, so the weights are never read into private memory and
+ * worker processes on one host share the page cache.
+ * The MappedWeights must outlive every network built from it.
+ */
+class MappedWeights
+{
+private:
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<Matrix> weights;
+    std::vector<Matrix> biases;
+
+    // helper: map one file and view it with the given shape
+    Matrix map_matrix(const std::string& path, matrix_dims dims)
+    noexcept(false);
+
+public:
+    /**
+     * @brief Maps the layer files.
+     * @param layer_files w1..w4 followed by b1..b4.
+     * @exception std::length_error Thrown if a file is shorter than its
+     * matrix.
+     * @exception std::runtime_error Thrown if a file cannot be mapped or
+     * the number of files is wrong.
+     */
+    explicit MappedWeights(const std::vector<std::string>& layer_files)
+    noexcept(false);
+
+    // Read-only views of the weight matrices, in layer order
+    const Matrix* get_weights() const;
+
+    // Read-only views of the bias vectors, in layer order
+    const Matrix* get_biases() const;
+};
+
+#endif //MAPPEDWEIGHTS_H
@@ -1,8 +1,25 @@
 #include "Matrix.h"
+#include "Gemm.h"
+#include "Simd.h"
+#include "Linalg.h"
 #include <iostream>
-#define SQRT 0.5
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <vector>
 
 
+float* Matrix::allocate(int size)
+{
+    return static_cast<float*>(::operator new[](
+            size * sizeof(float), std::align_val_t(MATRIX_ALIGNMENT)));
+}
+
+void Matrix::deallocate(float* buffer)
+{
+    ::operator delete[](buffer, std::align_val_t(MATRIX_ALIGNMENT));
+}
+
 // Constructor
 Matrix::Matrix(int rows, int cols) noexcept(false)
 {
@@ -10,98 +27,108 @@ Matrix::Matrix(int rows, int cols) noexcept(false)
     {
         this->rows = rows;
         this->cols = cols;
-        this->mat = new float*[rows];
-        for (int row = 0; row < rows; row++)
-        {
-            this->mat[row] = new float[cols];
-            for (int col = 0; col < cols; col++)
-            {
-                this->mat[row][col] = 0.0;
-            }
-        }
-
+        this->mat = allocate(rows * cols);
+        std::fill(mat, mat + rows * cols, 0.0f);
     } else
     {
         throw std::runtime_error(DIMENSIONS_EXCEPTION);
     }
 }
 
+// View constructor
+Matrix::Matrix(float* data, int rows, int cols) noexcept(false) :
+rows(rows), cols(cols), mat(data), owner(false)
+{
+    if (rows <= 0 || cols <= 0)
+    {
+        throw std::runtime_error(DIMENSIONS_EXCEPTION);
+    }
+}
+
 // Default constructor
 Matrix::Matrix() : Matrix(1, 1) {}
 
 // Copy constructor
-Matrix::Matrix(const Matrix& m) : rows(m.rows), cols(m.cols)
+Matrix::Matrix(const Matrix& m) :
+        rows(m.rows), cols(m.cols), owner(m.owner), writable(m.writable)
 {
-    mat = new float*[rows];
-    for (int row = 0; row < rows; row++)
+    if (!owner)
     {
-        mat[row] = new float[cols];
-        for (int col = 0; col < cols ; col++)
-        {
-            mat[row][col] = m.mat[row][col];
-        }
+        mat = m.mat;
+        return;
     }
+    mat = allocate(rows * cols);
+    std::copy(m.mat, m.mat + rows * cols, mat);
+}
+
+// Move constructor
+Matrix::Matrix(Matrix&& m) noexcept :
+rows(m.rows), cols(m.cols), mat(m.mat), owner(m.owner), writable(m.writable)
+{
+    m.rows = 0;
+    m.cols = 0;
+    m.mat = nullptr;
+    m.owner = true;
+    m.writable = true;
+}
+
+Matrix::Matrix(const TransposedView& t) :
+        Matrix(t.get_rows(), t.get_cols())
+{
+    t.base().transpose_into(*this);
 }
 
 // Destructor
 Matrix::~Matrix()
 {
-    // Delete the allocated array for each row.
-    for (int i = 0; i < rows; i++)
+    if (owner)
     {
-        delete[] mat[i];
+        deallocate(mat);
     }
-    // Delete the array of pointers (the actual `mat` pointer).
-    delete[] mat;
 }
 
-
-float& Matrix::operator() (int i, int j)
+Matrix Matrix::view(float* data, int rows, int cols) noexcept(false)
 {
-    if (i < 0 || j < 0 || i >= this->rows || j >= this->cols)
-    {
-        throw std::invalid_argument(DIMENSIONS_EXCEPTION);
-    }
-    return this->mat[i][j];
+    return Matrix(data, rows, cols);
 }
 
-float Matrix::operator() (int i, int j) const
+Matrix Matrix::view(const float* data, int rows, int cols)
+noexcept(false)
 {
-    if (i < 0 || j < 0 || i >= this->rows || j >= this->cols)
-    {
-        throw std::invalid_argument(DIMENSIONS_EXCEPTION);
-    }
-    return this->mat[i][j];
+    // never written through: every writing member checks the flag
+    Matrix M(const_cast<float*>(data), rows, cols);
+    M.writable = false;
+    return M;
 }
 
-float& Matrix::operator[](int idx) noexcept(false)
+bool Matrix::is_view() const
 {
-    int r = idx / cols;
-    int c = idx % cols;
-    if (idx >= 0 && idx < rows * cols)
-    {
-        return  *(*(mat+r) + c);
-    }
+    return !this->owner;
+}
 
-    else
-    {
-        throw std::out_of_range(RANGE_EXCEPTION);
-    }
+bool Matrix::is_read_only() const
+{
+    return !this->writable;
 }
 
-float Matrix::operator[](int idx) const noexcept(false)
+
+float& Matrix::at(int i, int j) noexcept(false)
 {
-    int r = idx / cols;
-    int c = idx % cols;
-    if (idx >= 0 && idx < rows * cols)
+    check_writable();
+    if (i < 0 || j < 0 || i >= this->rows || j >= this->cols)
     {
-        return  *(*(mat+r) + c);
+        throw std::invalid_argument(DIMENSIONS_EXCEPTION);
     }
+    return this->mat[i * cols + j];
+}
 
-    else
+float Matrix::at(int i, int j) const noexcept(false)
+{
+    if (i < 0 || j < 0 || i >= this->rows || j >= this->cols)
     {
-        throw std::out_of_range(RANGE_EXCEPTION);
+        throw std::invalid_argument(DIMENSIONS_EXCEPTION);
     }
+    return this->mat[i * cols + j];
 }
 
 int Matrix::get_rows() const
@@ -114,35 +141,44 @@ int Matrix::get_cols() const
     return this->cols;
 }
 
+float* Matrix::data()
+{
+    check_writable();
+    return this->mat;
+}
+
+const float* Matrix::data() const
+{
+    return this->mat;
+}
+
 float Matrix::sum() const
 {
-    float sum = 0.0;
-    for (int i = 0; i < this->rows; i++)
-    {
-        for (int j = 0; j < this->cols; j++)
-        {
-            sum += *(*(mat + i) + j);
-        }
-    }
-    return sum;
+    return simd::sum(mat, rows * cols);
 }
 
 int Matrix::argmax() const
 {
-    int argmax = -1;
-    float max = mat[0][0];
-    for (int i = 0; i < rows; i++)
+    // vectorized max, then the first element equal to it
+    const int n = rows * cols;
+    const float max = simd::max_value(mat, n);
+    const float* first = std::find(mat, mat + n, max);
+    if (first != mat + n && !std::isnan(max))
     {
-        for (int j = 0; j < cols; j++)
+        return static_cast<int>(first - mat);
+    }
+    // a NaN equals nothing and may hide the max from the vector lanes:
+    // scalar scan for the first largest non-NaN element (0 if all are NaN)
+    int best = 0;
+    for (int i = 1; i < n; i++)
+    {
+        if (mat[i] > mat[best]
+            || (std::isnan(mat[best]) && !std::isnan(mat[i])))
         {
-            if(mat[i][j] > max)
-            {
-                max = mat[i][j];
-                argmax = i * cols + j;
-            }
+            best = i;
         }
     }
-    return argmax;
+    return best;
 }
 
 void Matrix::plain_print()
@@ -151,13 +187,11 @@ void Matrix::plain_print()
     {
         for (int j = 0; j < this->cols; j++)
         {
-            std::cout << *(*(mat + i) + j) << " ";
-//            std::cout << this->mat[i * cols + j] << " ";
+            std::cout << mat[i * cols + j] << " ";
         }
         std::cout << std::endl;
     }
     std::cout << "\n";
-//        mat[i][j]
 }
 
 void Matrix::plain_print() const
@@ -166,187 +200,225 @@ void Matrix::plain_print() const
     {
         for (int j = 0; j < this->cols; j++)
         {
-            std::cout << *(*(mat + i) + j) << " ";
-//            std::cout << this->mat[i * cols + j] << " ";
+            std::cout << mat[i * cols + j] << " ";
         }
         std::cout << std::endl;
     }
     std::cout << "\n";
-//        mat[i][j]
 }
 
 
-Matrix& Matrix::transpose()
+// helper: where to split a block side of length n; halves are rounded
+// down to whole 8-wide register tiles of simd::transpose
+static int split(int n)
 {
-    Matrix temp = Matrix(get_cols(), get_rows());
-    for (int i = 0; i < temp.get_rows(); i++)
+    const int half = n / 2;
+    return half >= 8 ? half & ~7 : half;
+}
+
+// helper: dst = transpose of the rows x cols block at src. Halving the
+// longer side until a block fits TRANSPOSE_LEAF keeps both the strided
+// reads and the strided writes inside whatever cache level is closest,
+// without knowing its size.
+static void transpose_block(const float* src, int lds, float* dst, int ldd,
+                            int rows, int cols)
+{
+    if (rows * cols <= TRANSPOSE_LEAF)
     {
-        for (int j = 0; j < temp.get_cols(); j++)
-        {
-            temp.mat[i][j] = this->mat[j][i];
-        }
+        simd::transpose(src, lds, dst, ldd, rows, cols);
+    }
+    else if (rows >= cols)
+    {
+        const int half = split(rows);
+        transpose_block(src, lds, dst, ldd, half, cols);
+        transpose_block(src + half * lds, lds, dst + half, ldd,
+                        rows - half, cols);
+    }
+    else
+    {
+        const int half = split(cols);
+        transpose_block(src, lds, dst, ldd, rows, half);
+        transpose_block(src + half, lds, dst + half * ldd, ldd,
+                        rows, cols - half);
     }
-    *this = temp;
-    return *this;
 }
 
-Matrix Matrix::dot(const Matrix& B) const
+// helper: copies a rows x cols block between strided buffers
+static void copy_block(const float* src, int lds, float* dst, int ldd,
+                       int rows, int cols)
 {
-    if (!check_valid_dim(B))
+    for (int i = 0; i < rows; i++)
     {
-        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+        std::memcpy(dst + i * ldd, src + i * lds, cols * sizeof(float));
     }
+}
 
-    Matrix c = Matrix(rows, cols);
-
-    for (int i = 0; i < rows; i++)
+// helper: swaps the rows x cols block at p with the transpose of the
+// cols x rows block at q (two mirrored off-diagonal blocks)
+static void swap_blocks(float* p, float* q, int ld, int rows, int cols)
+{
+    if (rows * cols <= TRANSPOSE_LEAF)
     {
-        for (int j = 0; j < cols; j++)
-        {
-            c.mat[i][j] = this->mat[i][j] * B.mat[i][j];
-        }
+        alignas(MATRIX_ALIGNMENT) float tile[TRANSPOSE_LEAF];
+        simd::transpose(p, ld, tile, rows, rows, cols);
+        simd::transpose(q, ld, p, ld, cols, rows);
+        copy_block(tile, rows, q, ld, cols, rows);
+    }
+    else if (rows >= cols)
+    {
+        const int half = split(rows);
+        swap_blocks(p, q, ld, half, cols);
+        swap_blocks(p + half * ld, q + half, ld, rows - half, cols);
+    }
+    else
+    {
+        const int half = split(cols);
+        swap_blocks(p, q, ld, rows, half);
+        swap_blocks(p + half, q + half * ld, ld, rows, cols - half);
     }
-    return c;
 }
 
-float Matrix::norm() const
+// helper: in-place transpose of the n x n diagonal block at a
+static void transpose_square(float* a, int ld, int n)
 {
-    float norm = 0.0;
-    for (int i = 0; i < rows; i++)
+    if (n * n <= TRANSPOSE_LEAF)
     {
-        for (int j = 0; j < cols; j++)
-        {
-            norm += pow(this->mat[i][j], 2);
-        }
+        alignas(MATRIX_ALIGNMENT) float tile[TRANSPOSE_LEAF];
+        simd::transpose(a, ld, tile, n, n, n);
+        copy_block(tile, n, a, ld, n, n);
+        return;
     }
-    norm = pow(norm, SQRT);
-    return norm;
+    const int half = split(n);
+    transpose_square(a, ld, half);
+    transpose_square(a + half * ld + half, ld, n - half);
+    swap_blocks(a + half, a + half * ld, ld, half, n - half);
 }
 
-Matrix& Matrix::vectorize() noexcept(false)
+Matrix& Matrix::transpose()
 {
-    if (rows == 0 || cols == 0 || mat == nullptr)
+    check_writable();
+    if (rows == cols)
     {
-        throw std::runtime_error(INIT_EXCEPTION);
+        transpose_square(mat, cols, rows);
+        return *this;
     }
 
-    // Calculate total elements and allocate new 1D array
-    int total_elements = rows * cols;
-    float** new_mat = new float*[total_elements];
-    for (int i = 0; i < total_elements; i++)
+    // Staging copy: sequential, so it costs far less than the transpose
+    static thread_local std::vector<float> staging;
+    const int size = rows * cols;
+    if (static_cast<int>(staging.size()) < size)
     {
-        new_mat[i] = new float[1];
+        staging.resize(size);
     }
+    std::memcpy(staging.data(), mat, size * sizeof(float));
+    transpose_block(staging.data(), cols, mat, rows, rows, cols);
+    std::swap(rows, cols);
+    return *this;
+}
 
-    // Copy the elements from the 2D array to the 1D array
-    for (int i = 0; i < rows; i++)
+void Matrix::transpose_into(Matrix& out) const
+{
+    if (out.rows != cols || out.cols != rows)
     {
-        for (int j = 0; j < cols; j++)
-        {
-            new_mat[i * cols + j][0] = mat[i][j];
-        }
+        out = Matrix(cols, rows);
     }
+    out.check_writable();
+    transpose_block(mat, cols, out.mat, rows, rows, cols);
+}
 
-    // Deallocate the old 2D array
-    for (int i = 0; i < rows; i++)
+float Matrix::norm() const
+{
+    return std::sqrt(simd::sum_squares(mat, rows * cols));
+}
+
+Matrix& Matrix::vectorize() noexcept(false)
+{
+    if (rows == 0 || cols == 0 || mat == nullptr)
     {
-        delete[] mat[i];
+        throw std::runtime_error(INIT_EXCEPTION);
     }
-    delete[] mat;
 
-    // Update the class members
-    this->mat = new_mat;
-    this->rows = total_elements;
+    // The row-major buffer already is the column vector - only the
+    // shape changes, no allocation or copy is needed.
+    this->rows = rows * cols;
     this->cols = 1;
 
     return *this;
 }
 
 
-Matrix Matrix::operator+ (const Matrix& B) const noexcept(false)
+Matrix& Matrix::operator+= (const Matrix& B) noexcept(false)
 {
     if (!check_valid_dim(B))
     {
         throw std::invalid_argument(DIMENSIONS_MISMATCH);
     }
+    check_writable();
 
-    Matrix temp = Matrix(this->rows, this->cols);
-    for (int i = 0; i < rows; i++)
-    {
-        for (int j = 0; j < cols; j++)
-        {
-            temp.mat[i][j] = this->mat[i][j] + B.mat[i][j];
-        }
-    }
-    return temp;
+    simd::add(mat, B.mat, mat, rows * cols);
+    return *this;
 }
 
-Matrix& Matrix::operator+= (const Matrix& B) noexcept(false)
+Matrix& Matrix::add_to_columns(const Matrix& v) noexcept(false)
 {
-    if (!check_valid_dim(B))
+    if (v.rows != rows || v.cols != 1)
     {
         throw std::invalid_argument(DIMENSIONS_MISMATCH);
     }
+    check_writable();
 
     for (int i = 0; i < rows; i++)
     {
+        float b = v.mat[i];
+        float* row = mat + i * cols;
         for (int j = 0; j < cols; j++)
         {
-
-            this->mat[i][j] += B.mat[i][j];
+            row[j] += b;
         }
     }
     return *this;
 }
 
-Matrix Matrix::rref() const
+// helper: an owning copy, also of a view (copying a view aliases it)
+static Matrix owned_copy(const Matrix& A)
+{
+    Matrix copy = Matrix(A.get_rows(), A.get_cols());
+    std::copy(A.data(), A.data() + A.get_rows() * A.get_cols(), copy.data());
+    return copy;
+}
+
+Matrix Matrix::rref(ThreadPool* pool) const
 {
-    Matrix copied_mat = Matrix(*this);
-    int lead = 0;
-    for (int r = 0; r < copied_mat.rows; r++)
+    Matrix reduced = owned_copy(*this);
+    linalg::eliminate(reduced.mat, rows, cols, cols, true, pool);
+    return reduced;
+}
+
+int Matrix::rank(ThreadPool* pool) const
+{
+    Matrix echelon = owned_copy(*this);
+    return linalg::eliminate(echelon.mat, rows, cols, cols, false, pool);
+}
+
+Matrix Matrix::solve(const Matrix& B, ThreadPool* pool) const noexcept(false)
+{
+    if (rows != cols || B.rows != rows)
     {
-        if (lead >= copied_mat.cols)
-        {
-            return copied_mat;
-        }
-        int i = r;
-        while (copied_mat(i, lead) == 0)
-        {
-            ++i;
-            if (i == copied_mat.rows)
-            {
-                i = r;
-                ++lead;
-                if (lead == copied_mat.cols)
-                {
-                    return copied_mat;
-                }
-            }
-        }
-        std::swap(copied_mat.mat[i], copied_mat.mat[r]);
-        float lv = copied_mat(r, lead);
-        for (int j = 0; j < copied_mat.cols; j++)
-        {
-            copied_mat(r, j) /= lv;
-        }
-        for (int t = 0; t < copied_mat.rows; t++)
-        {
-            if (t != r)
-            {
-                lv = copied_mat(t, lead);
-                for (int j = 0; j < copied_mat.cols; ++j)
-                {
-                    copied_mat(t, j) -= lv * copied_mat(r, j);
-                }
-            }
-        }
-        ++lead;
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
     }
-    return copied_mat;
+    Matrix lu = owned_copy(*this);
+    std::vector<int> perm(rows);
+    if (!linalg::lu_factor(lu.mat, rows, cols, perm.data(), pool))
+    {
+        throw std::runtime_error(SINGULAR_MATRIX);
+    }
+    Matrix x = owned_copy(B);
+    linalg::lu_solve(lu.mat, rows, cols, perm.data(), x.mat, x.cols, x.cols);
+    return x;
 }
 
 // Operator= using copy & swap idiom
-Matrix& Matrix::operator=(Matrix A)
+Matrix& Matrix::operator=(Matrix A) noexcept
 {
     swap(A);
     return *this;
@@ -356,47 +428,77 @@ Matrix& Matrix::operator=(Matrix A)
 
 
 // Friend methods
-Matrix operator*(const Matrix& A, float m)
+Matrix operator* (const Matrix& A, const Matrix& B) noexcept(false)
 {
-    Matrix temp = Matrix(A.rows, A.cols);
-    for (int i = 0; i < A.rows; i++)
+    if (A.get_cols() != B.get_rows())
     {
-        for (int j = 0; j < A.cols; j++)
-        {
-            temp.mat[i][j] = m * A.mat[i][j];
-        }
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
     }
-    return temp;
-}
 
+    Matrix c = Matrix(A.get_rows(), B.get_cols());
 
-Matrix operator* (float m, const Matrix& A)
-{
-    return operator*(A, m);
+    // Matrix-vector products (every single-image Dense layer) skip the
+    // packing stage of the blocked kernel.
+    if (B.cols == 1)
+    {
+        gemm::sgemv(A.rows, A.cols, A.mat, A.cols, B.mat, c.mat);
+    }
+    else
+    {
+        gemm::sgemm(A.rows, B.cols, A.cols,
+                    A.mat, A.cols, 1,
+                    B.mat, B.cols, 1,
+                    c.mat, c.cols);
+    }
+    return c;
 }
 
+// helper: C = op(A) * op(B) for operands given by strides
+static Matrix strided_product(int m, int n, int k,
+                              const float* a, int rsa, int csa,
+                              const float* b, int rsb, int csb)
+{
+    Matrix c = Matrix(m, n);
+    gemm::sgemm(m, n, k, a, rsa, csa, b, rsb, csb, c.data(), n);
+    return c;
+}
 
-
-Matrix operator* (const Matrix& A, const Matrix& B) noexcept(false)
+Matrix operator*(const TransposedView& A, const Matrix& B) noexcept(false)
 {
     if (A.get_cols() != B.get_rows())
     {
         throw std::invalid_argument(DIMENSIONS_MISMATCH);
     }
+    const Matrix& a = A.base();
+    return strided_product(A.get_rows(), B.get_cols(), A.get_cols(),
+                           a.data(), 1, a.get_cols(),
+                           B.data(), B.get_cols(), 1);
+}
 
-    Matrix c = Matrix(A.get_rows(), B.get_cols());
+Matrix operator*(const Matrix& A, const TransposedView& B) noexcept(false)
+{
+    if (A.get_cols() != B.get_rows())
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+    const Matrix& b = B.base();
+    return strided_product(A.get_rows(), B.get_cols(), A.get_cols(),
+                           A.data(), A.get_cols(), 1,
+                           b.data(), 1, b.get_cols());
+}
 
-    for (int i = 0; i < A.get_rows(); i++)
+Matrix operator*(const TransposedView& A, const TransposedView& B)
+noexcept(false)
+{
+    if (A.get_cols() != B.get_rows())
     {
-        for (int j = 0; j < B.get_cols(); j++)
-        {
-            for (int k = 0; k < B.get_rows(); k++)
-            {
-                c.mat[i][j] += A.mat[i][k] * B.mat[k][j];
-            }
-        }
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
     }
-    return c;
+    const Matrix& a = A.base();
+    const Matrix& b = B.base();
+    return strided_product(A.get_rows(), B.get_cols(), A.get_cols(),
+                           a.data(), 1, a.get_cols(),
+                           b.data(), 1, b.get_cols());
 }
 
 std::ostream& operator<<(std::ostream& os, const Matrix& A)
@@ -421,6 +523,7 @@ std::ostream& operator<<(std::ostream& os, const Matrix& A)
 
 std::istream& operator>>(std::istream& is, Matrix& A) noexcept(false)
 {
+    A.check_writable();
     is.seekg(0, std::ios_base::end);
     if (!is)
     {
@@ -445,14 +548,11 @@ std::istream& operator>>(std::istream& is, Matrix& A) noexcept(false)
         throw std::runtime_error(SEEK_ERROR);
     }
 
-    // Read the data into the 2D array
-    for (int i = 0; i < A.get_rows(); ++i)
+    // Read the data straight into the contiguous buffer
+    is.read(reinterpret_cast<char*>(A.mat), a_len);
+    if (!is)
     {
-        is.read(reinterpret_cast<char*>(A.mat[i]), A.get_cols() * sizeof(float));
-        if (!is)
-        {
-            throw std::runtime_error(DATA_READ_ERROR);
-        }
+        throw std::runtime_error(DATA_READ_ERROR);
     }
 
     return is;
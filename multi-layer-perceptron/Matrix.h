@@ -2,7 +2,9 @@
 #define MATRIX_H
 
 #include <iostream>
+#include <stdexcept>
 #include <cmath>
+#include "Span.h"
 #define DIMENSIONS_EXCEPTION "Number of rows or columns is invalid"
 #define INIT_EXCEPTION "Matrix is empty or not initialized"
 #define RANGE_EXCEPTION "Index out of range"
@@ -11,19 +13,52 @@
 #define SEEK_ERROR "Failed to seek to beginning/end of the stream"
 #define FILE_SIZE_ERROR "Failed to determine the size of the stream"
 #define DATA_READ_ERROR "Failed to read the required amount of data"
+#define SINGULAR_MATRIX "Matrix is singular to working precision"
+#define READ_ONLY_MATRIX "Matrix is a read-only view"
 #define THRESHOLD 0.1
+#define MATRIX_ALIGNMENT 64
+// Element accessors check their indices (and, when mutable, that the
+// matrix is writable) only in debug builds; with NDEBUG they index the
+// buffer directly, so loops over them vectorize like loops over raw
+// pointers (at() always checks the indices).
+#ifndef NDEBUG
+#define MATRIX_BOUNDS_CHECK 1
+#else
+#define MATRIX_BOUNDS_CHECK 0
+#endif
+// Blocks of at most this many elements (a 32 x 32 tile, two of which fit
+// in L1) go straight to simd::transpose; larger ones are split in half
+// along their longer side.
+#define TRANSPOSE_LEAF 1024
 
 struct matrix_dims {
     int rows, cols;
 };
 
+#include "MatrixExpr.h"
 
-class Matrix
+class TransposedView;
+class ThreadPool;
+
+class Matrix : public MatrixExpr<Matrix>
 {
 private:
     int rows;
     int cols;
-    float** mat = nullptr;
+    // Single row-major buffer: element (i, j) lives at mat[i * cols + j].
+    float* mat = nullptr;
+    // False for views, which point into memory owned by someone else.
+    bool owner = true;
+    // False for views of const memory (e.g. a PROT_READ mapping); kept by
+    // every copy of the view, and checked by every member that writes.
+    bool writable = true;
+
+    // Aligned (MATRIX_ALIGNMENT bytes) allocation of the element buffer.
+    static float* allocate(int size);
+    static void deallocate(float* buffer);
+
+    // Non-owning constructor behind view()
+    Matrix(float* data, int rows, int cols) noexcept(false);
 
     bool check_valid_dim (const Matrix& B) const
     {
@@ -37,12 +72,21 @@ private:
         swap(this->rows, A.rows);
         swap(this->cols, A.cols);
         swap(this->mat, A.mat);
+        swap(this->owner, A.owner);
+        swap(this->writable, A.writable);
+    }
+
+    // Throws std::logic_error(READ_ONLY_MATRIX) on a read-only view
+    void check_writable() const noexcept(false)
+    {
+        if (!writable)
+        {
+            throw std::logic_error(READ_ONLY_MATRIX);
+        }
     }
 
 public:
     // friend methods (used when first parameter isn't this)
-    friend Matrix operator*(const Matrix& A, float m);
-    friend Matrix operator*(float m, const Matrix& A);
     friend Matrix operator*(const Matrix& A, const Matrix& B) noexcept(false);
     friend std::ostream& operator<<(std::ostream& os, const Matrix& A);
     friend std::istream& operator>>(std::istream& is, Matrix& A)
@@ -64,10 +108,65 @@ public:
 
     /**
      * @brief Copy constructor that creates a deep copy of another matrix.
+     * Copying a view yields another view of the same memory.
      * @param m A reference to another Matrix object to be copied.
      */
     Matrix(const Matrix& m);
 
+    /**
+     * @brief Move constructor: takes over the buffer of `m` (or its view)
+     * without copying. `m` is left empty (0x0) and may only be assigned
+     * to or destroyed.
+     * @param m Matrix to move from.
+     */
+    Matrix(Matrix&& m) noexcept;
+
+    /**
+     * @brief Materializes a transposed view (see transpose_into()).
+     */
+    explicit Matrix(const TransposedView& t);
+
+    /**
+     * @brief Evaluates a lazy expression (e.g. `A + B * 0.5f`) into a new
+     * matrix in a single pass, with no intermediate matrices.
+     * @param e The expression to evaluate.
+     */
+    template<typename E>
+    Matrix(const MatrixExpr<E>& e);
+
+    /**
+     * @brief Creates a non-owning matrix over an existing row-major buffer
+     * (no allocation). The buffer must outlive the view and every copy of
+     * it; assigning an owning matrix to a view rebinds it instead of
+     * writing through.
+     * @param data Buffer of at least rows * cols floats.
+     * @param rows Number of rows in the matrix.
+     * @param cols Number of columns in the matrix.
+     * @exception std::runtime_error Thrown if the provided dimensions
+     * are non-positive.
+     */
+    static Matrix view(float* data, int rows, int cols) noexcept(false);
+
+    /**
+     * @brief Read-only view of const memory: it and every copy of it throw
+     * std::logic_error(READ_ONLY_MATRIX) from the members that write
+     * (data(), transpose(), +=, ...) instead of writing through. Mutable
+     * element access, row(), flat() and expression assignment check only
+     * in debug builds (see MATRIX_BOUNDS_CHECK).
+     */
+    static Matrix view(const float* data, int rows, int cols)
+    noexcept(false);
+
+    /**
+     * @brief Whether this matrix is a view (does not own its buffer).
+     */
+    bool is_view() const;
+
+    /**
+     * @brief Whether this matrix is a view of const memory (see view()).
+     */
+    bool is_read_only() const;
+
     /**
      * @brief Destructor that deallocates memory used by the matrix.
      */
@@ -75,40 +174,80 @@ public:
 
     /**
      * @brief Accesses a specific element of the matrix in a
-     * mutable fashion.
+     * mutable fashion. Indices are checked in debug builds only (see
+     * MATRIX_BOUNDS_CHECK); use at() for indices from outside the program.
      * @param i Row index.
      * @param j Column index.
      * @return Reference to the matrix element at the specified index.
+     * @exception std::invalid_argument Thrown (debug builds) if the index
+     * is out of bounds.
      */
     float& operator()(int i, int j);
 
     /**
      * @brief Accesses a specific element of the matrix in an
-     * immutable fashion.
+     * immutable fashion; checked in debug builds only.
      * @param i Row index.
      * @param j Column index.
      * @return Const reference to the matrix element at the specified index.
      */
     float operator() (int i, int j) const;
 
+    /**
+     * @brief Accesses a specific element of the matrix, always checking
+     * the indices.
+     * @exception std::invalid_argument Thrown if the index is out of
+     * bounds.
+     */
+    float& at(int i, int j) noexcept(false);
+
+    float at(int i, int j) const noexcept(false);
+
     /**
      * @brief Accesses a specific element of the matrix based on a linear
-     * index in a mutable fashion.
+     * index in a mutable fashion; checked in debug builds only.
      * @param idx Linear index calculated by row-major order.
      * @return Reference to the matrix element at the specified index.
-     * @exception std::out_of_range Thrown if the index is out of bounds.
+     * @exception std::out_of_range Thrown (debug builds) if the index is
+     * out of bounds.
      */
     float& operator[](int idx) noexcept(false);
 
     /**
      * @brief Accesses a specific element of the matrix based on a linear
-     * index in an immutable fashion.
+     * index in an immutable fashion; checked in debug builds only.
      * @param idx Linear index calculated by row-major order.
      * @return Const reference to the matrix element at the specified index.
-     * @exception std::out_of_range Thrown if the index is out of bounds.
+     * @exception std::out_of_range Thrown (debug builds) if the index is
+     * out of bounds.
      */
     float operator[](int idx) const noexcept(false);
 
+    /**
+     * @brief The contiguous elements of row i, without copying.
+     * @exception std::out_of_range Thrown (debug builds) if i is out of
+     * bounds.
+     */
+    Span<float> row(int i);
+
+    Span<const float> row(int i) const;
+
+    /**
+     * @brief All elements in row-major order, without copying.
+     */
+    Span<float> flat();
+
+    Span<const float> flat() const;
+
+    /**
+     * @brief Unchecked element read by linear index; the leaf of every
+     * lazy expression.
+     */
+    float eval(int idx) const
+    {
+        return mat[idx];
+    }
+
     /**
      * @brief Retrieves the number of rows in the matrix.
      * @return Number of rows.
@@ -121,6 +260,16 @@ public:
      */
     int get_cols() const;
 
+    /**
+     * @brief Direct access to the contiguous row-major element buffer.
+     * The buffer is MATRIX_ALIGNMENT-byte aligned and holds
+     * get_rows() * get_cols() elements.
+     * @return Pointer to the first element.
+     */
+    float* data();
+
+    const float* data() const;
+
     /**
      * @brief Computes the sum of all elements in the matrix.
      * @return Sum of the matrix elements.
@@ -129,7 +278,8 @@ public:
 
     /**
      * @brief Finds the index of the maximum element in the matrix.
-     * @return Index of the maximum element.
+     * @return Index of the first maximum element; NaNs are ignored (0 if
+     * every element is NaN).
      */
     int argmax() const;
 
@@ -141,19 +291,27 @@ public:
     void plain_print() const;
 
     /**
-     * @brief Transposes the matrix in-place.
+     * @brief Transposes the matrix in-place with a cache-oblivious blocked
+     * kernel. Square matrices swap mirrored blocks without any extra
+     * memory; other shapes stage the elements in a per-thread buffer that
+     * is reused by later calls.
      * @return Reference to the current matrix after transposition.
      */
     Matrix& transpose();
 
+    /**
+     * @brief Writes the transpose of this matrix into `out`, reusing its
+     * buffer (also through a view) when it already has the transposed
+     * shape; otherwise `out` gets a new buffer.
+     * @param out Destination; must not share memory with this matrix.
+     */
+    void transpose_into(Matrix& out) const;
 
     /**
-   * @brief Performs element-wise multiplication of this
-    * matrix with another matrix.
-   * @param B Another matrix to multiply with.
-   * @return A new matrix resulting from the element-wise multiplication.
-   */
-    Matrix dot(const Matrix& B) const;
+     * @brief Zero-cost transposed alias of this matrix: no element moves,
+     * and products with it run GEMM on swapped strides.
+     */
+    TransposedView transposed() const;
 
 
     /**
@@ -170,36 +328,238 @@ public:
     Matrix& vectorize() noexcept(false);
 
     /**
-     * @brief Adds another matrix to this matrix.
+     * @brief Adds another matrix to this matrix in-place.
      * @param B The matrix to be added to this one.
-     * @return A new matrix resulting from the addition.
+     * @return Reference to the current matrix after the addition.
      */
-    Matrix operator+ (const Matrix& B) const noexcept(false);
+    Matrix& operator+= (const Matrix& B) noexcept(false);
 
+    /**
+     * @brief Adds a lazy expression to this matrix in-place, in one pass.
+     * @exception std::invalid_argument Thrown if the shapes differ.
+     */
+    template<typename E>
+    Matrix& operator+= (const MatrixExpr<E>& e) noexcept(false);
 
     /**
-     * @brief Adds another matrix to this matrix in-place.
-     * @param B The matrix to be added to this one.
+     * @brief Adds a column vector to every column of this matrix in-place
+     * (the bias broadcast of a batched Dense layer).
+     * @param v Column vector with get_rows() rows.
      * @return Reference to the current matrix after the addition.
+     * @exception std::invalid_argument Thrown if v is not a column vector
+     * of matching height.
      */
-    Matrix& operator+= (const Matrix& B) noexcept(false);
+    Matrix& add_to_columns(const Matrix& v) noexcept(false);
 
 
     /**
-     * @brief Solves the matrix to Reduced Row Echelon Form (RREF).
+     * @brief Solves the matrix to Reduced Row Echelon Form (RREF) by
+     * Gauss-Jordan elimination with partial pivoting (linalg::eliminate).
+     * @param pool Optional pool that runs the row updates of large
+     * matrices in parallel.
      * @return A new matrix in RREF.
      */
-    Matrix rref() const;
+    Matrix rref(ThreadPool* pool = nullptr) const;
+
+    /**
+     * @brief Number of linearly independent rows (and columns), from
+     * forward elimination with partial pivoting.
+     */
+    int rank(ThreadPool* pool = nullptr) const;
+
+    /**
+     * @brief Solves this * X = B for a square, non-singular matrix by LU
+     * factorization with partial pivoting.
+     * @param B Right-hand sides, one per column.
+     * @return X, with B's shape.
+     * @exception std::invalid_argument Thrown if the matrix is not square
+     * or B has a different number of rows.
+     * @exception std::runtime_error Thrown if the matrix is singular.
+     */
+    Matrix solve(const Matrix& B, ThreadPool* pool = nullptr) const
+    noexcept(false);
 
 
     /**
-     * @brief Assignment operator using the copy & swap idiom.
+     * @brief Assignment operator using the copy & swap idiom. It serves as
+     * both copy and move assignment: an rvalue argument is moved into A,
+     * so assigning a temporary never copies its elements.
      * @param A Matrix to be assigned to this one.
      * @return Reference to the current matrix after assignment.
      */
-    Matrix& operator=(Matrix A);
+    Matrix& operator=(Matrix A) noexcept;
+
+    /**
+     * @brief Evaluates a lazy expression into this matrix. When the shape
+     * already matches, the result is written into the existing buffer
+     * (also through a view) with no allocation; the expression may
+     * reference this matrix. Otherwise a new buffer is allocated.
+     * @param e The expression to evaluate.
+     * @return Reference to the current matrix after assignment.
+     */
+    template<typename E>
+    Matrix& operator=(const MatrixExpr<E>& e);
 
 };
 
+/**
+ * A read-only transposed alias of a Matrix, made by Matrix::transposed():
+ * element (i, j) is element (j, i) of the source. The source must outlive
+ * the view.
+ */
+class TransposedView
+{
+private:
+    const Matrix& source;
+
+public:
+    explicit TransposedView(const Matrix& source) : source(source)
+    {}
+
+    int get_rows() const
+    {
+        return source.get_cols();
+    }
+
+    int get_cols() const
+    {
+        return source.get_rows();
+    }
+
+    float operator()(int i, int j) const
+    {
+        return source(j, i);
+    }
+
+    // The untransposed matrix
+    const Matrix& base() const
+    {
+        return source;
+    }
+};
+
+inline float& Matrix::operator()(int i, int j)
+{
+    if (MATRIX_BOUNDS_CHECK)
+    {
+        check_writable();
+    }
+    if (MATRIX_BOUNDS_CHECK && (i < 0 || j < 0 || i >= rows || j >= cols))
+    {
+        throw std::invalid_argument(DIMENSIONS_EXCEPTION);
+    }
+    return mat[i * cols + j];
+}
+
+inline float Matrix::operator()(int i, int j) const
+{
+    if (MATRIX_BOUNDS_CHECK && (i < 0 || j < 0 || i >= rows || j >= cols))
+    {
+        throw std::invalid_argument(DIMENSIONS_EXCEPTION);
+    }
+    return mat[i * cols + j];
+}
+
+inline float& Matrix::operator[](int idx) noexcept(false)
+{
+    if (MATRIX_BOUNDS_CHECK)
+    {
+        check_writable();
+    }
+    if (MATRIX_BOUNDS_CHECK && (idx < 0 || idx >= rows * cols))
+    {
+        throw std::out_of_range(RANGE_EXCEPTION);
+    }
+    return mat[idx];
+}
+
+inline float Matrix::operator[](int idx) const noexcept(false)
+{
+    if (MATRIX_BOUNDS_CHECK && (idx < 0 || idx >= rows * cols))
+    {
+        throw std::out_of_range(RANGE_EXCEPTION);
+    }
+    return mat[idx];
+}
+
+inline Span<float> Matrix::row(int i)
+{
+    if (MATRIX_BOUNDS_CHECK)
+    {
+        check_writable();
+    }
+    if (MATRIX_BOUNDS_CHECK && (i < 0 || i >= rows))
+    {
+        throw std::out_of_range(RANGE_EXCEPTION);
+    }
+    return Span<float>(mat + i * cols, cols);
+}
+
+inline Span<const float> Matrix::row(int i) const
+{
+    if (MATRIX_BOUNDS_CHECK && (i < 0 || i >= rows))
+    {
+        throw std::out_of_range(RANGE_EXCEPTION);
+    }
+    return Span<const float>(mat + i * cols, cols);
+}
+
+inline Span<float> Matrix::flat()
+{
+    if (MATRIX_BOUNDS_CHECK)
+    {
+        check_writable();
+    }
+    return Span<float>(mat, rows * cols);
+}
+
+inline Span<const float> Matrix::flat() const
+{
+    return Span<const float>(mat, rows * cols);
+}
+
+inline TransposedView Matrix::transposed() const
+{
+    return TransposedView(*this);
+}
+
+/**
+ * @brief Products with transposed operands; GEMM reads the source matrices
+ * through swapped strides, so nothing is transposed in memory.
+ * @exception std::invalid_argument Thrown if the inner dimensions differ.
+ */
+Matrix operator*(const TransposedView& A, const Matrix& B) noexcept(false);
+Matrix operator*(const Matrix& A, const TransposedView& B) noexcept(false);
+Matrix operator*(const TransposedView& A, const TransposedView& B)
+noexcept(false);
+
+template<typename E>
+Matrix::Matrix(const MatrixExpr<E>& e) :
+        Matrix(e.self().get_rows(), e.self().get_cols())
+{
+    e.self().assign_to(mat);
+}
+
+template<typename E>
+Matrix& Matrix::operator+=(const MatrixExpr<E>& e) noexcept(false)
+{
+    return *this = *this + e;
+}
+
+template<typename E>
+Matrix& Matrix::operator=(const MatrixExpr<E>& e)
+{
+    if (e.self().get_rows() != rows || e.self().get_cols() != cols)
+    {
+        return *this = Matrix(e);
+    }
+    if (MATRIX_BOUNDS_CHECK)
+    {
+        check_writable();
+    }
+    e.self().assign_to(mat);
+    return *this;
+}
+
 
 #endif //MATRIX_H
@@ -0,0 +1,274 @@
+#ifndef MATRIXEXPR_H
+#define MATRIXEXPR_H
+
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#define EXPR_BLOCK 256          // elements per block of a compound expression
+
+class Matrix;
+
+/**
+ * CRTP base of every lazily evaluated matrix expression (and of Matrix
+ * itself). `A + B`, `m * A`, `A.dot(B)` and the activation::lazy
+ * functions build small expression objects instead of temporaries;
+ * constructing or assigning a Matrix from one evaluates the whole tree in
+ * a single pass, EXPR_BLOCK elements at a time: every node runs its simd::
+ * kernel over the block, with intermediate results in stack buffers that
+ * stay in L1 and matrix operands read in place. Products (`A * B`) are
+ * not lazy: they go straight to the GEMM engine and yield a Matrix.
+ *
+ * Expressions refer to their Matrix operands, so they must be evaluated
+ * within the full expression that created them (do not store them in
+ * `auto` variables that outlive the operands).
+ */
+template<typename E>
+class MatrixExpr
+{
+public:
+    const E& self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+
+    /**
+     * @brief Lazy element-wise product with another expression.
+     * @exception std::invalid_argument Thrown if the shapes differ.
+     */
+    template<typename R>
+    auto dot(const MatrixExpr<R>& B) const noexcept(false);
+
+    /**
+     * @brief Writes every element of the expression to out[0..rows*cols).
+     * Element i only reads element i of each operand, so out may alias
+     * any of them.
+     */
+    void assign_to(float* out) const
+    {
+        const E& e = self();
+        const int n = e.get_rows() * e.get_cols();
+        for (int start = 0; start < n; start += EXPR_BLOCK)
+        {
+            e.eval_block(start, std::min(EXPR_BLOCK, n - start), out + start);
+        }
+    }
+};
+
+namespace expr
+{
+    // Matrices are held by reference, sub-expressions (small temporaries
+    // of the same full expression) by value.
+    template<typename E>
+    struct storage
+    {
+        typedef const E type;
+    };
+
+    template<>
+    struct storage<Matrix>
+    {
+        typedef const Matrix& type;
+    };
+
+    // helper: elements [start, start + n) of an operand; a matrix is read
+    // in place, a sub-expression is evaluated into `buffer`
+    template<typename E>
+    const float* block(const E& operand, int start, int n, float* buffer)
+    {
+        if constexpr (std::is_same<E, Matrix>::value)
+        {
+            return operand.data() + start;
+        }
+        else
+        {
+            operand.eval_block(start, n, buffer);
+            return buffer;
+        }
+    }
+
+    struct add_op
+    {
+        static float apply(float a, float b) { return a + b; }
+        static void kernel(const float* a, const float* b, float* out, int n)
+        {
+            simd::add(a, b, out, n);
+        }
+    };
+
+    struct mul_op
+    {
+        static float apply(float a, float b) { return a * b; }
+        static void kernel(const float* a, const float* b, float* out, int n)
+        {
+            simd::mul(a, b, out, n);
+        }
+    };
+
+    struct relu_op
+    {
+        static float apply(float a) { return a > 0.0f ? a : 0.0f; }
+        static void kernel(const float* a, float* out, int n)
+        {
+            static const float zeros[EXPR_BLOCK] = {};
+            simd::max(a, zeros, out, n);
+        }
+    };
+
+    // simd::exp clamps its input to [-87, 88]; apply() matches it
+    struct exp_op
+    {
+        static float apply(float a)
+        {
+            return std::exp(std::min(std::max(a, -87.0f), 88.0f));
+        }
+        static void kernel(const float* a, float* out, int n)
+        {
+            simd::exp(a, out, n);
+        }
+    };
+
+    // Element-wise Op(lhs, rhs) of two same-shaped operands
+    template<typename L, typename R, typename Op>
+    class Binary : public MatrixExpr<Binary<L, R, Op>>
+    {
+    private:
+        typename storage<L>::type lhs;
+        typename storage<R>::type rhs;
+
+    public:
+        Binary(const L& lhs, const R& rhs) noexcept(false) :
+                lhs(lhs), rhs(rhs)
+        {
+            if (lhs.get_rows() != rhs.get_rows() ||
+                lhs.get_cols() != rhs.get_cols())
+            {
+                throw std::invalid_argument(DIMENSIONS_MISMATCH);
+            }
+        }
+
+        int get_rows() const { return lhs.get_rows(); }
+        int get_cols() const { return lhs.get_cols(); }
+
+        float eval(int i) const
+        {
+            return Op::apply(lhs.eval(i), rhs.eval(i));
+        }
+
+        // Elements [start, start + n), n <= EXPR_BLOCK, into out
+        void eval_block(int start, int n, float* out) const
+        {
+            float a[EXPR_BLOCK], b[EXPR_BLOCK];
+            Op::kernel(block(lhs, start, n, a), block(rhs, start, n, b), out,
+                       n);
+        }
+    };
+
+    // m * operand
+    template<typename E>
+    class Scale : public MatrixExpr<Scale<E>>
+    {
+    private:
+        typename storage<E>::type operand;
+        float m;
+
+    public:
+        Scale(const E& operand, float m) : operand(operand), m(m) {}
+
+        int get_rows() const { return operand.get_rows(); }
+        int get_cols() const { return operand.get_cols(); }
+
+        float eval(int i) const
+        {
+            return m * operand.eval(i);
+        }
+
+        void eval_block(int start, int n, float* out) const
+        {
+            float a[EXPR_BLOCK];
+            simd::scale(block(operand, start, n, a), m, out, n);
+        }
+    };
+
+    // Op(operand) applied to every element
+    template<typename E, typename Op>
+    class Unary : public MatrixExpr<Unary<E, Op>>
+    {
+    private:
+        typename storage<E>::type operand;
+
+    public:
+        explicit Unary(const E& operand) : operand(operand) {}
+
+        int get_rows() const { return operand.get_rows(); }
+        int get_cols() const { return operand.get_cols(); }
+
+        float eval(int i) const
+        {
+            return Op::apply(operand.eval(i));
+        }
+
+        void eval_block(int start, int n, float* out) const
+        {
+            float a[EXPR_BLOCK];
+            Op::kernel(block(operand, start, n, a), out, n);
+        }
+    };
+}
+
+template<typename E>
+template<typename R>
+auto MatrixExpr<E>::dot(const MatrixExpr<R>& B) const noexcept(false)
+{
+    return expr::Binary<E, R, expr::mul_op>(self(), B.self());
+}
+
+/**
+ * @brief Lazy element-wise sum.
+ * @exception std::invalid_argument Thrown if the shapes differ.
+ */
+template<typename L, typename R>
+expr::Binary<L, R, expr::add_op> operator+(const MatrixExpr<L>& A,
+                                           const MatrixExpr<R>& B)
+noexcept(false)
+{
+    return expr::Binary<L, R, expr::add_op>(A.self(), B.self());
+}
+
+/**
+ * @brief Lazy multiplication by a scalar.
+ */
+template<typename E>
+expr::Scale<E> operator*(const MatrixExpr<E>& A, float m)
+{
+    return expr::Scale<E>(A.self(), m);
+}
+
+template<typename E>
+expr::Scale<E> operator*(float m, const MatrixExpr<E>& A)
+{
+    return expr::Scale<E>(A.self(), m);
+}
+
+namespace activation
+{
+    namespace lazy
+    {
+        // max(A, 0) element-wise, fused into the enclosing expression
+        template<typename E>
+        expr::Unary<E, expr::relu_op> relu(const MatrixExpr<E>& A)
+        {
+            return expr::Unary<E, expr::relu_op>(A.self());
+        }
+
+        // exp(A) element-wise, fused into the enclosing expression
+        template<typename E>
+        expr::Unary<E, expr::exp_op> exp(const MatrixExpr<E>& A)
+        {
+            return expr::Unary<E, expr::exp_op>(A.self());
+        }
+    }
+}
+
+#endif //MATRIXEXPR_H
@@ -1,5 +1,8 @@
 #include "MlpNetwork.h"
-#define SOFTMAX_VEC_LEN 10
+#include "Workspace.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
 
 const matrix_dims img_dims = {28, 28};
 const matrix_dims weights_dims[] = {{128, 784},
@@ -11,32 +14,241 @@ const matrix_dims bias_dims[] = {{128, 1},
                                  {20, 1},
                                  {10, 1}};
 
-MlpNetwork::MlpNetwork(Matrix weights[], Matrix biases[]) :
-        first_layer(Dense(weights[0], biases[0], activation::relu)),
-        second_layer(Dense(weights[1], biases[1], activation::relu)),
-        third_layer(Dense(weights[2], biases[2], activation::relu)),
-        fourth_layer(Dense(weights[3], biases[3], activation::softmax))
+const ActivationType default_activations[] = {activation::relu,
+                                              activation::relu,
+                                              activation::relu,
+                                              activation::softmax};
+
+MlpNetwork::MlpNetwork(std::vector<Dense> layers) noexcept(false) :
+        layers(std::move(layers))
+{
+    if (this->layers.empty())
+    {
+        throw std::invalid_argument(EMPTY_NETWORK);
+    }
+    for (size_t i = 1; i < this->layers.size(); i++)
+    {
+        if (this->layers[i].get_dims().cols
+            != this->layers[i - 1].get_dims().rows)
+        {
+            throw std::invalid_argument(DIMENSIONS_MISMATCH);
+        }
+    }
+}
+
+MlpNetwork::MlpNetwork(const Matrix weights[], const Matrix biases[]) :
+        MlpNetwork(weights, biases, default_activations, MLP_SIZE)
 {}
 
+// helper: one Dense per weights/biases/activation triple
+static std::vector<Dense> make_layers(const Matrix weights[],
+                                      const Matrix biases[],
+                                      const ActivationType activations[],
+                                      int layer_count)
+{
+    std::vector<Dense> layers;
+    layers.reserve(std::max(layer_count, 0));
+    for (int i = 0; i < layer_count; i++)
+    {
+        layers.emplace_back(weights[i], biases[i], activations[i]);
+    }
+    return layers;
+}
+
+MlpNetwork::MlpNetwork(const Matrix weights[], const Matrix biases[],
+                       const ActivationType activations[], int layer_count)
+noexcept(false) :
+        MlpNetwork(make_layers(weights, biases, activations, layer_count))
+{}
+
+
+// helper: most probable digit in column `col` of the output layer; the
+// largest entry wins in every softmax mode, only its probability differs
+static digit column_digit(const Matrix& scores, int col,
+                          activation::softmax_mode mode)
+{
+    const int rows = scores.get_rows();
+    const int stride = scores.get_cols();
+    const float* column = scores.data() + col;
+    unsigned int value = 0;
+    float best;
+
+    if (stride == 1)
+    {
+        // contiguous: the vectorized (and NaN-safe) Matrix::argmax
+        value = static_cast<unsigned int>(
+                Matrix::view(column, rows, 1).argmax());
+        best = column[value];
+    }
+    else
+    {
+        // NaNs never win, like in Matrix::argmax
+        best = column[0];
+        for (int i = 1; i < rows; i++)
+        {
+            const float x = column[i * stride];
+            if (x > best || (std::isnan(best) && !std::isnan(x)))
+            {
+                value = i;
+                best = x;
+            }
+        }
+    }
+
+    switch (mode)
+    {
+        case activation::softmax_mode::log:
+            return digit{value, std::exp(best)};
+        case activation::softmax_mode::argmax:
+            return digit{value, 0.0f};      // never normalized
+        default:
+            return digit{value, best};
+    }
+}
 
 digit MlpNetwork::operator()(const Matrix &img) const
 {
-    Matrix softmax_vec = first_layer(img);
-    softmax_vec = second_layer(softmax_vec);
-    softmax_vec = third_layer(softmax_vec);
-    softmax_vec = fourth_layer(softmax_vec);
+    Workspace ws(*this);
+    return (*this)(img, ws);
+}
 
-    unsigned int value = 0;
-    float probability = 0.0;
+digit MlpNetwork::operator()(const Matrix& img, Workspace& ws) const
+{
+    // the image as a column vector, whatever its shape
+    const Matrix column = Matrix::view(img.data(),
+                                       img.get_rows() * img.get_cols(), 1);
+    return classify_batch(column, ws)[0];
+}
+
+std::vector<digit> MlpNetwork::classify_batch(const Matrix& batch) const
+{
+    Workspace ws(*this, batch.get_cols());
+    return classify_batch(batch, ws);
+}
+
+const std::vector<digit>& MlpNetwork::classify_batch(const Matrix& batch,
+                                                     Workspace& ws) const
+noexcept(false)
+{
+    // Layer i writes arena slot i % 2 and reads the other one; views cost
+    // no allocation, so they are simply re-created for every layer.
+    const int n = batch.get_cols();
+    const int count = get_layer_count();
+    const int* in_nz = nullptr;     // nonzero rows of a single-image input
+    int nnz = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Matrix out = ws.activations(i % 2, layers[i].get_dims().rows, n);
+        const Matrix in = i == 0
+                ? Matrix::view(batch.data(), batch.get_rows(), n)
+                : ws.activations((i + 1) % 2, layers[i - 1].get_dims().rows, n);
+        if (n > 1)
+        {
+            layers[i](in, out);
+            continue;
+        }
+        // one image: each layer lists its nonzero outputs, so the next
+        // layer's sparse path gathers them without scanning
+        int* out_nz = (i + 1 < count && layers[i + 1].has_sparse_input())
+                      ? ws.nonzeros[i % 2].data() : nullptr;
+        nnz = layers[i].forward(in, in_nz, nnz, out, out_nz);
+        in_nz = out_nz;
+    }
+    const Matrix probs = ws.activations((count - 1) % 2,
+                                        layers.back().get_dims().rows, n);
+
+    ws.digits.clear();
+    for (int col = 0; col < n; col++)
+    {
+        ws.digits.push_back(column_digit(probs, col, get_output_mode()));
+    }
+    return ws.digits;
+}
+
+std::vector<digit> MlpNetwork::operator()(const std::vector<Matrix>& imgs)
+const noexcept(false)
+{
+    if (imgs.empty())
+    {
+        return {};
+    }
+
+    const int img_len = get_input_size();
+    const int count = static_cast<int>(imgs.size());
+    Matrix batch = Matrix(img_len, count);
+    float* dst = batch.data();
+    for (int n = 0; n < count; n++)
+    {
+        if (imgs[n].get_rows() * imgs[n].get_cols() != img_len)
+        {
+            throw std::invalid_argument(DIMENSIONS_MISMATCH);
+        }
+        const float* src = imgs[n].data();
+        for (int p = 0; p < img_len; p++)
+        {
+            dst[p * count + n] = src[p];
+        }
+    }
+    return classify_batch(batch);
+}
+
+void MlpNetwork::set_output_mode(activation::softmax_mode mode)
+{
+    layers.back().set_softmax_mode(mode);
+}
 
-    for (int i = 0; i < SOFTMAX_VEC_LEN; i++)
+activation::softmax_mode MlpNetwork::get_output_mode() const
+{
+    return layers.back().get_softmax_mode();
+}
+
+void MlpNetwork::enable_sparse_input(float max_density)
+{
+    // images are mostly blank pixels and ReLU outputs mostly zeros: for a
+    // single image, those layers only read the weight columns of nonzeros
+    layers.front().enable_sparse_input(max_density);
+    for (size_t i = 1; i < layers.size(); i++)
     {
-        if (softmax_vec[i] > probability)
+        if (layers[i - 1].get_activation() == activation::relu)
         {
-            value = i;
-            probability = softmax_vec[i];
+            layers[i].enable_sparse_input(max_density);
         }
     }
+}
+
+void MlpNetwork::reset_sparsity()
+{
+    for (Dense& layer : layers)
+    {
+        layer.reset_sparsity();
+    }
+}
+
+int MlpNetwork::max_activation_rows() const
+{
+    int rows = 0;
+    for (const Dense& layer : layers)
+    {
+        rows = std::max(rows, layer.get_dims().rows);
+    }
+    return rows;
+}
 
-    return digit{value, probability};
-}
\ No newline at end of file
+int MlpNetwork::get_layer_count() const
+{
+    return static_cast<int>(layers.size());
+}
+
+int MlpNetwork::get_input_size() const
+{
+    return layers.front().get_dims().cols;
+}
+
+const Dense& MlpNetwork::get_layer(int i) const noexcept(false)
+{
+    if (i < 0 || i >= get_layer_count())
+    {
+        throw std::out_of_range(RANGE_EXCEPTION);
+    }
+    return layers[i];
+}
@@ -2,7 +2,9 @@
 #define MLPNETWORK_H
 
 #include "Dense.h"
-#define MLP_SIZE 4
+#include <vector>
+#define MLP_SIZE 4      // layers of the MNIST topology / raw eight-file layout
+#define EMPTY_NETWORK "A network needs at least one layer"
 
 typedef struct digit
 {
@@ -13,21 +15,99 @@ typedef struct digit
 extern const matrix_dims img_dims;
 extern const matrix_dims weights_dims[MLP_SIZE];
 extern const matrix_dims bias_dims[MLP_SIZE];
+extern const ActivationType default_activations[MLP_SIZE];
 
+class Workspace;
+
+/**
+ * A feed-forward stack of Dense layers of any depth and width. The output
+ * of the last layer holds one score per class (normally a softmax), and
+ * the predicted digit is its largest entry.
+ */
 class MlpNetwork
 {
 private:
-    Dense first_layer;
-    Dense second_layer;
-    Dense third_layer;
-    Dense fourth_layer;
+    std::vector<Dense> layers;
 
 public:
-    MlpNetwork(Matrix weights[], Matrix biases[]);
+    /**
+     * @brief Chains the given layers, input first.
+     * @exception std::invalid_argument Thrown if there are no layers or a
+     * layer's input width differs from the previous layer's output.
+     */
+    explicit MlpNetwork(std::vector<Dense> layers) noexcept(false);
+
+    // The MNIST topology: MLP_SIZE layers, ReLU on the hidden layers and
+    // softmax on the output layer
+    MlpNetwork(const Matrix weights[], const Matrix biases[]);
 
-    digit operator() (const Matrix& img);
+    // Explicit depth and activation per layer, e.g. from a ModelFile
+    MlpNetwork(const Matrix weights[], const Matrix biases[],
+               const ActivationType activations[], int layer_count)
+    noexcept(false);
+
+    // Moving a network moves its layers; nothing is copied
+    MlpNetwork(const MlpNetwork& other) = default;
+    MlpNetwork(MlpNetwork&& other) = default;
+    MlpNetwork& operator=(const MlpNetwork& other) = default;
+    MlpNetwork& operator=(MlpNetwork&& other) = default;
 
     digit operator() (const Matrix& img) const;
+
+    // Classifies one image using the preallocated scratch in `ws`
+    // (no heap allocation once ws exists)
+    digit operator() (const Matrix& img, Workspace& ws) const;
+
+    // Classifies a batch: column n of `batch` is the n-th flattened image
+    // (e.g. 784 x N), so every layer runs one GEMM for the whole batch.
+    std::vector<digit> classify_batch(const Matrix& batch) const;
+
+    // Allocation-free classify_batch; the returned digits live in `ws`
+    // and are overwritten by its next use
+    const std::vector<digit>& classify_batch(const Matrix& batch,
+                                             Workspace& ws) const
+    noexcept(false);
+
+    // Classifies each image (any shape with get_input_size() entries)
+    // in a single batched pass
+    std::vector<digit> operator() (const std::vector<Matrix>& imgs) const
+    noexcept(false);
+
+    /**
+     * @brief Chooses what the output softmax computes: probabilities with
+     * the accurate or fast exp, log-probabilities, or nothing at all
+     * (argmax, for pure classification; digit::probability is then 0).
+     * Only affects a softmax output layer.
+     */
+    void set_output_mode(activation::softmax_mode mode);
+
+    // Getter for the output softmax mode
+    activation::softmax_mode get_output_mode() const;
+
+    /**
+     * @brief Enables the single-image sparse-input path (see
+     * Dense::enable_sparse_input) on the first layer and on every layer
+     * after a ReLU. Off by default: each such layer keeps a transposed
+     * copy of its weights, so a network over mapped weights stops being
+     * zero-copy.
+     */
+    void enable_sparse_input(float max_density = DENSE_SPARSE_DENSITY);
+
+    // Clears the sparsity counters of every layer (see
+    // Dense::get_sparsity, reached through get_layer)
+    void reset_sparsity();
+
+    // Height of the widest layer output, used to plan a Workspace
+    int max_activation_rows() const;
+
+    // Number of Dense layers
+    int get_layer_count() const;
+
+    // Length of a flattened input image (columns of the first layer)
+    int get_input_size() const;
+
+    // The i-th Dense layer, counted from the input
+    const Dense& get_layer(int i) const noexcept(false);
 };
 
 #endif //MLPNETWORK_H
@@ -0,0 +1,211 @@
+#include "ModelFile.h"
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    const std::uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+    // helper: round up to the next tensor boundary
+    std::uint64_t align_offset(std::uint64_t offset)
+    {
+        return (offset + MODEL_TENSOR_ALIGNMENT - 1)
+               / MODEL_TENSOR_ALIGNMENT * MODEL_TENSOR_ALIGNMENT;
+    }
+
+    // helper: FNV-1a 64, byte by byte. Hashing whole words instead would
+    // leave the top bit of each word unmixed, so two sign flips cancel.
+    std::uint64_t checksum(const unsigned char* bytes, std::size_t length)
+    {
+        std::uint64_t hash = FNV_OFFSET;
+        for (std::size_t i = 0; i < length; i++)
+        {
+            hash = (hash ^ bytes[i]) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    std::uint32_t activation_id(ActivationType activation_func)
+    {
+        if (activation_func == activation::relu)
+        {
+            return static_cast<std::uint32_t>(model_activation::relu);
+        }
+        if (activation_func == activation::softmax)
+        {
+            return static_cast<std::uint32_t>(model_activation::softmax);
+        }
+        throw std::invalid_argument(MODEL_ACTIVATION_ERROR);
+    }
+
+    ActivationType activation_func(std::uint32_t id)
+    {
+        switch (static_cast<model_activation>(id))
+        {
+            case model_activation::relu:
+                return activation::relu;
+            case model_activation::softmax:
+                return activation::softmax;
+        }
+        throw std::runtime_error(MODEL_ACTIVATION_ERROR);
+    }
+
+    // helper: does [offset, offset + bytes) lie inside the file, aligned?
+    bool tensor_fits(std::uint64_t offset, std::uint64_t bytes,
+                     std::uint64_t file_size)
+    {
+        return offset % MODEL_TENSOR_ALIGNMENT == 0 && offset <= file_size
+               && bytes <= file_size - offset;
+    }
+}
+
+ModelFile::ModelFile(const std::string& path) noexcept(false) : file(path)
+{
+    const auto* bytes = static_cast<const unsigned char*>(file.data());
+    if (file.size() < sizeof(model_header))
+    {
+        throw std::runtime_error(MODEL_FORMAT_ERROR);
+    }
+    model_header header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, MODEL_MAGIC, sizeof(header.magic)) != 0)
+    {
+        throw std::runtime_error(MODEL_FORMAT_ERROR);
+    }
+    if (header.version != MODEL_VERSION)
+    {
+        throw std::runtime_error(MODEL_VERSION_ERROR);
+    }
+    const std::uint64_t table_end = sizeof(model_header)
+            + static_cast<std::uint64_t>(header.layer_count)
+              * sizeof(model_layer);
+    if (header.file_size != file.size() || header.layer_count == 0
+        || table_end > file.size())
+    {
+        throw std::runtime_error(MODEL_LAYOUT_ERROR);
+    }
+    if (checksum(bytes + sizeof(model_header),
+                 file.size() - sizeof(model_header)) != header.checksum)
+    {
+        throw std::runtime_error(MODEL_CHECKSUM_ERROR);
+    }
+
+    weights.reserve(header.layer_count);
+    biases.reserve(header.layer_count);
+    activations.reserve(header.layer_count);
+    for (std::uint32_t i = 0; i < header.layer_count; i++)
+    {
+        model_layer layer;
+        std::memcpy(&layer, bytes + sizeof(model_header)
+                            + i * sizeof(model_layer), sizeof(layer));
+        const std::uint64_t weight_bytes = static_cast<std::uint64_t>(
+                layer.rows) * layer.cols * sizeof(float);
+        const std::uint64_t bias_bytes = static_cast<std::uint64_t>(
+                layer.rows) * sizeof(float);
+        // Matrix dimensions are ints; every layer consumes the previous
+        // layer's output
+        const std::uint32_t max_dim = std::numeric_limits<int>::max();
+        if (layer.rows == 0 || layer.cols == 0 || layer.rows > max_dim
+            || layer.cols > max_dim
+            || (i > 0 && static_cast<int>(layer.cols)
+                         != weights.back().get_rows())
+            || !tensor_fits(layer.weights_offset, weight_bytes, file.size())
+            || !tensor_fits(layer.bias_offset, bias_bytes, file.size()))
+        {
+            throw std::runtime_error(MODEL_LAYOUT_ERROR);
+        }
+
+        weights.push_back(Matrix::view(reinterpret_cast<const float*>(
+                bytes + layer.weights_offset), layer.rows, layer.cols));
+        biases.push_back(Matrix::view(reinterpret_cast<const float*>(
+                bytes + layer.bias_offset), layer.rows, 1));
+        activations.push_back(activation_func(layer.activation));
+    }
+}
+
+int ModelFile::get_layer_count() const
+{
+    return static_cast<int>(weights.size());
+}
+
+const Matrix* ModelFile::get_weights() const
+{
+    return weights.data();
+}
+
+const Matrix* ModelFile::get_biases() const
+{
+    return biases.data();
+}
+
+const ActivationType* ModelFile::get_activations() const
+{
+    return activations.data();
+}
+
+void ModelFile::pack(const std::string& path, const Matrix weights[],
+                     const Matrix biases[], const ActivationType activations[],
+                     int layers) noexcept(false)
+{
+    if (layers <= 0)
+    {
+        throw std::invalid_argument(DIMENSIONS_EXCEPTION);
+    }
+
+    // lay out the table first: every tensor on a 64-byte boundary
+    std::vector<model_layer> table(layers);
+    std::uint64_t offset = align_offset(sizeof(model_header)
+                                        + layers * sizeof(model_layer));
+    for (int i = 0; i < layers; i++)
+    {
+        const int rows = weights[i].get_rows();
+        const int cols = weights[i].get_cols();
+        if (biases[i].get_rows() * biases[i].get_cols() != rows
+            || (i > 0 && cols != weights[i - 1].get_rows()))
+        {
+            throw std::invalid_argument(DIMENSIONS_MISMATCH);
+        }
+        model_layer& layer = table[i];
+        std::memset(&layer, 0, sizeof(layer));
+        layer.rows = static_cast<std::uint32_t>(rows);
+        layer.cols = static_cast<std::uint32_t>(cols);
+        layer.activation = activation_id(activations[i]);
+        layer.weights_offset = offset;
+        offset = align_offset(offset + static_cast<std::uint64_t>(rows)
+                                       * cols * sizeof(float));
+        layer.bias_offset = offset;
+        offset = align_offset(offset + rows * sizeof(float));
+    }
+
+    std::vector<unsigned char> image(offset, 0);
+    std::memcpy(image.data() + sizeof(model_header), table.data(),
+                layers * sizeof(model_layer));
+    for (int i = 0; i < layers; i++)
+    {
+        std::memcpy(image.data() + table[i].weights_offset, weights[i].data(),
+                    table[i].rows * table[i].cols * sizeof(float));
+        std::memcpy(image.data() + table[i].bias_offset, biases[i].data(),
+                    table[i].rows * sizeof(float));
+    }
+
+    model_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version = MODEL_VERSION;
+    header.layer_count = static_cast<std::uint32_t>(layers);
+    header.file_size = image.size();
+    header.checksum = checksum(image.data() + sizeof(model_header),
+                               image.size() - sizeof(model_header));
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(image.data()),
+              static_cast<std::streamsize>(image.size()));
+    if (!out)
+    {
+        throw std::runtime_error(MODEL_WRITE_ERROR);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef MODELFILE_H
+#define MODELFILE_H
+
+#include "MappedFile.h"
+#include "Dense.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#define MODEL_MAGIC "MLPMODEL"
+#define MODEL_VERSION 2
+#define MODEL_TENSOR_ALIGNMENT 64
+#define MODEL_FORMAT_ERROR "Not a packed MLP model file"
+#define MODEL_VERSION_ERROR "Unsupported model file version"
+#define MODEL_LAYOUT_ERROR "Model file layout is corrupt"
+#define MODEL_CHECKSUM_ERROR "Model file checksum mismatch"
+#define MODEL_ACTIVATION_ERROR "Unknown activation in model"
+#define MODEL_WRITE_ERROR "Failed to write the model file"
+
+/*
+ * Packed model layout (native little-endian):
+ *
+ *   model_header                   64 bytes
+ *   model_layer[layer_count]       32 bytes each
+ *   tensors                        each starting on a 64-byte boundary:
+ *                                  weights rows x cols, row-major floats,
+ *                                  then the bias, rows floats
+ *
+ * The checksum is FNV-1a 64 over every byte after the header (layer
+ * table, padding and tensors), so a truncated or corrupted file is
+ * rejected before any of its weights are used. Version 1 files hashed
+ * 8-byte words, which misses paired sign flips; they are no longer read.
+ */
+struct model_header
+{
+    char magic[8];              // MODEL_MAGIC, not NUL-terminated
+    std::uint32_t version;      // MODEL_VERSION
+    std::uint32_t layer_count;
+    std::uint64_t file_size;    // total bytes, including this header
+    std::uint64_t checksum;
+    std::uint8_t reserved[32];
+};
+
+struct model_layer
+{
+    std::uint32_t rows;         // outputs of the layer
+    std::uint32_t cols;         // inputs of the layer
+    std::uint32_t activation;   // model_activation id
+    std::uint32_t reserved;
+    std::uint64_t weights_offset;
+    std::uint64_t bias_offset;
+};
+
+static_assert(sizeof(model_header) == 64, "model_header must be 64 bytes");
+static_assert(sizeof(model_layer) == 32, "model_layer must be 32 bytes");
+
+// Activation ids stored in model_layer::activation
+enum class model_activation : std::uint32_t
+{
+    relu = 0,
+    softmax = 1
+};
+
+/**
+ * A packed model file, opened with a single validated mmap. The layer
+ * weights and biases are Matrix views into the mapping, so the ModelFile
+ * must outlive every network built from it.
+ */
+class ModelFile
+{
+private:
+    MappedFile file;
+    std::vector<Matrix> weights;
+    std::vector<Matrix> biases;
+    std::vector<ActivationType> activations;
+
+public:
+    /**
+     * @brief Maps and validates a packed model.
+     * @param path Model file written by pack().
+     * @exception std::runtime_error Thrown if the file cannot be mapped,
+     * has a wrong magic/version/layout, or fails the checksum.
+     */
+    explicit ModelFile(const std::string& path) noexcept(false);
+
+    // Number of Dense layers in the model
+    int get_layer_count() const;
+
+    // Read-only views of the weight matrices, in layer order
+    const Matrix* get_weights() const;
+
+    // Read-only views of the bias vectors, in layer order
+    const Matrix* get_biases() const;
+
+    // Activation of every layer, in layer order
+    const ActivationType* get_activations() const;
+
+    /**
+     * @brief Writes a packed model (the converter from raw layer files).
+     * @param path Output file.
+     * @param weights Weight matrix of every layer.
+     * @param biases Bias column vector of every layer.
+     * @param activations activation::relu or activation::softmax per layer.
+     * @param layers Number of layers.
+     * @exception std::invalid_argument Thrown if the layers do not chain
+     * or an activation has no model id.
+     * @exception std::runtime_error Thrown if the file cannot be written.
+     */
+    static void pack(const std::string& path, const Matrix weights[],
+                     const Matrix biases[], const ActivationType activations[],
+                     int layers) noexcept(false);
+};
+
+#endif //MODELFILE_H
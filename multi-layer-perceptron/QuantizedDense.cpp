@@ -0,0 +1,263 @@
+#include "QuantizedDense.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // out[r] = sum_p x[p] * w[r * k + p] for r < rows; k is a multiple of
+    // QUANT_K_ALIGNMENT
+    typedef void (*DotKernel)(const std::uint8_t* x, const std::int8_t* w,
+                              int rows, int k, std::int32_t* out);
+
+    void dot_scalar(const std::uint8_t* x, const std::int8_t* w,
+                    int rows, int k, std::int32_t* out)
+    {
+        for (int r = 0; r < rows; r++)
+        {
+            const std::int8_t* row = w + static_cast<std::size_t>(r) * k;
+            std::int32_t acc = 0;
+            for (int p = 0; p < k; p++)
+            {
+                acc += static_cast<std::int32_t>(x[p]) * row[p];
+            }
+            out[r] = acc;
+        }
+    }
+
+#ifdef SIMD_X86
+    __attribute__((target("avx2")))
+    inline std::int32_t hsum_epi32_avx2(__m256i v)
+    {
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                                  _mm256_extracti128_si256(v, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(s);
+    }
+
+    // pmaddubsw multiplies u8 x s8 pairs into int16 sums, pmaddwd by ones
+    // widens them to int32
+    __attribute__((target("avx2")))
+    inline __m256i madd(__m256i xv, const std::int8_t* w, __m256i ones)
+    {
+        __m256i wv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w));
+        return _mm256_madd_epi16(_mm256_maddubs_epi16(xv, wv), ones);
+    }
+
+    // Four rows per pass share every load of x
+    __attribute__((target("avx2")))
+    void dot_avx2(const std::uint8_t* x, const std::int8_t* w,
+                  int rows, int k, std::int32_t* out)
+    {
+        const __m256i ones = _mm256_set1_epi16(1);
+        int r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            const std::int8_t* r0 = w + static_cast<std::size_t>(r) * k;
+            const std::int8_t* r1 = r0 + k;
+            const std::int8_t* r2 = r1 + k;
+            const std::int8_t* r3 = r2 + k;
+            __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+            __m256i s2 = _mm256_setzero_si256(), s3 = _mm256_setzero_si256();
+            for (int p = 0; p < k; p += 32)
+            {
+                __m256i xv = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(x + p));
+                s0 = _mm256_add_epi32(s0, madd(xv, r0 + p, ones));
+                s1 = _mm256_add_epi32(s1, madd(xv, r1 + p, ones));
+                s2 = _mm256_add_epi32(s2, madd(xv, r2 + p, ones));
+                s3 = _mm256_add_epi32(s3, madd(xv, r3 + p, ones));
+            }
+            out[r] = hsum_epi32_avx2(s0);
+            out[r + 1] = hsum_epi32_avx2(s1);
+            out[r + 2] = hsum_epi32_avx2(s2);
+            out[r + 3] = hsum_epi32_avx2(s3);
+        }
+        for (; r < rows; r++)
+        {
+            const std::int8_t* row = w + static_cast<std::size_t>(r) * k;
+            __m256i s = _mm256_setzero_si256();
+            for (int p = 0; p < k; p += 32)
+            {
+                __m256i xv = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(x + p));
+                s = _mm256_add_epi32(s, madd(xv, row + p, ones));
+            }
+            out[r] = hsum_epi32_avx2(s);
+        }
+    }
+
+    // vpdpbusd does the u8 x s8 multiply, the 4-way add and the int32
+    // accumulate in one instruction
+    __attribute__((target("avx512f,avx512vnni")))
+    void dot_vnni(const std::uint8_t* x, const std::int8_t* w,
+                  int rows, int k, std::int32_t* out)
+    {
+        int r = 0;
+        for (; r + 4 <= rows; r += 4)
+        {
+            const std::int8_t* r0 = w + static_cast<std::size_t>(r) * k;
+            const std::int8_t* r1 = r0 + k;
+            const std::int8_t* r2 = r1 + k;
+            const std::int8_t* r3 = r2 + k;
+            __m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512();
+            __m512i s2 = _mm512_setzero_si512(), s3 = _mm512_setzero_si512();
+            for (int p = 0; p < k; p += 64)
+            {
+                __m512i xv = _mm512_loadu_si512(x + p);
+                s0 = _mm512_dpbusd_epi32(s0, xv, _mm512_loadu_si512(r0 + p));
+                s1 = _mm512_dpbusd_epi32(s1, xv, _mm512_loadu_si512(r1 + p));
+                s2 = _mm512_dpbusd_epi32(s2, xv, _mm512_loadu_si512(r2 + p));
+                s3 = _mm512_dpbusd_epi32(s3, xv, _mm512_loadu_si512(r3 + p));
+            }
+            out[r] = _mm512_reduce_add_epi32(s0);
+            out[r + 1] = _mm512_reduce_add_epi32(s1);
+            out[r + 2] = _mm512_reduce_add_epi32(s2);
+            out[r + 3] = _mm512_reduce_add_epi32(s3);
+        }
+        for (; r < rows; r++)
+        {
+            const std::int8_t* row = w + static_cast<std::size_t>(r) * k;
+            __m512i s = _mm512_setzero_si512();
+            for (int p = 0; p < k; p += 64)
+            {
+                s = _mm512_dpbusd_epi32(s, _mm512_loadu_si512(x + p),
+                                        _mm512_loadu_si512(row + p));
+            }
+            out[r] = _mm512_reduce_add_epi32(s);
+        }
+    }
+#endif
+
+    DotKernel dot_kernel()
+    {
+#ifdef SIMD_X86
+        static const DotKernel kernel = [] {
+            simd::isa level = simd::active_isa();
+            if (level >= simd::isa::avx512
+                && __builtin_cpu_supports("avx512vnni"))
+            {
+                return dot_vnni;
+            }
+            return level >= simd::isa::avx2 ? dot_avx2 : dot_scalar;
+        }();
+#else
+        static const DotKernel kernel = dot_scalar;
+#endif
+        return kernel;
+    }
+
+    // Grow-only int32 scratch for the dot products, kept per thread
+    thread_local std::vector<std::int32_t> products;
+}
+
+QuantizedDense::QuantizedDense(const Dense& layer) :
+        rows(layer.get_dims().rows), cols(layer.get_dims().cols),
+        padded_cols((cols + QUANT_K_ALIGNMENT - 1) / QUANT_K_ALIGNMENT
+                    * QUANT_K_ALIGNMENT),
+        weights(static_cast<std::size_t>(rows) * padded_cols, 0),
+        scales(rows), row_sums(rows), bias(rows),
+        activation_func(layer.get_activation())
+{
+    const Matrix& W = layer.get_weights();
+    const Matrix& b = layer.get_bias();
+    for (int r = 0; r < rows; r++)
+    {
+        const float* row = W.data() + static_cast<std::size_t>(r) * cols;
+        float max_abs = 0.0f;
+        for (int c = 0; c < cols; c++)
+        {
+            max_abs = std::max(max_abs, std::abs(row[c]));
+        }
+        scales[r] = max_abs > 0.0f ? max_abs / QUANT_WEIGHT_MAX : 1.0f;
+
+        std::int8_t* q = weights.data() + static_cast<std::size_t>(r)
+                                          * padded_cols;
+        std::int32_t sum = 0;
+        for (int c = 0; c < cols; c++)
+        {
+            q[c] = static_cast<std::int8_t>(std::lround(row[c] / scales[r]));
+            sum += q[c];
+        }
+        row_sums[r] = sum;
+        bias[r] = b.data()[r];
+    }
+}
+
+matrix_dims QuantizedDense::get_dims() const
+{
+    return matrix_dims{rows, cols};
+}
+
+int QuantizedDense::get_padded_cols() const
+{
+    return padded_cols;
+}
+
+ActivationType QuantizedDense::get_activation() const
+{
+    return activation_func;
+}
+
+std::size_t QuantizedDense::weight_bytes() const
+{
+    return weights.size() * sizeof(std::int8_t);
+}
+
+void QuantizedDense::operator() (const quantized_vector& x, float* out) const
+{
+    if (products.size() < static_cast<std::size_t>(rows))
+    {
+        products.resize(rows);
+    }
+    dot_kernel()(x.values, weights.data(), rows, padded_cols,
+                 products.data());
+
+    // requantize: undo the input zero point, rescale, add the bias and
+    // apply ReLU while the value is in a register
+    const bool relu = activation_func == activation::relu;
+    for (int r = 0; r < rows; r++)
+    {
+        std::int32_t acc = products[r] - x.zero_point * row_sums[r];
+        float v = x.scale * scales[r] * static_cast<float>(acc) + bias[r];
+        out[r] = (relu && v < 0.0f) ? 0.0f : v;
+    }
+
+    if (activation_func == activation::softmax)
+    {
+        Matrix probs = Matrix::view(out, rows, 1);
+        activation::softmax_inplace(probs);
+    }
+    else if (!relu)
+    {
+        const Matrix result = activation_func(Matrix::view(out, rows, 1));
+        std::copy(result.data(), result.data() + rows, out);
+    }
+}
+
+quantized_vector QuantizedDense::quantize(const float* x, int n,
+                                          std::uint8_t* q)
+{
+    float lo = 0.0f, hi = 0.0f;
+    for (int i = 0; i < n; i++)
+    {
+        lo = std::min(lo, x[i]);
+        hi = std::max(hi, x[i]);
+    }
+    const float scale = hi > lo ? (hi - lo) / QUANT_ACTIVATION_MAX : 1.0f;
+    const float inverse = 1.0f / scale;
+    const float zero_point = std::nearbyint(-lo * inverse);
+    for (int i = 0; i < n; i++)
+    {
+        // clamped in float so the loop vectorizes to a single convert
+        float v = std::nearbyint(x[i] * inverse) + zero_point;
+        v = std::min(std::max(v, 0.0f), float(QUANT_ACTIVATION_MAX));
+        q[i] = static_cast<std::uint8_t>(v);
+    }
+    return quantized_vector{q, scale, static_cast<int>(zero_point)};
+}
@@ -0,0 +1,81 @@
+#ifndef QUANTIZEDDENSE_H
+#define QUANTIZEDDENSE_H
+
+#include "Dense.h"
+#include <cstdint>
+#include <vector>
+
+// Largest quantized activation: 7-bit inputs keep every u8 x s8 pair sum
+// of pmaddubsw (2 * 127 * 127) clear of its int16 saturation
+#define QUANT_ACTIVATION_MAX 127
+#define QUANT_WEIGHT_MAX 127
+
+// Inner dimension padding of the int8 weight rows, one AVX-512 register
+#define QUANT_K_ALIGNMENT 64
+
+/**
+ * @brief An activation vector quantized as
+ * value[i] = scale * (q[i] - zero_point), q[i] in [0, QUANT_ACTIVATION_MAX].
+ */
+struct quantized_vector
+{
+    const std::uint8_t* values;
+    float scale;
+    int zero_point;
+};
+
+/**
+ * INT8 post-training-quantized copy of a Dense layer. Each weight row is
+ * scaled by its own max |w| into [-127, 127]; the layer then computes
+ * u8 activations x s8 weights -> int32 with VNNI (vpdpbusd) or AVX2
+ * (pmaddubsw) where available and a scalar loop otherwise, and requantizes
+ * the int32 sums back to fp32 with the bias and ReLU applied on the way.
+ */
+class QuantizedDense
+{
+private:
+    int rows;
+    int cols;
+    int padded_cols;
+    std::vector<std::int8_t> weights;   // rows x padded_cols, zero padded
+    std::vector<float> scales;          // per-row weight scale
+    std::vector<std::int32_t> row_sums; // per-row sum of the int8 weights
+    std::vector<float> bias;
+    ActivationType activation_func;
+
+public:
+    /**
+     * @brief Quantizes the weights of an fp32 layer.
+     */
+    explicit QuantizedDense(const Dense& layer);
+
+    // Getter for the weights' shape (output rows x input cols)
+    matrix_dims get_dims() const;
+
+    // Length of the quantized input expected by operator()
+    int get_padded_cols() const;
+
+    // Getter for the activation
+    ActivationType get_activation() const;
+
+    // Bytes held by the int8 weights
+    std::size_t weight_bytes() const;
+
+    /**
+     * @brief out = activation(W * x + b), with the int32 products
+     * requantized to fp32; ReLU is applied in the requantize loop.
+     * @param x Input of get_padded_cols() values, zero past the real
+     * columns.
+     * @param out get_dims().rows floats.
+     */
+    void operator() (const quantized_vector& x, float* out) const;
+
+    /**
+     * @brief Quantizes n floats into q[0..n) with the asymmetric range
+     * [min(x, 0), max(x, 0)] mapped onto [0, QUANT_ACTIVATION_MAX]; ReLU
+     * outputs therefore get a zero point of 0.
+     */
+    static quantized_vector quantize(const float* x, int n, std::uint8_t* q);
+};
+
+#endif //QUANTIZEDDENSE_H
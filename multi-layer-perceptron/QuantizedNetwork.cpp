@@ -0,0 +1,105 @@
+#include "QuantizedNetwork.h"
+#include <algorithm>
+
+namespace
+{
+    // Grow-only per-thread scratch: the fp32 layer outputs (ping-pong) and
+    // the quantized input of the current layer
+    struct Scratch
+    {
+        std::vector<float> values[2];
+        std::vector<std::uint8_t> quantized;
+    };
+
+    thread_local Scratch scratch;
+
+    template<typename T>
+    T* grow(std::vector<T>& buffer, std::size_t size)
+    {
+        if (buffer.size() < size)
+        {
+            buffer.resize(size);
+        }
+        return buffer.data();
+    }
+}
+
+QuantizedNetwork::QuantizedNetwork(const MlpNetwork& mlp)
+{
+    layers.reserve(mlp.get_layer_count());
+    for (int i = 0; i < mlp.get_layer_count(); i++)
+    {
+        layers.emplace_back(mlp.get_layer(i));
+    }
+}
+
+digit QuantizedNetwork::classify(const float* input) const
+{
+    const float* in = input;
+    int width = layers.front().get_dims().cols;
+    for (std::size_t i = 0; i < layers.size(); i++)
+    {
+        const QuantizedDense& layer = layers[i];
+        std::uint8_t* q = grow(scratch.quantized, layer.get_padded_cols());
+        quantized_vector x = QuantizedDense::quantize(in, width, q);
+        std::fill(q + width, q + layer.get_padded_cols(), 0);
+
+        width = layer.get_dims().rows;
+        float* out = grow(scratch.values[i % 2], width);
+        layer(x, out);
+        in = out;
+    }
+
+    // same tie-breaking as the fp32 path: first strictly larger wins
+    digit result{0, 0.0f};
+    for (int i = 0; i < width; i++)
+    {
+        if (in[i] > result.probability)
+        {
+            result = digit{static_cast<unsigned int>(i), in[i]};
+        }
+    }
+    return result;
+}
+
+digit QuantizedNetwork::operator()(const Matrix& img) const
+{
+    if (img.get_rows() * img.get_cols() != layers.front().get_dims().cols)
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+    return classify(img.data());
+}
+
+std::vector<digit> QuantizedNetwork::classify_batch(const Matrix& batch) const
+{
+    const int pixels = batch.get_rows();
+    const int n = batch.get_cols();
+    if (pixels != layers.front().get_dims().cols)
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+
+    std::vector<digit> digits;
+    digits.reserve(n);
+    std::vector<float> column(pixels);
+    for (int col = 0; col < n; col++)
+    {
+        for (int p = 0; p < pixels; p++)
+        {
+            column[p] = batch.data()[static_cast<std::size_t>(p) * n + col];
+        }
+        digits.push_back(classify(column.data()));
+    }
+    return digits;
+}
+
+std::size_t QuantizedNetwork::weight_bytes() const
+{
+    std::size_t bytes = 0;
+    for (const QuantizedDense& layer : layers)
+    {
+        bytes += layer.weight_bytes();
+    }
+    return bytes;
+}
@@ -0,0 +1,39 @@
+#ifndef QUANTIZEDNETWORK_H
+#define QUANTIZEDNETWORK_H
+
+#include "MlpNetwork.h"
+#include "QuantizedDense.h"
+#include <vector>
+
+/**
+ * INT8 inference mode of an MlpNetwork: every layer is a QuantizedDense
+ * built from the fp32 weights, and the activations are requantized to u8
+ * between layers. The int8 weights are a quarter of the fp32 bytes, which
+ * is what the memory-bound first layer pays for on every image.
+ */
+class QuantizedNetwork
+{
+private:
+    std::vector<QuantizedDense> layers;
+
+    // helper: runs every layer on one contiguous input vector
+    digit classify(const float* input) const;
+
+public:
+    /**
+     * @brief Quantizes every layer of the network (post-training, per-row
+     * weight scales); the fp32 network is not referenced afterwards.
+     */
+    explicit QuantizedNetwork(const MlpNetwork& mlp);
+
+    // Classifies one image (28x28 or 784x1)
+    digit operator() (const Matrix& img) const;
+
+    // Classifies a batch: column n of `batch` is the n-th flattened image
+    std::vector<digit> classify_batch(const Matrix& batch) const;
+
+    // Bytes held by the int8 weights of every layer
+    std::size_t weight_bytes() const;
+};
+
+#endif //QUANTIZEDNETWORK_H
@@ -0,0 +1,1236 @@
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    struct kernel_table
+    {
+        void (*add)(const float*, const float*, float*, int);
+        void (*mul)(const float*, const float*, float*, int);
+        void (*scale)(const float*, float, float*, int);
+        float (*sum)(const float*, int);
+        float (*sum_squares)(const float*, int);
+        void (*max)(const float*, const float*, float*, int);
+        float (*max_value)(const float*, int);
+        void (*offset)(const float*, float, float*, int);
+        void (*exp)(const float*, float*, int, simd::exp_accuracy);
+        void (*transpose)(const float*, int, float*, int, int, int);
+        void (*axpy)(float, const float*, float*, int);
+        void (*u8_to_float)(const std::uint8_t*, float, float*, int);
+        int (*nonzero)(const float*, int, int*);
+    };
+
+    // exp(x) = 2^k * exp(r), k = round(x / ln 2), r = x - k ln 2 in
+    // [-ln2/2, ln2/2]; ln 2 is split in two so r stays exact. The input is
+    // clamped so 2^k is a normal float.
+    const float EXP_LO = -87.0f;
+    const float EXP_HI = 88.0f;
+    const float LOG2E = 1.44269504088896341f;
+    const float LN2_HI = 0.693359375f;
+    const float LN2_LO = -2.12194440e-4f;
+    // accurate: minimax polynomial for (exp(r) - 1 - r) / r^2 (Cephes),
+    // about 1 ulp; fast: its degree-2 Taylor form, about 4e-5 relative
+    const float EXP_P0 = 1.9875691500e-4f;
+    const float EXP_P1 = 1.3981999507e-3f;
+    const float EXP_P2 = 8.3334519073e-3f;
+    const float EXP_P3 = 4.1665795894e-2f;
+    const float EXP_P4 = 1.6666665459e-1f;
+    const float EXP_P5 = 5.0000001201e-1f;
+    const float EXP_FAST_P0 = 1.0f / 24.0f;
+    const float EXP_FAST_P1 = 1.0f / 6.0f;
+    const float EXP_FAST_P2 = 0.5f;
+
+    // ---------------------------------------------------------------- scalar
+    void add_scalar(const float* a, const float* b, float* out, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = a[i] + b[i];
+        }
+    }
+
+    void mul_scalar(const float* a, const float* b, float* out, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = a[i] * b[i];
+        }
+    }
+
+    void scale_scalar(const float* a, float m, float* out, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = m * a[i];
+        }
+    }
+
+    float sum_scalar(const float* a, int n)
+    {
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 += a[i];
+            s1 += a[i + 1];
+            s2 += a[i + 2];
+            s3 += a[i + 3];
+        }
+        for (; i < n; i++)
+        {
+            s0 += a[i];
+        }
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    float sum_squares_scalar(const float* a, int n)
+    {
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 += a[i] * a[i];
+            s1 += a[i + 1] * a[i + 1];
+            s2 += a[i + 2] * a[i + 2];
+            s3 += a[i + 3] * a[i + 3];
+        }
+        for (; i < n; i++)
+        {
+            s0 += a[i] * a[i];
+        }
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    void max_scalar(const float* a, const float* b, float* out, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = a[i] > b[i] ? a[i] : b[i];
+        }
+    }
+
+    float max_value_scalar(const float* a, int n)
+    {
+        float m = a[0];
+        for (int i = 1; i < n; i++)
+        {
+            m = a[i] > m ? a[i] : m;
+        }
+        return m;
+    }
+
+    void offset_scalar(const float* a, float c, float* out, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = a[i] + c;
+        }
+    }
+
+    void exp_scalar(const float* a, float* out, int n,
+                    simd::exp_accuracy accuracy)
+    {
+        const bool fast = accuracy == simd::exp_accuracy::fast;
+        for (int i = 0; i < n; i++)
+        {
+            float x = std::min(std::max(a[i], EXP_LO), EXP_HI);
+            float k = std::nearbyint(x * LOG2E);
+            float r = x - k * LN2_HI - k * LN2_LO;
+            float p;
+            if (fast)
+            {
+                p = (EXP_FAST_P0 * r + EXP_FAST_P1) * r + EXP_FAST_P2;
+            }
+            else
+            {
+                p = ((((EXP_P0 * r + EXP_P1) * r + EXP_P2) * r + EXP_P3) * r
+                     + EXP_P4) * r + EXP_P5;
+            }
+            float y = p * r * r + r + 1.0f;
+            std::int32_t bits = (static_cast<std::int32_t>(k) + 127) << 23;
+            float scale;
+            std::memcpy(&scale, &bits, sizeof(scale));
+            out[i] = y * scale;
+        }
+    }
+
+    void transpose_scalar(const float* src, int lds, float* dst, int ldd,
+                          int rows, int cols)
+    {
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                dst[j * ldd + i] = src[i * lds + j];
+            }
+        }
+    }
+
+    void axpy_scalar(float alpha, const float* x, float* y, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            y[i] += alpha * x[i];
+        }
+    }
+
+    void u8_to_float_scalar(const std::uint8_t* src, float scale, float* out,
+                            int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = scale * src[i];
+        }
+    }
+
+    // branch-free: every index is written, only nonzeros advance the end
+    int nonzero_scalar(const float* a, int n, int* idx)
+    {
+        int count = 0;
+        for (int i = 0; i < n; i++)
+        {
+            idx[count] = i;
+            count += a[i] != 0.0f ? 1 : 0;
+        }
+        return count;
+    }
+
+    const kernel_table SCALAR_KERNELS = {add_scalar, mul_scalar, scale_scalar,
+                                         sum_scalar, sum_squares_scalar,
+                                         max_scalar, max_value_scalar,
+                                         offset_scalar, exp_scalar,
+                                         transpose_scalar, axpy_scalar,
+                                         u8_to_float_scalar, nonzero_scalar};
+
+#ifdef SIMD_X86
+    // ------------------------------------------------------------------- SSE
+    __attribute__((target("sse2")))
+    inline float hsum_sse(__m128 v)
+    {
+        __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(v, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+    }
+
+    __attribute__((target("sse2")))
+    void add_sse(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i),
+                                              _mm_loadu_ps(b + i)));
+        }
+        add_scalar(a + i, b + i, out + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    void mul_sse(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i),
+                                              _mm_loadu_ps(b + i)));
+        }
+        mul_scalar(a + i, b + i, out + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    void scale_sse(const float* a, float m, float* out, int n)
+    {
+        __m128 vm = _mm_set1_ps(m);
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(out + i, _mm_mul_ps(vm, _mm_loadu_ps(a + i)));
+        }
+        scale_scalar(a + i, m, out + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    float sum_sse(const float* a, int n)
+    {
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+        __m128 s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            s0 = _mm_add_ps(s0, _mm_loadu_ps(a + i));
+            s1 = _mm_add_ps(s1, _mm_loadu_ps(a + i + 4));
+            s2 = _mm_add_ps(s2, _mm_loadu_ps(a + i + 8));
+            s3 = _mm_add_ps(s3, _mm_loadu_ps(a + i + 12));
+        }
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 = _mm_add_ps(s0, _mm_loadu_ps(a + i));
+        }
+        float total = hsum_sse(_mm_add_ps(_mm_add_ps(s0, s1),
+                                          _mm_add_ps(s2, s3)));
+        return total + sum_scalar(a + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    float sum_squares_sse(const float* a, int n)
+    {
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+        __m128 s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128 v0 = _mm_loadu_ps(a + i);
+            __m128 v1 = _mm_loadu_ps(a + i + 4);
+            __m128 v2 = _mm_loadu_ps(a + i + 8);
+            __m128 v3 = _mm_loadu_ps(a + i + 12);
+            s0 = _mm_add_ps(s0, _mm_mul_ps(v0, v0));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(v1, v1));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(v2, v2));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(v3, v3));
+        }
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 v0 = _mm_loadu_ps(a + i);
+            s0 = _mm_add_ps(s0, _mm_mul_ps(v0, v0));
+        }
+        float total = hsum_sse(_mm_add_ps(_mm_add_ps(s0, s1),
+                                          _mm_add_ps(s2, s3)));
+        return total + sum_squares_scalar(a + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    void max_sse(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(out + i, _mm_max_ps(_mm_loadu_ps(a + i),
+                                              _mm_loadu_ps(b + i)));
+        }
+        max_scalar(a + i, b + i, out + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    float max_value_sse(const float* a, int n)
+    {
+        if (n < 4)
+        {
+            return max_value_scalar(a, n);
+        }
+        __m128 m = _mm_loadu_ps(a);
+        int i = 4;
+        for (; i + 4 <= n; i += 4)
+        {
+            m = _mm_max_ps(m, _mm_loadu_ps(a + i));
+        }
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+        float result = _mm_cvtss_f32(m);
+        return i < n ? std::max(result, max_value_scalar(a + i, n - i))
+                     : result;
+    }
+
+    __attribute__((target("sse2")))
+    void offset_sse(const float* a, float c, float* out, int n)
+    {
+        __m128 vc = _mm_set1_ps(c);
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), vc));
+        }
+        offset_scalar(a + i, c, out + i, n - i);
+    }
+
+    __attribute__((target("sse2")))
+    inline __m128 exp_sse(__m128 x, bool fast)
+    {
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)),
+                       _mm_set1_ps(EXP_HI));
+        __m128i ki = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(LOG2E)));
+        __m128 k = _mm_cvtepi32_ps(ki);
+        __m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(LN2_HI)));
+        r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(LN2_LO)));
+        __m128 p;
+        if (fast)
+        {
+            p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(EXP_FAST_P0), r),
+                           _mm_set1_ps(EXP_FAST_P1));
+            p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_FAST_P2));
+        }
+        else
+        {
+            p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(EXP_P0), r),
+                           _mm_set1_ps(EXP_P1));
+            p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P2));
+            p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P3));
+            p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P4));
+            p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P5));
+        }
+        __m128 y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r),
+                              _mm_add_ps(r, _mm_set1_ps(1.0f)));
+        __m128i bits = _mm_slli_epi32(_mm_add_epi32(ki, _mm_set1_epi32(127)),
+                                      23);
+        return _mm_mul_ps(y, _mm_castsi128_ps(bits));
+    }
+
+    __attribute__((target("sse2")))
+    void exp_sse(const float* a, float* out, int n,
+                 simd::exp_accuracy accuracy)
+    {
+        const bool fast = accuracy == simd::exp_accuracy::fast;
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(out + i, exp_sse(_mm_loadu_ps(a + i), fast));
+        }
+        exp_scalar(a + i, out + i, n - i, accuracy);
+    }
+
+    // 4 x 4 register tiles; the ragged right and bottom edges go scalar
+    __attribute__((target("sse2")))
+    void transpose_sse(const float* src, int lds, float* dst, int ldd,
+                       int rows, int cols)
+    {
+        const int rows4 = rows & ~3;
+        const int cols4 = cols & ~3;
+        for (int i = 0; i < rows4; i += 4)
+        {
+            for (int j = 0; j < cols4; j += 4)
+            {
+                __m128 r0 = _mm_loadu_ps(src + i * lds + j);
+                __m128 r1 = _mm_loadu_ps(src + (i + 1) * lds + j);
+                __m128 r2 = _mm_loadu_ps(src + (i + 2) * lds + j);
+                __m128 r3 = _mm_loadu_ps(src + (i + 3) * lds + j);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                _mm_storeu_ps(dst + j * ldd + i, r0);
+                _mm_storeu_ps(dst + (j + 1) * ldd + i, r1);
+                _mm_storeu_ps(dst + (j + 2) * ldd + i, r2);
+                _mm_storeu_ps(dst + (j + 3) * ldd + i, r3);
+            }
+        }
+        transpose_scalar(src + cols4, lds, dst + cols4 * ldd, ldd,
+                         rows, cols - cols4);
+        transpose_scalar(src + rows4 * lds, lds, dst + rows4, ldd,
+                         rows - rows4, cols4);
+    }
+
+    __attribute__((target("sse2")))
+    void axpy_sse(float alpha, const float* x, float* y, int n)
+    {
+        __m128 va = _mm_set1_ps(alpha);
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                            _mm_mul_ps(va,
+                                                       _mm_loadu_ps(x + i))));
+        }
+        axpy_scalar(alpha, x + i, y + i, n - i);
+    }
+
+    // 16 bytes widened to 4 x 4 floats through 16- and 32-bit lanes
+    __attribute__((target("sse2")))
+    void u8_to_float_sse(const std::uint8_t* src, float scale, float* out,
+                         int n)
+    {
+        const __m128 vs = _mm_set1_ps(scale);
+        const __m128i zero = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(src + i));
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+            __m128i words[4] = {_mm_unpacklo_epi16(lo, zero),
+                                _mm_unpackhi_epi16(lo, zero),
+                                _mm_unpacklo_epi16(hi, zero),
+                                _mm_unpackhi_epi16(hi, zero)};
+            for (int k = 0; k < 4; k++)
+            {
+                _mm_storeu_ps(out + i + 4 * k,
+                              _mm_mul_ps(vs, _mm_cvtepi32_ps(words[k])));
+            }
+        }
+        u8_to_float_scalar(src + i, scale, out + i, n - i);
+    }
+
+    // compare four lanes, then emit the set bits of the lane mask
+    __attribute__((target("sse2")))
+    int nonzero_sse(const float* a, int n, int* idx)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        int count = 0;
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            int mask = _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(a + i),
+                                                     zero));
+            while (mask != 0)
+            {
+                idx[count++] = i + __builtin_ctz(mask);
+                mask &= mask - 1;
+            }
+        }
+        for (; i < n; i++)
+        {
+            if (a[i] != 0.0f)
+            {
+                idx[count++] = i;
+            }
+        }
+        return count;
+    }
+
+    const kernel_table SSE_KERNELS = {add_sse, mul_sse, scale_sse,
+                                      sum_sse, sum_squares_sse,
+                                      max_sse, max_value_sse,
+                                      offset_sse, exp_sse, transpose_sse,
+                                      axpy_sse, u8_to_float_sse, nonzero_sse};
+
+    // ------------------------------------------------------------ AVX2 + FMA
+    __attribute__((target("avx2,fma")))
+    inline float hsum_avx2(__m256 v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+                              _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_movehdup_ps(s));
+        return _mm_cvtss_f32(s);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void add_avx2(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i),
+                                                    _mm256_loadu_ps(b + i)));
+        }
+        add_scalar(a + i, b + i, out + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void mul_avx2(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+                                                    _mm256_loadu_ps(b + i)));
+        }
+        mul_scalar(a + i, b + i, out + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void scale_avx2(const float* a, float m, float* out, int n)
+    {
+        __m256 vm = _mm256_set1_ps(m);
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(vm,
+                                                    _mm256_loadu_ps(a + i)));
+        }
+        scale_scalar(a + i, m, out + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    float sum_avx2(const float* a, int n)
+    {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            s0 = _mm256_add_ps(s0, _mm256_loadu_ps(a + i));
+            s1 = _mm256_add_ps(s1, _mm256_loadu_ps(a + i + 8));
+            s2 = _mm256_add_ps(s2, _mm256_loadu_ps(a + i + 16));
+            s3 = _mm256_add_ps(s3, _mm256_loadu_ps(a + i + 24));
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            s0 = _mm256_add_ps(s0, _mm256_loadu_ps(a + i));
+        }
+        float total = hsum_avx2(_mm256_add_ps(_mm256_add_ps(s0, s1),
+                                              _mm256_add_ps(s2, s3)));
+        return total + sum_scalar(a + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    float sum_squares_avx2(const float* a, int n)
+    {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256 v0 = _mm256_loadu_ps(a + i);
+            __m256 v1 = _mm256_loadu_ps(a + i + 8);
+            __m256 v2 = _mm256_loadu_ps(a + i + 16);
+            __m256 v3 = _mm256_loadu_ps(a + i + 24);
+            s0 = _mm256_fmadd_ps(v0, v0, s0);
+            s1 = _mm256_fmadd_ps(v1, v1, s1);
+            s2 = _mm256_fmadd_ps(v2, v2, s2);
+            s3 = _mm256_fmadd_ps(v3, v3, s3);
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 v0 = _mm256_loadu_ps(a + i);
+            s0 = _mm256_fmadd_ps(v0, v0, s0);
+        }
+        float total = hsum_avx2(_mm256_add_ps(_mm256_add_ps(s0, s1),
+                                              _mm256_add_ps(s2, s3)));
+        return total + sum_squares_scalar(a + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void max_avx2(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(out + i, _mm256_max_ps(_mm256_loadu_ps(a + i),
+                                                    _mm256_loadu_ps(b + i)));
+        }
+        max_scalar(a + i, b + i, out + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    float max_value_avx2(const float* a, int n)
+    {
+        if (n < 8)
+        {
+            return max_value_sse(a, n);
+        }
+        __m256 m = _mm256_loadu_ps(a);
+        int i = 8;
+        for (; i + 8 <= n; i += 8)
+        {
+            m = _mm256_max_ps(m, _mm256_loadu_ps(a + i));
+        }
+        __m128 h = _mm_max_ps(_mm256_castps256_ps128(m),
+                              _mm256_extractf128_ps(m, 1));
+        h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+        h = _mm_max_ss(h, _mm_movehdup_ps(h));
+        float result = _mm_cvtss_f32(h);
+        return i < n ? std::max(result, max_value_scalar(a + i, n - i))
+                     : result;
+    }
+
+    __attribute__((target("avx2,fma")))
+    void offset_avx2(const float* a, float c, float* out, int n)
+    {
+        __m256 vc = _mm256_set1_ps(c);
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i),
+                                                    vc));
+        }
+        offset_scalar(a + i, c, out + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline __m256 exp_avx2(__m256 x, bool fast)
+    {
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)),
+                          _mm256_set1_ps(EXP_HI));
+        __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)),
+                                   _MM_FROUND_TO_NEAREST_INT
+                                   | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2_HI), x);
+        r = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2_LO), r);
+        __m256 p;
+        if (fast)
+        {
+            p = _mm256_fmadd_ps(_mm256_set1_ps(EXP_FAST_P0), r,
+                                _mm256_set1_ps(EXP_FAST_P1));
+            p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_FAST_P2));
+        }
+        else
+        {
+            p = _mm256_fmadd_ps(_mm256_set1_ps(EXP_P0), r,
+                                _mm256_set1_ps(EXP_P1));
+            p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P2));
+            p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P3));
+            p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P4));
+            p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P5));
+        }
+        __m256 y = _mm256_fmadd_ps(_mm256_mul_ps(p, r), r,
+                                   _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+        __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(
+                _mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(y, _mm256_castsi256_ps(bits));
+    }
+
+    __attribute__((target("avx2,fma")))
+    void exp_avx2(const float* a, float* out, int n,
+                  simd::exp_accuracy accuracy)
+    {
+        const bool fast = accuracy == simd::exp_accuracy::fast;
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(out + i, exp_avx2(_mm256_loadu_ps(a + i), fast));
+        }
+        exp_sse(a + i, out + i, n - i, accuracy);
+    }
+
+    // 8 x 8 register tiles; the ragged edges go to the 4 x 4 kernel
+    __attribute__((target("avx2,fma")))
+    void transpose_avx2(const float* src, int lds, float* dst, int ldd,
+                        int rows, int cols)
+    {
+        const int rows8 = rows & ~7;
+        const int cols8 = cols & ~7;
+        __m256 r[8], t[8];
+        for (int i = 0; i < rows8; i += 8)
+        {
+            for (int j = 0; j < cols8; j += 8)
+            {
+                for (int k = 0; k < 8; k++)
+                {
+                    r[k] = _mm256_loadu_ps(src + (i + k) * lds + j);
+                }
+                for (int k = 0; k < 8; k += 2)
+                {
+                    t[k] = _mm256_unpacklo_ps(r[k], r[k + 1]);
+                    t[k + 1] = _mm256_unpackhi_ps(r[k], r[k + 1]);
+                }
+                for (int k = 0; k < 8; k += 4)
+                {
+                    r[k] = _mm256_shuffle_ps(t[k], t[k + 2], 0x44);
+                    r[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], 0xEE);
+                    r[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], 0x44);
+                    r[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], 0xEE);
+                }
+                for (int k = 0; k < 4; k++)
+                {
+                    _mm256_storeu_ps(dst + (j + k) * ldd + i,
+                                     _mm256_permute2f128_ps(r[k], r[k + 4],
+                                                            0x20));
+                    _mm256_storeu_ps(dst + (j + k + 4) * ldd + i,
+                                     _mm256_permute2f128_ps(r[k], r[k + 4],
+                                                            0x31));
+                }
+            }
+        }
+        transpose_sse(src + cols8, lds, dst + cols8 * ldd, ldd,
+                      rows, cols - cols8);
+        transpose_sse(src + rows8 * lds, lds, dst + rows8, ldd,
+                      rows - rows8, cols8);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void axpy_avx2(float alpha, const float* x, float* y, int n)
+    {
+        __m256 va = _mm256_set1_ps(alpha);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i),
+                                                    _mm256_loadu_ps(y + i)));
+            _mm256_storeu_ps(y + i + 8,
+                             _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i + 8),
+                                             _mm256_loadu_ps(y + i + 8)));
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i),
+                                                    _mm256_loadu_ps(y + i)));
+        }
+        axpy_scalar(alpha, x + i, y + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void u8_to_float_avx2(const std::uint8_t* src, float scale, float* out,
+                          int n)
+    {
+        const __m256 vs = _mm256_set1_ps(scale);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(src + i));
+            __m256i lo = _mm256_cvtepu8_epi32(bytes);
+            __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(vs,
+                                                    _mm256_cvtepi32_ps(lo)));
+            _mm256_storeu_ps(out + i + 8,
+                             _mm256_mul_ps(vs, _mm256_cvtepi32_ps(hi)));
+        }
+        u8_to_float_scalar(src + i, scale, out + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    int nonzero_avx2(const float* a, int n, int* idx)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        int count = 0;
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(
+                    _mm256_loadu_ps(a + i), zero, _CMP_NEQ_UQ));
+            while (mask != 0)
+            {
+                idx[count++] = i + __builtin_ctz(mask);
+                mask &= mask - 1;
+            }
+        }
+        for (; i < n; i++)
+        {
+            if (a[i] != 0.0f)
+            {
+                idx[count++] = i;
+            }
+        }
+        return count;
+    }
+
+    const kernel_table AVX2_KERNELS = {add_avx2, mul_avx2, scale_avx2,
+                                       sum_avx2, sum_squares_avx2,
+                                       max_avx2, max_value_avx2,
+                                       offset_avx2, exp_avx2, transpose_avx2,
+                                       axpy_avx2, u8_to_float_avx2,
+                                       nonzero_avx2};
+
+    // --------------------------------------------------------------- AVX-512
+    // Tails use masked loads/stores instead of a scalar loop.
+    __attribute__((target("avx512f")))
+    inline __mmask16 tail_mask(int remaining)
+    {
+        return static_cast<__mmask16>((1u << remaining) - 1u);
+    }
+
+    __attribute__((target("avx512f")))
+    void add_avx512(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm512_storeu_ps(out + i, _mm512_add_ps(_mm512_loadu_ps(a + i),
+                                                    _mm512_loadu_ps(b + i)));
+        }
+        if (i < n)
+        {
+            __mmask16 m = tail_mask(n - i);
+            _mm512_mask_storeu_ps(out + i, m, _mm512_add_ps(
+                    _mm512_maskz_loadu_ps(m, a + i),
+                    _mm512_maskz_loadu_ps(m, b + i)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void mul_avx512(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(a + i),
+                                                    _mm512_loadu_ps(b + i)));
+        }
+        if (i < n)
+        {
+            __mmask16 m = tail_mask(n - i);
+            _mm512_mask_storeu_ps(out + i, m, _mm512_mul_ps(
+                    _mm512_maskz_loadu_ps(m, a + i),
+                    _mm512_maskz_loadu_ps(m, b + i)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void scale_avx512(const float* a, float m, float* out, int n)
+    {
+        __m512 vm = _mm512_set1_ps(m);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm512_storeu_ps(out + i, _mm512_mul_ps(vm,
+                                                    _mm512_loadu_ps(a + i)));
+        }
+        if (i < n)
+        {
+            __mmask16 mask = tail_mask(n - i);
+            _mm512_mask_storeu_ps(out + i, mask, _mm512_mul_ps(
+                    vm, _mm512_maskz_loadu_ps(mask, a + i)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    float sum_avx512(const float* a, int n)
+    {
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+        int i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            s0 = _mm512_add_ps(s0, _mm512_loadu_ps(a + i));
+            s1 = _mm512_add_ps(s1, _mm512_loadu_ps(a + i + 16));
+            s2 = _mm512_add_ps(s2, _mm512_loadu_ps(a + i + 32));
+            s3 = _mm512_add_ps(s3, _mm512_loadu_ps(a + i + 48));
+        }
+        for (; i + 16 <= n; i += 16)
+        {
+            s0 = _mm512_add_ps(s0, _mm512_loadu_ps(a + i));
+        }
+        if (i < n)
+        {
+            s1 = _mm512_add_ps(s1, _mm512_maskz_loadu_ps(tail_mask(n - i),
+                                                         a + i));
+        }
+        return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(s0, s1),
+                                                  _mm512_add_ps(s2, s3)));
+    }
+
+    __attribute__((target("avx512f")))
+    float sum_squares_avx512(const float* a, int n)
+    {
+        __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+        __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+        int i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            __m512 v0 = _mm512_loadu_ps(a + i);
+            __m512 v1 = _mm512_loadu_ps(a + i + 16);
+            __m512 v2 = _mm512_loadu_ps(a + i + 32);
+            __m512 v3 = _mm512_loadu_ps(a + i + 48);
+            s0 = _mm512_fmadd_ps(v0, v0, s0);
+            s1 = _mm512_fmadd_ps(v1, v1, s1);
+            s2 = _mm512_fmadd_ps(v2, v2, s2);
+            s3 = _mm512_fmadd_ps(v3, v3, s3);
+        }
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 v0 = _mm512_loadu_ps(a + i);
+            s0 = _mm512_fmadd_ps(v0, v0, s0);
+        }
+        if (i < n)
+        {
+            __m512 v = _mm512_maskz_loadu_ps(tail_mask(n - i), a + i);
+            s1 = _mm512_fmadd_ps(v, v, s1);
+        }
+        return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(s0, s1),
+                                                  _mm512_add_ps(s2, s3)));
+    }
+
+    __attribute__((target("avx512f")))
+    void max_avx512(const float* a, const float* b, float* out, int n)
+    {
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm512_storeu_ps(out + i, _mm512_max_ps(_mm512_loadu_ps(a + i),
+                                                    _mm512_loadu_ps(b + i)));
+        }
+        if (i < n)
+        {
+            __mmask16 m = tail_mask(n - i);
+            _mm512_mask_storeu_ps(out + i, m, _mm512_max_ps(
+                    _mm512_maskz_loadu_ps(m, a + i),
+                    _mm512_maskz_loadu_ps(m, b + i)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    float max_value_avx512(const float* a, int n)
+    {
+        // masked-off lanes keep -inf, so the tail needs no special case
+        __m512 m = _mm512_set1_ps(-INFINITY);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            m = _mm512_max_ps(m, _mm512_loadu_ps(a + i));
+        }
+        if (i < n)
+        {
+            m = _mm512_mask_max_ps(m, tail_mask(n - i), m,
+                                   _mm512_maskz_loadu_ps(tail_mask(n - i),
+                                                         a + i));
+        }
+        return _mm512_reduce_max_ps(m);
+    }
+
+    __attribute__((target("avx512f")))
+    void offset_avx512(const float* a, float c, float* out, int n)
+    {
+        __m512 vc = _mm512_set1_ps(c);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm512_storeu_ps(out + i, _mm512_add_ps(_mm512_loadu_ps(a + i),
+                                                    vc));
+        }
+        if (i < n)
+        {
+            __mmask16 mask = tail_mask(n - i);
+            _mm512_mask_storeu_ps(out + i, mask, _mm512_add_ps(
+                    _mm512_maskz_loadu_ps(mask, a + i), vc));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512 exp_avx512(__m512 x, bool fast)
+    {
+        x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)),
+                          _mm512_set1_ps(EXP_HI));
+        __m512 k = _mm512_roundscale_ps(_mm512_mul_ps(x,
+                                                      _mm512_set1_ps(LOG2E)),
+                                        _MM_FROUND_TO_NEAREST_INT
+                                        | _MM_FROUND_NO_EXC);
+        __m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2_HI), x);
+        r = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2_LO), r);
+        __m512 p;
+        if (fast)
+        {
+            p = _mm512_fmadd_ps(_mm512_set1_ps(EXP_FAST_P0), r,
+                                _mm512_set1_ps(EXP_FAST_P1));
+            p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_FAST_P2));
+        }
+        else
+        {
+            p = _mm512_fmadd_ps(_mm512_set1_ps(EXP_P0), r,
+                                _mm512_set1_ps(EXP_P1));
+            p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P2));
+            p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P3));
+            p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P4));
+            p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P5));
+        }
+        __m512 y = _mm512_fmadd_ps(_mm512_mul_ps(p, r), r,
+                                   _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+        // y * 2^k without building the exponent bits by hand
+        return _mm512_scalef_ps(y, k);
+    }
+
+    __attribute__((target("avx512f")))
+    void exp_avx512(const float* a, float* out, int n,
+                    simd::exp_accuracy accuracy)
+    {
+        const bool fast = accuracy == simd::exp_accuracy::fast;
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm512_storeu_ps(out + i, exp_avx512(_mm512_loadu_ps(a + i),
+                                                 fast));
+        }
+        if (i < n)
+        {
+            __mmask16 mask = tail_mask(n - i);
+            _mm512_mask_storeu_ps(out + i, mask, exp_avx512(
+                    _mm512_maskz_loadu_ps(mask, a + i), fast));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void axpy_avx512(float alpha, const float* x, float* y, int n)
+    {
+        __m512 va = _mm512_set1_ps(alpha);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i),
+                                                    _mm512_loadu_ps(y + i)));
+        }
+        if (i < n)
+        {
+            __mmask16 mask = tail_mask(n - i);
+            _mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(
+                    va, _mm512_maskz_loadu_ps(mask, x + i),
+                    _mm512_maskz_loadu_ps(mask, y + i)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void u8_to_float_avx512(const std::uint8_t* src, float scale, float* out,
+                            int n)
+    {
+        const __m512 vs = _mm512_set1_ps(scale);
+        int i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512i wide = _mm512_cvtepu8_epi32(_mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(src + i)));
+            _mm512_storeu_ps(out + i, _mm512_mul_ps(vs,
+                                                    _mm512_cvtepi32_ps(wide)));
+        }
+        u8_to_float_scalar(src + i, scale, out + i, n - i);
+    }
+
+    // the lane indices of the nonzeros are compressed straight into idx
+    __attribute__((target("avx512f")))
+    int nonzero_avx512(const float* a, int n, int* idx)
+    {
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+                                                10, 11, 12, 13, 14, 15);
+        int count = 0;
+        for (int i = 0; i < n; i += 16)
+        {
+            __mmask16 valid = n - i >= 16 ? __mmask16(0xFFFF)
+                                          : tail_mask(n - i);
+            __mmask16 mask = _mm512_mask_cmp_ps_mask(
+                    valid, _mm512_maskz_loadu_ps(valid, a + i), zero,
+                    _CMP_NEQ_UQ);
+            _mm512_mask_compressstoreu_epi32(
+                    idx + count, mask,
+                    _mm512_add_epi32(lanes, _mm512_set1_epi32(i)));
+            count += __builtin_popcount(mask);
+        }
+        return count;
+    }
+
+    const kernel_table AVX512_KERNELS = {add_avx512, mul_avx512, scale_avx512,
+                                         sum_avx512, sum_squares_avx512,
+                                         max_avx512, max_value_avx512,
+                                         offset_avx512, exp_avx512,
+                                         transpose_avx2, axpy_avx512,
+                                         u8_to_float_avx512, nonzero_avx512};
+#endif
+
+    simd::isa detect_isa()
+    {
+        simd::isa level = simd::isa::scalar;
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+        {
+            level = simd::isa::sse;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            level = simd::isa::avx2;
+        }
+        if (level == simd::isa::avx2 && __builtin_cpu_supports("avx512f"))
+        {
+            level = simd::isa::avx512;
+        }
+#endif
+        const char* cap = std::getenv(SIMD_ISA_ENV);
+        if (cap != nullptr)
+        {
+            for (simd::isa l : {simd::isa::scalar, simd::isa::sse,
+                                simd::isa::avx2, simd::isa::avx512})
+            {
+                if (std::strcmp(cap, simd::isa_name(l)) == 0 && l < level)
+                {
+                    level = l;
+                }
+            }
+        }
+        return level;
+    }
+
+    const kernel_table& kernels()
+    {
+        static const kernel_table& table = [] () -> const kernel_table&
+        {
+            switch (simd::active_isa())
+            {
+#ifdef SIMD_X86
+                case simd::isa::avx512: return AVX512_KERNELS;
+                case simd::isa::avx2:   return AVX2_KERNELS;
+                case simd::isa::sse:    return SSE_KERNELS;
+#endif
+                default:                return SCALAR_KERNELS;
+            }
+        }();
+        return table;
+    }
+}
+
+
+simd::isa simd::active_isa()
+{
+    static const isa level = detect_isa();
+    return level;
+}
+
+const char* simd::isa_name(isa level)
+{
+    switch (level)
+    {
+        case isa::sse:    return "sse";
+        case isa::avx2:   return "avx2";
+        case isa::avx512: return "avx512";
+        default:          return "scalar";
+    }
+}
+
+void simd::add(const float* a, const float* b, float* out, int n)
+{
+    kernels().add(a, b, out, n);
+}
+
+void simd::mul(const float* a, const float* b, float* out, int n)
+{
+    kernels().mul(a, b, out, n);
+}
+
+void simd::scale(const float* a, float m, float* out, int n)
+{
+    kernels().scale(a, m, out, n);
+}
+
+float simd::sum(const float* a, int n)
+{
+    return kernels().sum(a, n);
+}
+
+float simd::sum_squares(const float* a, int n)
+{
+    return kernels().sum_squares(a, n);
+}
+
+void simd::max(const float* a, const float* b, float* out, int n)
+{
+    kernels().max(a, b, out, n);
+}
+
+float simd::max_value(const float* a, int n)
+{
+    return kernels().max_value(a, n);
+}
+
+void simd::offset(const float* a, float c, float* out, int n)
+{
+    kernels().offset(a, c, out, n);
+}
+
+void simd::exp(const float* a, float* out, int n, exp_accuracy accuracy)
+{
+    kernels().exp(a, out, n, accuracy);
+}
+
+void simd::transpose(const float* src, int lds, float* dst, int ldd,
+                     int rows, int cols)
+{
+    kernels().transpose(src, lds, dst, ldd, rows, cols);
+}
+
+void simd::axpy(float alpha, const float* x, float* y, int n)
+{
+    kernels().axpy(alpha, x, y, n);
+}
+
+void simd::u8_to_float(const std::uint8_t* src, float scale, float* out,
+                       int n)
+{
+    kernels().u8_to_float(src, scale, out, n);
+}
+
+int simd::nonzero(const float* a, int n, int* idx)
+{
+    return kernels().nonzero(a, n, idx);
+}
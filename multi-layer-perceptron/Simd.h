@@ -0,0 +1,122 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#endif
+
+// Environment variable that caps the instruction set picked at runtime
+// (one of "scalar", "sse", "avx2", "avx512"), e.g. to test the fallbacks.
+#define SIMD_ISA_ENV "MLP_ISA"
+
+namespace simd
+{
+    /**
+     * @brief Instruction-set levels, ordered so a higher level implies
+     * every lower one. avx2 also requires FMA; avx512 requires AVX-512F.
+     */
+    enum class isa
+    {
+        scalar,
+        sse,
+        avx2,
+        avx512
+    };
+
+    /**
+     * @brief The best level supported by this CPU (queried via CPUID once),
+     * capped by the SIMD_ISA_ENV environment variable if it is set.
+     */
+    isa active_isa();
+
+    const char* isa_name(isa level);
+
+    /**
+     * @brief Polynomial used by exp(): accurate is within about 1 ulp of
+     * std::exp, fast uses a shorter polynomial (about 4e-5 relative error).
+     */
+    enum class exp_accuracy
+    {
+        accurate,
+        fast
+    };
+
+    /**
+     * @brief out[i] = a[i] + b[i]. out may alias a or b.
+     */
+    void add(const float* a, const float* b, float* out, int n);
+
+    /**
+     * @brief out[i] = a[i] * b[i] (element-wise). out may alias a or b.
+     */
+    void mul(const float* a, const float* b, float* out, int n);
+
+    /**
+     * @brief out[i] = m * a[i]. out may alias a.
+     */
+    void scale(const float* a, float m, float* out, int n);
+
+    /**
+     * @brief out[i] = scale * src[i], widening bytes (e.g. 8-bit pixels)
+     * to floats.
+     */
+    void u8_to_float(const std::uint8_t* src, float scale, float* out, int n);
+
+    /**
+     * @brief y[i] += alpha * x[i], the row update of Gaussian elimination.
+     * x and y must not overlap.
+     */
+    void axpy(float alpha, const float* x, float* y, int n);
+
+    /**
+     * @brief Writes the indices i with a[i] != 0 to idx in increasing
+     * order and returns their count. idx needs room for n indices.
+     */
+    int nonzero(const float* a, int n, int* idx);
+
+    /**
+     * @brief Sum of a[0..n), accumulated in several independent lanes.
+     */
+    float sum(const float* a, int n);
+
+    /**
+     * @brief Sum of a[i]^2 over a[0..n), the square of the Frobenius norm.
+     */
+    float sum_squares(const float* a, int n);
+
+    /**
+     * @brief out[i] = max(a[i], b[i]). out may alias a or b.
+     */
+    void max(const float* a, const float* b, float* out, int n);
+
+    /**
+     * @brief Largest of a[0..n), n >= 1.
+     */
+    float max_value(const float* a, int n);
+
+    /**
+     * @brief out[i] = a[i] + c. out may alias a.
+     */
+    void offset(const float* a, float c, float* out, int n);
+
+    /**
+     * @brief out[i] = exp(a[i]) by range reduction and a polynomial, with
+     * a[i] clamped to [-87, 88] (so tiny results bottom out near 1.6e-38
+     * instead of 0, and nothing overflows). out may alias a.
+     */
+    void exp(const float* a, float* out, int n,
+             exp_accuracy accuracy = exp_accuracy::accurate);
+
+    /**
+     * @brief Register-tiled transpose of a small block: dst(j, i) =
+     * src(i, j) for a rows x cols block of src with row stride lds, into
+     * dst with row stride ldd. The blocks must not overlap; callers split
+     * large matrices into cache-sized blocks first.
+     */
+    void transpose(const float* src, int lds, float* dst, int ldd,
+                   int rows, int cols);
+}
+
+#endif //SIMD_H
@@ -0,0 +1,94 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stdexcept>
+#include <type_traits>
+
+#define SPAN_RANGE_EXCEPTION "Span index out of range"
+
+// Span indexing is checked only in debug builds, like Matrix element
+// access (MATRIX_BOUNDS_CHECK)
+#ifndef NDEBUG
+#define SPAN_BOUNDS_CHECK 1
+#else
+#define SPAN_BOUNDS_CHECK 0
+#endif
+
+/**
+ * A non-owning view of `size` contiguous elements (std::span is C++20).
+ * Span<float> converts to Span<const float>. The memory must outlive the
+ * span.
+ */
+template<typename T>
+class Span
+{
+private:
+    T* ptr = nullptr;
+    int count = 0;
+
+public:
+    Span() = default;
+
+    Span(T* data, int size) : ptr(data), count(size)
+    {}
+
+    // Span<float> -> Span<const float>
+    template<typename U, typename = typename std::enable_if<
+            std::is_same<const U, T>::value>::type>
+    Span(const Span<U>& other) : ptr(other.data()), count(other.size())
+    {}
+
+    T* data() const
+    {
+        return ptr;
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    T* begin() const
+    {
+        return ptr;
+    }
+
+    T* end() const
+    {
+        return ptr + count;
+    }
+
+    /**
+     * @brief Element access, checked in debug builds only.
+     * @exception std::out_of_range Thrown (debug builds) if idx is outside
+     * [0, size()).
+     */
+    T& operator[](int idx) const
+    {
+        if (SPAN_BOUNDS_CHECK && (idx < 0 || idx >= count))
+        {
+            throw std::out_of_range(SPAN_RANGE_EXCEPTION);
+        }
+        return ptr[idx];
+    }
+
+    /**
+     * @brief The `length` elements starting at `offset`.
+     * @exception std::out_of_range Thrown if the range does not fit.
+     */
+    Span subspan(int offset, int length) const noexcept(false)
+    {
+        if (offset < 0 || length < 0 || offset + length > count)
+        {
+            throw std::out_of_range(SPAN_RANGE_EXCEPTION);
+        }
+        return Span(ptr + offset, length);
+    }
+};
+
+#endif //SPAN_H
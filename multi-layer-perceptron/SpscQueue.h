@@ -0,0 +1,235 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#define SPSC_CAPACITY_ERROR "Queue capacity must be positive"
+#define SPSC_CACHE_LINE 64
+#define SPSC_SPIN_ROUNDS 64         // busy retries before yielding
+#define SPSC_YIELD_ROUNDS 1024      // retries (spins included) before parking
+
+/**
+ * Waiting policy of a blocked SpscQueue end: retries at once for a short
+ * burst, then yields; after SPSC_YIELD_ROUNDS retries pause() returns
+ * false and the end parks on the queue's condition variable until the
+ * other end moves. A busy pipeline never sleeps; a stage idle for long
+ * (e.g. the network waiting for a user to type a path) blocks instead of
+ * polling.
+ */
+class SpscBackoff
+{
+private:
+    int rounds = 0;
+
+public:
+    // Waits a little; false once it is time to block instead
+    bool pause()
+    {
+        if (rounds < SPSC_SPIN_ROUNDS)
+        {
+            rounds++;
+        }
+        else if (rounds < SPSC_YIELD_ROUNDS)
+        {
+            rounds++;
+            std::this_thread::yield();
+        }
+        return rounds < SPSC_YIELD_ROUNDS;
+    }
+};
+
+/**
+ * Bounded lock-free queue between exactly one producer thread and one
+ * consumer thread: a power-of-two ring of pre-constructed slots with one
+ * atomic index per side, each on its own cache line. Every side also
+ * caches the other's index, so it only reads the shared one (and takes the
+ * cache miss) when the ring looks full or empty. Items are moved in and
+ * out, so buffers they own are handed over without copies. push() and
+ * pop() block once their backoff runs out; every push or pop wakes the
+ * other end if it is blocked.
+ */
+template<typename T>
+class SpscQueue
+{
+private:
+    std::vector<T> slots;
+    std::size_t mask;
+
+    alignas(SPSC_CACHE_LINE) std::atomic<std::size_t> head{0};  // next pop
+    std::size_t tail_cache = 0;         // consumer's copy of tail
+    alignas(SPSC_CACHE_LINE) std::atomic<std::size_t> tail{0};  // next push
+    std::size_t head_cache = 0;         // producer's copy of head
+
+    // a blocked end waits here; sleepers is checked by every push and pop
+    alignas(SPSC_CACHE_LINE) std::atomic<int> sleepers{0};
+    std::mutex park_lock;
+    std::condition_variable parked;
+
+    // helper: the smallest power of two >= n
+    static std::size_t round_up(std::size_t n)
+    {
+        std::size_t size = 1;
+        while (size < n)
+        {
+            size *= 2;
+        }
+        return size;
+    }
+
+public:
+    /**
+     * @brief A queue holding at least `capacity` items (rounded up to a
+     * power of two).
+     * @exception std::invalid_argument Thrown if capacity is 0.
+     */
+    explicit SpscQueue(std::size_t capacity) noexcept(false)
+    {
+        if (capacity == 0)
+        {
+            throw std::invalid_argument(SPSC_CAPACITY_ERROR);
+        }
+        slots.resize(round_up(capacity));
+        mask = slots.size() - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    std::size_t capacity() const
+    {
+        return slots.size();
+    }
+
+private:
+    // helper: try_push without the wake-up
+    bool put(T&& value)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache == slots.size())
+        {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache == slots.size())
+            {
+                return false;
+            }
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // helper: try_pop without the wake-up
+    bool take(T& out)
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache)
+        {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache)
+            {
+                return false;
+            }
+        }
+        out = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // helper: wake the other end if it is blocked. The fence orders the
+    // index store before the sleepers load, pairing with the one in park,
+    // so either this sees the sleeper or the sleeper sees the new index.
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> guard(park_lock);
+            parked.notify_all();
+        }
+    }
+
+    // helper: block until ready() holds
+    template<typename F>
+    void park(F ready)
+    {
+        std::unique_lock<std::mutex> lock(park_lock);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        parked.wait(lock, ready);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // helper: room for one more item (producer side)
+    bool has_room() const
+    {
+        return tail.load(std::memory_order_relaxed)
+               - head.load(std::memory_order_acquire) < slots.size();
+    }
+
+    // helper: an item to pop (consumer side)
+    bool has_item() const
+    {
+        return head.load(std::memory_order_relaxed)
+               != tail.load(std::memory_order_acquire);
+    }
+
+public:
+    // Producer only: moves `value` in unless the ring is full (then it is
+    // left untouched)
+    bool try_push(T&& value)
+    {
+        if (!put(std::move(value)))
+        {
+            return false;
+        }
+        wake();
+        return true;
+    }
+
+    // Consumer only: moves the oldest item into `out` unless the ring is
+    // empty
+    bool try_pop(T& out)
+    {
+        if (!take(out))
+        {
+            return false;
+        }
+        wake();
+        return true;
+    }
+
+    // Producer only: waits (see SpscBackoff) until there is room
+    void push(T&& value)
+    {
+        SpscBackoff backoff;
+        while (!put(std::move(value)))
+        {
+            if (!backoff.pause())
+            {
+                park([this] { return has_room(); });
+            }
+        }
+        wake();
+    }
+
+    // Consumer only: waits (see SpscBackoff) for an item
+    void pop(T& out)
+    {
+        SpscBackoff backoff;
+        while (!take(out))
+        {
+            if (!backoff.pause())
+            {
+                park([this] { return has_item(); });
+            }
+        }
+        wake();
+    }
+};
+
+#endif //SPSCQUEUE_H
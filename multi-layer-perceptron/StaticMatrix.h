@@ -0,0 +1,201 @@
+#ifndef STATICMATRIX_H
+#define STATICMATRIX_H
+
+#include "Matrix.h"
+#include "Simd.h"
+#include <algorithm>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Matrix with its shape fixed at compile time and its elements stored
+ * inline (MATRIX_ALIGNMENT-aligned, row-major), so it never touches the
+ * heap and every shape rule is checked by the compiler: multiplying
+ * StaticMatrix<R, C> by StaticMatrix<C2, K> with C != C2 does not compile.
+ * The kernels take the sizes as template arguments, so every loop bound is
+ * a constant the compiler can unroll and vectorize. Large instances belong
+ * in static storage or inside a heap-allocated owner, not on the stack.
+ */
+template<int R, int C>
+class StaticMatrix
+{
+    static_assert(R > 0 && C > 0, "StaticMatrix needs a positive shape");
+
+private:
+    alignas(MATRIX_ALIGNMENT) float mat[R * C] = {};
+
+public:
+    static constexpr int rows = R;
+    static constexpr int cols = C;
+
+    static constexpr int get_rows() { return R; }
+    static constexpr int get_cols() { return C; }
+
+    float& operator()(int i, int j) { return mat[i * C + j]; }
+    float operator()(int i, int j) const { return mat[i * C + j]; }
+
+    float* data() { return mat; }
+    const float* data() const { return mat; }
+
+    // The same elements as a (non-owning) runtime Matrix
+    Matrix view() { return Matrix::view(mat, R, C); }
+    const Matrix view() const { return Matrix::view(mat, R, C); }
+
+    /**
+     * @brief Copies a runtime matrix of the same shape in.
+     * @exception std::invalid_argument Thrown if the shapes differ (the
+     * only runtime shape check, at the boundary with Matrix).
+     */
+    void assign(const Matrix& M) noexcept(false)
+    {
+        if (M.get_rows() != R || M.get_cols() != C)
+        {
+            throw std::invalid_argument(DIMENSIONS_MISMATCH);
+        }
+        std::copy(M.data(), M.data() + R * C, mat);
+    }
+
+    StaticMatrix& operator+=(const StaticMatrix& B)
+    {
+        for (int i = 0; i < R * C; i++)
+        {
+            mat[i] += B.mat[i];
+        }
+        return *this;
+    }
+
+    friend StaticMatrix operator+(StaticMatrix A, const StaticMatrix& B)
+    {
+        return A += B;
+    }
+
+    friend StaticMatrix operator*(StaticMatrix A, float m)
+    {
+        for (int i = 0; i < R * C; i++)
+        {
+            A.mat[i] *= m;
+        }
+        return A;
+    }
+};
+
+namespace static_kernels
+{
+    // y = W x (+ bias, then ReLU if requested) for a fixed R x C shape
+    template<int R, int C>
+    void gemv_generic(const float* w, const float* x, float* y,
+                      const float* bias, bool relu)
+    {
+        for (int i = 0; i < R; i++)
+        {
+            float acc = 0.0f;
+            for (int p = 0; p < C; p++)
+            {
+                acc += w[i * C + p] * x[p];
+            }
+            acc += bias[i];
+            y[i] = (relu && acc < 0.0f) ? 0.0f : acc;
+        }
+    }
+
+#ifdef SIMD_X86
+    template<int C>
+    __attribute__((target("avx2,fma")))
+    inline float row_dot_avx2(const float* w, const float* x)
+    {
+        // C / 8 full vectors, two chains; the remainder is resolved at
+        // compile time
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+        int p = 0;
+        for (; p + 16 <= C; p += 16)
+        {
+            s0 = _mm256_fmadd_ps(_mm256_loadu_ps(w + p),
+                                 _mm256_loadu_ps(x + p), s0);
+            s1 = _mm256_fmadd_ps(_mm256_loadu_ps(w + p + 8),
+                                 _mm256_loadu_ps(x + p + 8), s1);
+        }
+        if constexpr (C % 16 >= 8)
+        {
+            s0 = _mm256_fmadd_ps(_mm256_loadu_ps(w + p),
+                                 _mm256_loadu_ps(x + p), s0);
+            p += 8;
+        }
+        __m256 s = _mm256_add_ps(s0, s1);
+        __m128 h = _mm_add_ps(_mm256_castps256_ps128(s),
+                              _mm256_extractf128_ps(s, 1));
+        h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+        h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+        float acc = _mm_cvtss_f32(h);
+        for (; p < C; p++)
+        {
+            acc += w[p] * x[p];
+        }
+        return acc;
+    }
+
+    template<int R, int C>
+    __attribute__((target("avx2,fma")))
+    void gemv_avx2(const float* w, const float* x, float* y,
+                   const float* bias, bool relu)
+    {
+        for (int i = 0; i < R; i++)
+        {
+            float acc = row_dot_avx2<C>(w + i * C, x) + bias[i];
+            y[i] = (relu && acc < 0.0f) ? 0.0f : acc;
+        }
+    }
+#endif
+
+    /**
+     * @brief y = act(W x + b) with every size known at compile time.
+     */
+    template<int R, int C>
+    void gemv(const StaticMatrix<R, C>& W, const StaticMatrix<C, 1>& x,
+              const StaticMatrix<R, 1>& b, StaticMatrix<R, 1>& y, bool relu)
+    {
+#ifdef SIMD_X86
+        static const bool avx2 = simd::active_isa() >= simd::isa::avx2;
+        if (avx2)
+        {
+            gemv_avx2<R, C>(W.data(), x.data(), y.data(), b.data(), relu);
+            return;
+        }
+#endif
+        gemv_generic<R, C>(W.data(), x.data(), y.data(), b.data(), relu);
+    }
+}
+
+/**
+ * @brief Matrix product; the inner dimensions must agree at compile time.
+ * Matrix-vector products use the fixed-size GEMV kernel.
+ */
+template<int R, int C, int K>
+StaticMatrix<R, K> operator*(const StaticMatrix<R, C>& A,
+                             const StaticMatrix<C, K>& B)
+{
+    StaticMatrix<R, K> out;
+    if constexpr (K == 1)
+    {
+        static const StaticMatrix<R, 1> zero;
+        static_kernels::gemv(A, B, zero, out, false);
+    }
+    else
+    {
+        for (int i = 0; i < R; i++)
+        {
+            for (int p = 0; p < C; p++)
+            {
+                const float a = A(i, p);
+                for (int j = 0; j < K; j++)
+                {
+                    out(i, j) += a * B(p, j);
+                }
+            }
+        }
+    }
+    return out;
+}
+
+#endif //STATICMATRIX_H
@@ -0,0 +1,138 @@
+#ifndef STATICMLPNETWORK_H
+#define STATICMLPNETWORK_H
+
+#include "StaticMatrix.h"
+#include "MlpNetwork.h"
+
+/**
+ * A Dense layer of a fixed In -> Out shape, stored inline.
+ */
+template<int In, int Out>
+struct StaticDense
+{
+    StaticMatrix<Out, In> weights;
+    StaticMatrix<Out, 1> bias;
+
+    // y = W x + b, followed by ReLU if requested (in the GEMV store)
+    void operator()(const StaticMatrix<In, 1>& x, StaticMatrix<Out, 1>& y,
+                    bool relu) const
+    {
+        static_kernels::gemv(weights, x, bias, y, relu);
+    }
+};
+
+/**
+ * MlpNetwork specialized for a topology known at compile time, e.g.
+ * StaticMlpNetwork<784, 128, 64, 20, 10>: ReLU on every hidden layer and
+ * softmax on the output layer. The weights and every activation live
+ * inline, so inference performs no heap allocation and no shape checks;
+ * the shapes are verified once, when the weights are loaded. The network
+ * is large (all weights inline): keep it in static storage or allocate it
+ * once.
+ */
+template<int... Widths>
+class StaticMlpNetwork;
+
+// Output layer: In -> Out, softmax
+template<int In, int Out>
+class StaticMlpNetwork<In, Out>
+{
+private:
+    StaticDense<In, Out> layer;
+
+public:
+    static constexpr int layer_count = 1;
+
+    /**
+     * @brief Copies the weights of `count` layers from runtime matrices.
+     * @exception std::invalid_argument Thrown if a shape differs from the
+     * compile-time topology or the depth is wrong.
+     */
+    void load(const Matrix weights[], const Matrix biases[], int count)
+    noexcept(false)
+    {
+        if (count != layer_count)
+        {
+            throw std::invalid_argument(DIMENSIONS_MISMATCH);
+        }
+        layer.weights.assign(weights[0]);
+        layer.bias.assign(biases[0]);
+    }
+
+    digit operator()(const StaticMatrix<In, 1>& x) const
+    {
+        StaticMatrix<Out, 1> probs;
+        layer(x, probs, false);
+        Matrix probs_view = probs.view();
+        activation::softmax_inplace(probs_view);
+
+        digit result{0, 0.0f};
+        for (int i = 0; i < Out; i++)
+        {
+            if (probs(i, 0) > result.probability)
+            {
+                result = digit{static_cast<unsigned int>(i), probs(i, 0)};
+            }
+        }
+        return result;
+    }
+};
+
+// Hidden layer In -> Hidden (ReLU), then the rest of the network
+template<int In, int Hidden, int... Rest>
+class StaticMlpNetwork<In, Hidden, Rest...>
+{
+private:
+    StaticDense<In, Hidden> layer;
+    StaticMlpNetwork<Hidden, Rest...> next;
+
+public:
+    static constexpr int layer_count = 1 + sizeof...(Rest);
+
+    // see StaticMlpNetwork<In, Out>::load
+    void load(const Matrix weights[], const Matrix biases[], int count)
+    noexcept(false)
+    {
+        if (count != layer_count)
+        {
+            throw std::invalid_argument(DIMENSIONS_MISMATCH);
+        }
+        layer.weights.assign(weights[0]);
+        layer.bias.assign(biases[0]);
+        next.load(weights + 1, biases + 1, count - 1);
+    }
+
+    digit operator()(const StaticMatrix<In, 1>& x) const
+    {
+        StaticMatrix<Hidden, 1> hidden;
+        layer(x, hidden, true);
+        return next(hidden);
+    }
+};
+
+/**
+ * @brief Copies the weights of a runtime network with the same topology
+ * into `net`.
+ * @exception std::invalid_argument Thrown if the topology differs.
+ */
+template<int... Widths>
+void load_static_network(StaticMlpNetwork<Widths...>& net,
+                         const MlpNetwork& mlp) noexcept(false)
+{
+    // views, so the weights are copied once, straight into `net`
+    std::vector<Matrix> weights, biases;
+    for (int i = 0; i < mlp.get_layer_count(); i++)
+    {
+        const Matrix& W = mlp.get_layer(i).get_weights();
+        const Matrix& b = mlp.get_layer(i).get_bias();
+        weights.push_back(Matrix::view(W.data(), W.get_rows(),
+                                       W.get_cols()));
+        biases.push_back(Matrix::view(b.data(), b.get_rows(), b.get_cols()));
+    }
+    net.load(weights.data(), biases.data(), mlp.get_layer_count());
+}
+
+// The MNIST topology of MlpNetwork.cpp, fixed at compile time
+typedef StaticMlpNetwork<28 * 28, 128, 64, 20, 10> MnistStaticNetwork;
+
+#endif //STATICMLPNETWORK_H
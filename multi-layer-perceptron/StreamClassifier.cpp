@@ -0,0 +1,182 @@
+#include "StreamClassifier.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+StreamClassifier::StreamClassifier(const MlpNetwork& mlp, int max_batch,
+                                   int depth) noexcept(false) :
+        mlp(mlp), max_batch(max_batch),
+        ws(mlp, std::max(max_batch, 1)),
+        images(std::max(depth, 1)), results(std::max(depth, 1)),
+        // every buffer in flight fits, so a returned one is never dropped
+        spare(static_cast<std::size_t>(std::max(depth, 1))
+              + std::max(max_batch, 1))
+{
+    if (max_batch <= 0 || depth <= 0)
+    {
+        throw std::invalid_argument(STREAM_OPTIONS_ERROR);
+    }
+    const std::size_t size = static_cast<std::size_t>(mlp.get_input_size())
+                             * max_batch;
+    rows.resize(size);
+    columns.resize(size);
+}
+
+void StreamClassifier::read_stage(const path_source& next)
+{
+    const int pixels = mlp.get_input_size();
+    try
+    {
+        Image item;
+        while (!cancelled && next(item.path))
+        {
+            if (!spare.try_pop(item.pixels))
+            {
+                item.pixels.assign(pixels, 0.0f);
+            }
+            item.ok = BatchClassifier::read_image(item.path,
+                                                  item.pixels.data(), pixels);
+            images.push(std::move(item));
+            item = Image();
+        }
+    }
+    catch (...)
+    {
+        read_error = std::current_exception();
+    }
+    Image end;
+    end.last = true;
+    images.push(std::move(end));
+}
+
+void StreamClassifier::compute_stage()
+{
+    const int pixels = mlp.get_input_size();
+    std::vector<Image> batch;
+    batch.reserve(max_batch);
+    bool done = false;
+    while (!done)
+    {
+        // wait for one image, then take whatever else is already read
+        Image item;
+        images.pop(item);
+        images_ended = item.last;
+        batch.push_back(std::move(item));
+        while (!images_ended && static_cast<int>(batch.size()) < max_batch
+               && images.try_pop(item))
+        {
+            images_ended = item.last;
+            batch.push_back(std::move(item));
+        }
+        done = images_ended;
+
+        // the readable images, one per row, then one per column
+        int n = 0;
+        for (const Image& image : batch)
+        {
+            if (image.ok)
+            {
+                std::copy(image.pixels.begin(), image.pixels.end(),
+                          rows.data() + static_cast<std::size_t>(n++) * pixels);
+            }
+        }
+        const std::vector<digit>* digits = nullptr;
+        if (n > 0)
+        {
+            Matrix input = Matrix::view(columns.data(), pixels, n);
+            Matrix::view(rows.data(), n, pixels).transpose_into(input);
+            digits = &mlp.classify_batch(input, ws);
+        }
+
+        int k = 0;
+        for (Image& image : batch)
+        {
+            Result result;
+            result.path = std::move(image.path);
+            result.result.ok = image.ok;
+            if (image.ok)
+            {
+                result.result.prediction = (*digits)[k++];
+            }
+            result.last = image.last;
+            results.push(std::move(result));
+            results_ended = image.last;
+            if (!image.pixels.empty())
+            {
+                spare.try_push(std::move(image.pixels));
+            }
+        }
+        batch.clear();
+    }
+}
+
+void StreamClassifier::cancel()
+{
+    cancelled = true;
+    if (!results_ended)
+    {
+        Result end;
+        end.last = true;
+        results.push(std::move(end));
+    }
+    // drain the reader, so it is never left blocked on a full queue
+    Image item;
+    while (!images_ended)
+    {
+        images.pop(item);
+        images_ended = item.last;
+    }
+}
+
+void StreamClassifier::write_stage(const result_sink& emit)
+{
+    Result result;
+    for (results.pop(result); !result.last; results.pop(result))
+    {
+        if (write_error)
+        {
+            continue;               // keep draining, so compute never blocks
+        }
+        try
+        {
+            emit(result.path, result.result);
+        }
+        catch (...)
+        {
+            write_error = std::current_exception();
+        }
+    }
+}
+
+void StreamClassifier::run(const path_source& next, const result_sink& emit)
+noexcept(false)
+{
+    read_error = nullptr;
+    write_error = nullptr;
+    cancelled = false;
+    images_ended = false;
+    results_ended = false;
+    std::thread reader(&StreamClassifier::read_stage, this, std::cref(next));
+    std::thread writer(&StreamClassifier::write_stage, this, std::cref(emit));
+    try
+    {
+        compute_stage();
+    }
+    catch (...)
+    {
+        cancel();
+        reader.join();
+        writer.join();
+        throw;
+    }
+    reader.join();
+    writer.join();
+    if (read_error)
+    {
+        std::rethrow_exception(read_error);
+    }
+    if (write_error)
+    {
+        std::rethrow_exception(write_error);
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef STREAMCLASSIFIER_H
+#define STREAMCLASSIFIER_H
+
+#include "BatchClassifier.h"
+#include "MlpNetwork.h"
+#include "SpscQueue.h"
+#include "Workspace.h"
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+#define STREAM_BATCH 16         // images per batched pass, at most
+#define STREAM_DEPTH 64         // slots in each queue between two stages
+#define STREAM_OPTIONS_ERROR "Batch size and queue depth must be positive"
+
+/**
+ * Classifies a stream of image paths of unknown length (e.g. typed on
+ * stdin) in three pipelined stages, so that file reads, inference and
+ * output overlap instead of adding up:
+ *  - a reader thread pulls paths and reads each image into a buffer,
+ *    running up to STREAM_DEPTH images ahead of the network;
+ *  - the calling thread classifies whatever the reader has ready, up to
+ *    max_batch images per batched pass (one image when the stream is
+ *    slow, so nothing waits for a batch to fill);
+ *  - a writer thread hands the results, in input order, to the sink.
+ * The stages are linked by bounded SpscQueues, and pixel buffers travel
+ * back from the compute stage to the reader for reuse.
+ */
+class StreamClassifier
+{
+public:
+    // Stores the next path and returns true, or returns false at the end
+    typedef std::function<bool(std::string& path)> path_source;
+
+    // Receives each result, on the writer thread
+    typedef std::function<void(const std::string& path,
+                               const batch_result& result)> result_sink;
+
+private:
+    // reader -> compute
+    struct Image
+    {
+        std::string path;
+        std::vector<float> pixels;
+        bool ok = false;            // false if the file could not be read
+        bool last = false;          // end of the stream; no image
+    };
+
+    // compute -> writer
+    struct Result
+    {
+        std::string path;
+        batch_result result{};
+        bool last = false;
+    };
+
+    const MlpNetwork& mlp;
+    int max_batch;
+    Workspace ws;
+    std::vector<float> rows;                    // max_batch x pixels
+    std::vector<float> columns;                 // pixels x max_batch
+    SpscQueue<Image> images;
+    SpscQueue<Result> results;
+    SpscQueue<std::vector<float>> spare;        // compute -> reader buffers
+    std::exception_ptr read_error;              // set by one stage each,
+    std::exception_ptr write_error;             // read after the join
+    std::atomic<bool> cancelled{false};         // compute failed: stop reading
+    bool images_ended = false;                  // compute popped the last
+    bool results_ended = false;                 // compute pushed the last
+
+    // helper: reader stage
+    void read_stage(const path_source& next);
+
+    // helper: compute stage, until the end of the stream
+    void compute_stage();
+
+    // helper: after compute_stage threw, let the other stages finish
+    void cancel();
+
+    // helper: writer stage; a failing sink stops the calls, not the stage
+    void write_stage(const result_sink& emit);
+
+public:
+    /**
+     * @brief Sizes the queues and the Workspace.
+     * @param mlp Network to run; must outlive this object.
+     * @param max_batch Images per batched pass, at most.
+     * @param depth Items each queue holds.
+     * @exception std::invalid_argument Thrown if max_batch or depth is not
+     * positive.
+     */
+    StreamClassifier(const MlpNetwork& mlp, int max_batch = STREAM_BATCH,
+                     int depth = STREAM_DEPTH) noexcept(false);
+
+    StreamClassifier(const StreamClassifier&) = delete;
+    StreamClassifier& operator=(const StreamClassifier&) = delete;
+
+    /**
+     * @brief Classifies every path `next` yields and passes the results to
+     * `emit` in the same order; returns once the last one is emitted. One
+     * run at a time.
+     * @exception Rethrows an exception thrown by the network, or else the
+     * first one thrown by `next` or `emit`, after the stages have stopped
+     * (a failing source ends the stream; a failing network ends reading).
+     */
+    void run(const path_source& next, const result_sink& emit)
+    noexcept(false);
+};
+
+#endif //STREAMCLASSIFIER_H
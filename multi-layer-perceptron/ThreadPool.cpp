@@ -0,0 +1,156 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+    // the pool the calling thread works for, and its index there: a task
+    // of one pool may submit to (or query) another
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local int current_worker = -1;
+}
+
+ThreadPool::ThreadPool(int threads)
+{
+    if (threads <= 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    int target = worker_index();
+    if (target < 0)
+    {
+        target = static_cast<int>(next_queue++ % queues.size());
+    }
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        ++pending;
+        ++queued;
+    }
+    {
+        std::lock_guard<std::mutex> guard(queues[target]->lock);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    work_available.notify_one();
+}
+
+bool ThreadPool::try_pop(int self, std::function<void()>& task)
+{
+    // own deque first, newest task
+    {
+        WorkerQueue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // then steal the oldest task of the next non-empty victim
+    const int count = static_cast<int>(queues.size());
+    for (int offset = 1; offset < count; offset++)
+    {
+        WorkerQueue& victim = *queues[(self + offset) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(int self)
+{
+    current_pool = this;
+    current_worker = self;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(state_lock);
+            work_available.wait(guard, [this] { return queued > 0 ||
+                                                       stopping; });
+            if (queued == 0 && stopping)
+            {
+                return;
+            }
+        }
+
+        std::function<void()> task;
+        if (!try_pop(self, task))
+        {
+            continue;       // another worker got there first
+        }
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            --queued;
+        }
+
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            if (!first_error)
+            {
+                first_error = std::current_exception();
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(state_lock);
+        if (--pending == 0)
+        {
+            all_done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::wait() noexcept(false)
+{
+    std::unique_lock<std::mutex> guard(state_lock);
+    all_done.wait(guard, [this] { return pending == 0; });
+    if (first_error)
+    {
+        std::exception_ptr error = first_error;
+        first_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+int ThreadPool::size() const
+{
+    return static_cast<int>(workers.size());
+}
+
+int ThreadPool::worker_index() const
+{
+    return current_pool == this ? current_worker : -1;
+}
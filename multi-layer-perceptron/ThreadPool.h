@@ -0,0 +1,81 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed-size work-stealing thread pool. Every worker owns a task deque:
+ * it pops its own newest task (LIFO, cache-warm) and, when empty, steals
+ * the oldest task of another worker (FIFO), so uneven task costs still
+ * keep all cores busy. Tasks submitted from outside the pool are spread
+ * round-robin over the workers' deques.
+ */
+class ThreadPool
+{
+private:
+    struct WorkerQueue
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex state_lock;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    int queued = 0;             // tasks sitting in some deque
+    int pending = 0;            // tasks submitted and not yet finished
+    bool stopping = false;
+    std::exception_ptr first_error;
+    std::atomic<unsigned> next_queue{0};
+
+    bool try_pop(int self, std::function<void()>& task);
+    void run(int self);
+
+public:
+    /**
+     * @brief Starts the workers.
+     * @param threads Number of workers; 0 uses every hardware thread.
+     */
+    explicit ThreadPool(int threads = 0);
+
+    /**
+     * @brief Finishes the queued tasks, then joins the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues a task. Called from a worker of this pool, the task
+     * goes to that worker's own deque; from anywhere else (including a
+     * worker of another pool), round-robin.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Blocks until every submitted task has finished.
+     * @exception Rethrows the first exception thrown by a task, if any.
+     */
+    void wait() noexcept(false);
+
+    // Number of workers
+    int size() const;
+
+    // Index of the calling worker in [0, size()), or -1 if the caller is
+    // not a worker of this pool
+    int worker_index() const;
+};
+
+#endif //THREADPOOL_H
@@ -0,0 +1,350 @@
+#include "Trainer.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+// helper: an owned copy, also of a view (e.g. mmap'd weights)
+static Matrix owned_copy(const Matrix& M)
+{
+    Matrix copy(M.get_rows(), M.get_cols());
+    std::copy(M.data(), M.data() + M.get_rows() * M.get_cols(), copy.data());
+    return copy;
+}
+
+Trainer::Trainer(const std::vector<int>& widths, train_options options)
+noexcept(false) :
+        options(options), pool(options.threads), gen(options.seed)
+{
+    if (widths.size() < 2 || *std::min_element(widths.begin(),
+                                               widths.end()) <= 0)
+    {
+        throw std::invalid_argument(TRAIN_TOPOLOGY_ERROR);
+    }
+    std::vector<ActivationType> activations;
+    for (std::size_t i = 1; i < widths.size(); i++)
+    {
+        // He initialization keeps the ReLU activations' variance per layer
+        std::normal_distribution<float> dist(
+                0.0f, std::sqrt(2.0f / static_cast<float>(widths[i - 1])));
+        weights.emplace_back(widths[i], widths[i - 1]);
+        biases.emplace_back(widths[i], 1);
+        Matrix& W = weights.back();
+        for (int p = 0; p < W.get_rows() * W.get_cols(); p++)
+        {
+            W.data()[p] = dist(gen);
+        }
+        activations.push_back(i + 1 < widths.size() ? activation::relu
+                                                    : activation::softmax);
+    }
+    build(activations);
+}
+
+Trainer::Trainer(const MlpNetwork& mlp, train_options options)
+noexcept(false) :
+        options(options), pool(options.threads), gen(options.seed)
+{
+    std::vector<ActivationType> activations;
+    for (int i = 0; i < mlp.get_layer_count(); i++)
+    {
+        const Dense& layer = mlp.get_layer(i);
+        weights.push_back(owned_copy(layer.get_weights()));
+        biases.push_back(owned_copy(layer.get_bias()));
+        activations.push_back(layer.get_activation());
+    }
+    build(activations);
+}
+
+void Trainer::build(const std::vector<ActivationType>& activations)
+noexcept(false)
+{
+    const int count = static_cast<int>(weights.size());
+    for (int i = 0; i < count; i++)
+    {
+        if (activations[i] != (i + 1 < count ? activation::relu
+                                             : activation::softmax))
+        {
+            throw std::invalid_argument(UNTRAINABLE_ACTIVATION);
+        }
+        // views, so every update is seen by the forward kernels
+        layers.emplace_back(
+                Matrix::view(weights[i].data(), weights[i].get_rows(),
+                             weights[i].get_cols()),
+                Matrix::view(biases[i].data(), biases[i].get_rows(), 1),
+                activations[i]);
+        for (int j = 0; j < 2; j++)
+        {
+            moment_w[j].emplace_back(weights[i].get_rows(),
+                                     weights[i].get_cols());
+            moment_b[j].emplace_back(biases[i].get_rows(), 1);
+        }
+    }
+
+    const int max_shard = (options.batch_size + pool.size() - 1)
+                          / pool.size();
+    replicas.resize(pool.size());
+    for (Replica& r : replicas)
+    {
+        r.input.resize(static_cast<std::size_t>(weights[0].get_cols())
+                       * max_shard);
+        for (int i = 0; i < count; i++)
+        {
+            const std::size_t size = static_cast<std::size_t>(
+                    weights[i].get_rows()) * max_shard;
+            r.outputs.emplace_back(size);
+            r.deltas.emplace_back(size);
+            r.grad_w.emplace_back(weights[i].get_rows(),
+                                  weights[i].get_cols());
+            r.grad_b.emplace_back(biases[i].get_rows(), 1);
+        }
+    }
+}
+
+void Trainer::run_shard(Replica& r, const Matrix& batch,
+                        const std::uint8_t* labels, int first, int last)
+{
+    const int n = last - first;
+    const int k = batch.get_rows();
+    const int total = batch.get_cols();
+    const int count = static_cast<int>(layers.size());
+
+    // the shard's columns, made contiguous for the fused kernels
+    if (r.input.size() < static_cast<std::size_t>(k) * n)
+    {
+        r.input.resize(static_cast<std::size_t>(k) * n);
+    }
+    for (int p = 0; p < k; p++)
+    {
+        const float* row = batch.data() + static_cast<std::size_t>(p) * total;
+        std::copy(row + first, row + last, r.input.data() + p * n);
+    }
+    const Matrix input = Matrix::view(r.input.data(), k, n);
+    std::vector<Matrix>& outputs = r.output_views;
+    std::vector<Matrix>& deltas = r.delta_views;
+    outputs.clear();                // keeps the capacity
+    deltas.clear();
+    for (int i = 0; i < count; i++)
+    {
+        const int rows = layers[i].get_dims().rows;
+        if (r.outputs[i].size() < static_cast<std::size_t>(rows) * n)
+        {
+            r.outputs[i].resize(static_cast<std::size_t>(rows) * n);
+            r.deltas[i].resize(static_cast<std::size_t>(rows) * n);
+        }
+        outputs.push_back(Matrix::view(r.outputs[i].data(), rows, n));
+        deltas.push_back(Matrix::view(r.deltas[i].data(), rows, n));
+        layers[i](i == 0 ? input : outputs[i - 1], outputs[i]);
+    }
+
+    // softmax + cross-entropy: dL/dz = p - one_hot, averaged over the
+    // whole minibatch so that the shard gradients simply add up
+    const Matrix& probs = outputs.back();
+    Matrix& delta = deltas.back();
+    const int classes = probs.get_rows();
+    const float weight = 1.0f / static_cast<float>(total);
+    r.loss = 0.0;
+    for (int c = 0; c < classes; c++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            const float p = probs.data()[c * n + j];
+            const bool hit = labels[first + j] == c;
+            delta.data()[c * n + j] = (hit ? p - 1.0f : p) * weight;
+            if (hit)
+            {
+                r.loss -= std::log(std::max(p, TRAIN_LOG_FLOOR));
+            }
+        }
+    }
+
+    for (int i = count - 1; i >= 0; i--)
+    {
+        layers[i].backward(i == 0 ? input : outputs[i - 1], outputs[i],
+                           deltas[i], r.grad_w[i], r.grad_b[i],
+                           i == 0 ? nullptr : &deltas[i - 1]);
+    }
+}
+
+void Trainer::reduce(int count)
+{
+    // round `stride`: replica s += replica s + stride, pairs in parallel
+    for (int stride = 1; stride < count; stride *= 2)
+    {
+        for (int s = 0; s + stride < count; s += 2 * stride)
+        {
+            pool.submit([this, s, stride] {
+                Replica& dst = replicas[s];
+                const Replica& src = replicas[s + stride];
+                for (std::size_t i = 0; i < layers.size(); i++)
+                {
+                    Matrix& gw = dst.grad_w[i];
+                    simd::add(gw.data(), src.grad_w[i].data(), gw.data(),
+                              gw.get_rows() * gw.get_cols());
+                    Matrix& gb = dst.grad_b[i];
+                    simd::add(gb.data(), src.grad_b[i].data(), gb.data(),
+                              gb.get_rows());
+                }
+                dst.loss += src.loss;
+            });
+        }
+        pool.wait();
+    }
+}
+
+// helper: one optimizer step on n parameters
+static void apply_update(const train_options& options, int step, float* w,
+                         const float* g, float* m, float* v, int n)
+{
+    if (options.method == optimizer::sgd)
+    {
+        simd::axpy(-options.learning_rate, g, w, n);
+        return;
+    }
+    const float b1 = options.beta1;
+    const float b2 = options.beta2;
+    // bias-corrected step size folded into one factor
+    const float rate = options.learning_rate
+                       * std::sqrt(1.0f - std::pow(b2, float(step)))
+                       / (1.0f - std::pow(b1, float(step)));
+    for (int i = 0; i < n; i++)
+    {
+        m[i] = b1 * m[i] + (1.0f - b1) * g[i];
+        v[i] = b2 * v[i] + (1.0f - b2) * g[i] * g[i];
+        w[i] -= rate * m[i] / (std::sqrt(v[i]) + options.epsilon);
+    }
+}
+
+void Trainer::update()
+{
+    steps++;
+    const Replica& r = replicas[0];
+    for (std::size_t i = 0; i < layers.size(); i++)
+    {
+        apply_update(options, steps, weights[i].data(), r.grad_w[i].data(),
+                     moment_w[0][i].data(), moment_w[1][i].data(),
+                     weights[i].get_rows() * weights[i].get_cols());
+        apply_update(options, steps, biases[i].data(), r.grad_b[i].data(),
+                     moment_b[0][i].data(), moment_b[1][i].data(),
+                     biases[i].get_rows());
+    }
+}
+
+float Trainer::step(const Matrix& batch, const std::uint8_t* labels)
+noexcept(false)
+{
+    const int n = batch.get_cols();
+    if (batch.get_rows() != weights[0].get_cols())
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+    const int classes = weights.back().get_rows();
+    for (int j = 0; j < n; j++)
+    {
+        if (labels[j] >= classes)
+        {
+            throw std::invalid_argument(TRAIN_LABEL_RANGE);
+        }
+    }
+
+    const int shards = std::min(n, static_cast<int>(replicas.size()));
+    for (int s = 0; s < shards; s++)
+    {
+        const int first = static_cast<int>(
+                static_cast<long long>(n) * s / shards);
+        const int last = static_cast<int>(
+                static_cast<long long>(n) * (s + 1) / shards);
+        pool.submit([this, s, &batch, labels, first, last] {
+            run_shard(replicas[s], batch, labels, first, last);
+        });
+    }
+    pool.wait();
+    reduce(shards);
+    update();
+    return static_cast<float>(replicas[0].loss / n);
+}
+
+float Trainer::train_epoch(const Matrix& samples,
+                           const std::vector<std::uint8_t>& labels)
+noexcept(false)
+{
+    const int k = samples.get_rows();
+    const int count = samples.get_cols();
+    if (static_cast<int>(labels.size()) != count)
+    {
+        throw std::invalid_argument(TRAIN_LABEL_MISMATCH);
+    }
+    if (k != weights[0].get_cols())
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+
+    // one sample per row, so a shuffled minibatch gathers whole rows
+    Matrix rows(count, k);
+    samples.transpose_into(rows);
+    std::vector<int> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), gen);
+
+    const int size = std::max(options.batch_size, 1);
+    batch_rows.resize(static_cast<std::size_t>(size) * k);
+    batch_columns.resize(static_cast<std::size_t>(size) * k);
+    batch_labels.resize(size);
+    double loss = 0.0;
+    for (int first = 0; first < count; first += size)
+    {
+        const int n = std::min(size, count - first);
+        for (int j = 0; j < n; j++)
+        {
+            const float* src = rows.data()
+                               + static_cast<std::size_t>(order[first + j]) * k;
+            std::copy(src, src + k, batch_rows.data() + j * k);
+            batch_labels[j] = labels[order[first + j]];
+        }
+        Matrix batch = Matrix::view(batch_columns.data(), k, n);
+        Matrix::view(batch_rows.data(), n, k).transpose_into(batch);
+        loss += static_cast<double>(step(batch, batch_labels.data())) * n;
+    }
+    return static_cast<float>(loss / count);
+}
+
+MlpNetwork Trainer::network() const
+{
+    std::vector<Matrix> w, b;
+    std::vector<ActivationType> activations;
+    for (std::size_t i = 0; i < layers.size(); i++)
+    {
+        w.push_back(owned_copy(weights[i]));
+        b.push_back(owned_copy(biases[i]));
+        activations.push_back(layers[i].get_activation());
+    }
+    return MlpNetwork(w.data(), b.data(), activations.data(),
+                      static_cast<int>(layers.size()));
+}
+
+void Trainer::save(const std::vector<std::string>& layer_files) const
+noexcept(false)
+{
+    const std::size_t count = layers.size();
+    if (layer_files.size() != 2 * count)
+    {
+        throw std::invalid_argument(TRAIN_FILE_COUNT);
+    }
+    for (std::size_t i = 0; i < 2 * count; i++)
+    {
+        const Matrix& M = i < count ? weights[i] : biases[i - count];
+        std::ofstream out(layer_files[i], std::ios::binary);
+        out.write(reinterpret_cast<const char*>(M.data()),
+                  static_cast<std::streamsize>(M.get_rows()) * M.get_cols()
+                  * sizeof(float));
+        if (!out)
+        {
+            throw std::runtime_error(TRAIN_WRITE_ERROR);
+        }
+    }
+}
+
+int Trainer::get_steps() const
+{
+    return steps;
+}
@@ -0,0 +1,152 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include "MlpNetwork.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#define TRAIN_TOPOLOGY_ERROR "A network needs an input and an output width"
+#define TRAIN_LABEL_MISMATCH "Samples and labels differ in count"
+#define TRAIN_LABEL_RANGE "Label outside the output layer"
+#define TRAIN_FILE_COUNT "Expected one weight file and one bias file per layer"
+#define TRAIN_WRITE_ERROR "Failed to write a weight file"
+#define TRAIN_LOG_FLOOR 1e-30f  // smallest probability in the loss
+
+// How the gradients update the weights
+enum class optimizer
+{
+    sgd,        // w -= learning_rate * g
+    adam        // per-weight step from running moments of g (Kingma & Ba)
+};
+
+// Hyper-parameters of a Trainer
+typedef struct train_options
+{
+    optimizer method = optimizer::adam;
+    float learning_rate = 1e-3f;
+    int batch_size = 64;
+    int threads = 0;            // gradient workers; 0: every hardware thread
+    float beta1 = 0.9f;         // Adam moment decay rates
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+    unsigned int seed = 0;      // initial weights and sample order
+} train_options;
+
+/**
+ * Minibatch training of an MlpNetwork-shaped stack of Dense layers (ReLU
+ * hidden layers, softmax output, cross-entropy loss). Every minibatch is
+ * split column-wise over one replica per worker: each replica runs the
+ * fused forward kernels and Dense::backward on its shard into private
+ * gradients, the gradients are summed by a pairwise tree reduction (log2
+ * of the worker count rounds, each in parallel), and SGD or Adam updates
+ * the trainer's own copy of the weights. The result is written in the raw
+ * weight-file layout that the CLI and MappedWeights read.
+ */
+class Trainer
+{
+private:
+    // Per-worker forward/backward state, sized for the largest shard
+    struct Replica
+    {
+        std::vector<float> input;                   // k x n shard
+        std::vector<std::vector<float>> outputs;    // per layer
+        std::vector<std::vector<float>> deltas;     // dL/d(output)
+        std::vector<Matrix> output_views;           // of the current shard
+        std::vector<Matrix> delta_views;
+        std::vector<Matrix> grad_w;
+        std::vector<Matrix> grad_b;
+        double loss = 0.0;
+    };
+
+    train_options options;
+    std::vector<Matrix> weights;
+    std::vector<Matrix> biases;
+    std::vector<Dense> layers;                      // views of the above
+    std::vector<Matrix> moment_w[2];                // Adam first/second
+    std::vector<Matrix> moment_b[2];
+    int steps = 0;
+    ThreadPool pool;
+    std::vector<Replica> replicas;
+    std::mt19937 gen;
+    std::vector<float> batch_rows;                  // epoch staging
+    std::vector<float> batch_columns;
+    std::vector<std::uint8_t> batch_labels;
+
+    // helper: layers, moments and replicas once the weights are set
+    void build(const std::vector<ActivationType>& activations)
+    noexcept(false);
+
+    // helper: forward and backward of columns [first, last) of `batch`
+    void run_shard(Replica& r, const Matrix& batch,
+                   const std::uint8_t* labels, int first, int last);
+
+    // helper: replicas[0] gradients += those of replicas [1, count)
+    void reduce(int count);
+
+    // helper: one optimizer update from the reduced gradients
+    void update();
+
+public:
+    /**
+     * @brief A fresh network, e.g. widths {784, 128, 64, 20, 10}: ReLU on
+     * every hidden layer, softmax on the output, He-initialized weights
+     * and zero biases.
+     * @exception std::invalid_argument Thrown if there are fewer than two
+     * widths or a width is not positive.
+     */
+    Trainer(const std::vector<int>& widths, train_options options)
+    noexcept(false);
+
+    /**
+     * @brief Continues training from a copy of the weights of `mlp`.
+     * @exception std::invalid_argument Thrown if a hidden layer is not
+     * ReLU or the output layer is not softmax.
+     */
+    Trainer(const MlpNetwork& mlp, train_options options) noexcept(false);
+
+    Trainer(const Trainer&) = delete;
+    Trainer& operator=(const Trainer&) = delete;
+
+    /**
+     * @brief One update from a minibatch.
+     * @param batch Inputs, one sample per column.
+     * @param labels One class per column.
+     * @return The mean cross-entropy of the batch before the update.
+     * @exception std::invalid_argument Thrown if the batch does not fit
+     * the input layer or a label is out of range.
+     */
+    float step(const Matrix& batch, const std::uint8_t* labels)
+    noexcept(false);
+
+    /**
+     * @brief One pass over a training set in shuffled minibatches of
+     * options.batch_size.
+     * @param samples One sample per column (e.g. from IdxReader::read).
+     * @return The mean cross-entropy over the epoch.
+     * @exception std::invalid_argument Thrown if the counts or shapes
+     * mismatch or a label is out of range.
+     */
+    float train_epoch(const Matrix& samples,
+                      const std::vector<std::uint8_t>& labels)
+    noexcept(false);
+
+    // An inference network with a copy of the current weights
+    MlpNetwork network() const;
+
+    /**
+     * @brief Writes the weights in the raw layer-file layout (row-major
+     * floats): the weight file of every layer, then every bias file.
+     * @exception std::invalid_argument Thrown unless there are two files
+     * per layer.
+     * @exception std::runtime_error Thrown if a file cannot be written.
+     */
+    void save(const std::vector<std::string>& layer_files) const
+    noexcept(false);
+
+    // Minibatch updates done so far
+    int get_steps() const;
+};
+
+#endif //TRAINER_H
@@ -0,0 +1,41 @@
+#include "Workspace.h"
+
+// floats per MATRIX_ALIGNMENT bytes, so the second slot stays aligned
+#define SLOT_GRANULE (MATRIX_ALIGNMENT / static_cast<int>(sizeof(float)))
+
+// helper: floats of one slot, rounded up to a whole alignment granule
+static int padded_slot_size(int rows, int cols)
+{
+    return (rows * cols + SLOT_GRANULE - 1) / SLOT_GRANULE * SLOT_GRANULE;
+}
+
+Workspace::Workspace(const MlpNetwork& mlp, int max_batch) noexcept(false) :
+        max_batch(max_batch),
+        slot_size(padded_slot_size(mlp.max_activation_rows(), max_batch)),
+        arena(Matrix(2, slot_size))
+{
+    digits.reserve(max_batch);
+    nonzeros[0].resize(mlp.max_activation_rows());
+    nonzeros[1].resize(mlp.max_activation_rows());
+}
+
+Matrix Workspace::activations(int slot, int rows, int cols) noexcept(false)
+{
+    if (cols > max_batch)
+    {
+        throw std::invalid_argument(BATCH_TOO_LARGE);
+    }
+    // a single image of a wider network could fit the padded slot, but
+    // not the nonzero lists
+    if (rows * cols > slot_size
+        || rows > static_cast<int>(nonzeros[slot].size()))
+    {
+        throw std::invalid_argument(DIMENSIONS_MISMATCH);
+    }
+    return Matrix::view(arena.data() + slot * slot_size, rows, cols);
+}
+
+int Workspace::get_max_batch() const
+{
+    return this->max_batch;
+}
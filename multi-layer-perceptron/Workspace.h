@@ -0,0 +1,46 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include "MlpNetwork.h"
+#include <vector>
+#define BATCH_TOO_LARGE "Batch is larger than the workspace was planned for"
+
+/**
+ * Preplanned scratch memory for MlpNetwork inference. The arena is sized
+ * once, from the widest layer of the network and the largest batch, and
+ * holds two ping-pong activation slots; every layer writes its output
+ * into a view of one slot while reading the other. For a single image,
+ * each slot also lists its nonzero rows for the next layer. Classifying
+ * through a Workspace therefore performs no heap allocation in steady
+ * state.
+ * A Workspace is not thread-safe: use one per thread.
+ */
+class Workspace
+{
+private:
+    int max_batch;
+    int slot_size;              // floats per slot, padded for alignment
+    Matrix arena;               // both slots, back to back
+    std::vector<digit> digits;  // capacity max_batch, reused per call
+    std::vector<int> nonzeros[2];   // nonzero rows of a single-image slot
+
+    friend class MlpNetwork;
+
+    // View of `rows` x `cols` activations in slot 0 or 1; throws
+    // std::invalid_argument if they outgrow what the Workspace planned for
+    Matrix activations(int slot, int rows, int cols) noexcept(false);
+
+public:
+    /**
+     * @brief Plans the arena for a network.
+     * @param mlp Network whose layer widths determine the slot size.
+     * @param max_batch Largest number of images classified per call.
+     * @exception std::runtime_error Thrown if max_batch is non-positive.
+     */
+    Workspace(const MlpNetwork& mlp, int max_batch = 1) noexcept(false);
+
+    // Getter for the largest supported batch
+    int get_max_batch() const;
+};
+
+#endif //WORKSPACE_H
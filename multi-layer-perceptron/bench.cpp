@@ -0,0 +1,650 @@
+/**
+ * Benchmark suite: Matrix operator* at the Dense layer shapes (against the
+ * naive i-j-k triple loop it replaced) and a few larger squares, transpose,
+ * vectorize, rref, every activation, one Dense layer, and full MlpNetwork
+ * inference at batch sizes 1..1024.
+ *
+ * Each case reports ns/op, GFLOP/s and heap allocations/op. The table goes
+ * to stdout; --json writes the same results, one case per line and in a
+ * fixed order, so two runs (e.g. before/after a change) can be diffed.
+ */
+// bench.cpp - build with the mlp_bench target (Release recommended)
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "Matrix.h"
+#include "MlpNetwork.h"
+#include "Workspace.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "Trainer.h"
+#include "StreamClassifier.h"
+#include "counting_allocator.h"
+
+// --- global constants ---
+#define BENCH_USAGE "Usage: mlp_bench [--json <file>] [--filter <substring>] "\
+                    "[--min-time <seconds>]"
+
+const double DEFAULT_MIN_SECONDS = 0.2;  // keep repeating until this long
+
+struct gemm_shape
+{
+    int m, k, n;
+};
+
+const gemm_shape SHAPES[] = {{128, 784, 1},     // first Dense layer
+                             {64,  128, 1},
+                             {20,  64,  1},
+                             {10,  20,  1},
+                             {128, 784, 64},    // batched first layer
+                             {128, 784, 256},
+                             {256, 256, 256},
+                             {512, 512, 512},
+                             {1024, 1024, 1024}};
+
+const int TRANSPOSE_SIZES[] = {28, 128, 784};
+
+const int RREF_SIZES[] = {16, 64, 128, 1024};
+
+const int MAX_BATCH = 1024;
+
+// Largest |blocked - naive| GEMM difference accepted per unit of k: both
+// sum k products of values in [-1, 1), in a different order
+const float GEMM_TOLERANCE = 1e-5f;
+const int STREAM_FILES = 64;            // image files per stream case
+
+struct bench_options
+{
+    std::string json_file;
+    std::string filter;
+    double min_seconds = DEFAULT_MIN_SECONDS;
+};
+
+struct bench_result
+{
+    std::string name;
+    double ns_per_op;
+    double gflops;          // 0 for cases without a meaningful flop count
+    double allocs_per_op;
+};
+
+// helper: the original triple loop, kept here as the baseline and as the
+// reference the blocked kernels are checked against
+void naive_multiply(const Matrix& A, const Matrix& B, Matrix& C)
+{
+    const float* a = A.data();
+    const float* b = B.data();
+    float* c = C.data();
+    for (int i = 0; i < A.get_rows(); i++)
+    {
+        for (int j = 0; j < B.get_cols(); j++)
+        {
+            float acc = 0.0f;
+            for (int k = 0; k < B.get_rows(); k++)
+            {
+                acc += a[i * A.get_cols() + k] * b[k * B.get_cols() + j];
+            }
+            c[i * C.get_cols() + j] = acc;
+        }
+    }
+}
+
+// helper: largest absolute difference between two matrices of one shape
+float max_abs_error(const Matrix& A, const Matrix& B)
+{
+    float err = 0.0f;
+    for (int i = 0; i < A.get_rows() * A.get_cols(); i++)
+    {
+        err = std::max(err, std::abs(A.data()[i] - B.data()[i]));
+    }
+    return err;
+}
+
+// helper: fill with uniform values in [-1, 1)
+void fill_random(Matrix& M, std::mt19937& gen)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (int i = 0; i < M.get_rows() * M.get_cols(); i++)
+    {
+        M.data()[i] = dist(gen);
+    }
+}
+
+// helper: "MxKxN"-style label
+std::string shape_name(std::initializer_list<int> dims)
+{
+    std::string name;
+    for (int d : dims)
+    {
+        name += (name.empty() ? "" : "x") + std::to_string(d);
+    }
+    return name;
+}
+
+/**
+ * Runs the registered cases whose name contains the filter, timing each
+ * one for at least min_seconds after a warm-up call.
+ */
+class BenchRunner
+{
+private:
+    bench_options options;
+    std::vector<bench_result> results;
+
+public:
+    explicit BenchRunner(bench_options options) : options(std::move(options))
+    {}
+
+    // Whether a case of this name passes the filter
+    bool selected(const std::string& name) const
+    {
+        return name.find(options.filter) != std::string::npos;
+    }
+
+    // f is one operation; flops is its floating-point work (0 if none)
+    template<typename F>
+    void run(const std::string& name, double flops, F f)
+    {
+        if (!selected(name))
+        {
+            return;
+        }
+        using clock = std::chrono::steady_clock;
+        f();    // warm-up (page faults, packing buffers, thread scratch)
+        long reps = 0;
+        const std::size_t allocs_before = allocation_count;
+        auto start = clock::now();
+        double elapsed = 0.0;
+        do
+        {
+            f();
+            ++reps;
+            elapsed = std::chrono::duration<double>(clock::now()
+                                                    - start).count();
+        } while (elapsed < options.min_seconds);
+        const std::size_t allocs = allocation_count - allocs_before;
+
+        bench_result r{name, elapsed / reps * 1e9,
+                       flops / (elapsed / reps) * 1e-9,
+                       static_cast<double>(allocs) / reps};
+        std::cout << std::left << std::setw(32) << r.name << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(16) << r.ns_per_op
+                  << std::setprecision(2)
+                  << std::setw(12);
+        if (flops > 0)
+        {
+            std::cout << r.gflops;
+        }
+        else
+        {
+            std::cout << "-";
+        }
+        std::cout << std::setw(12) << r.allocs_per_op << '\n';
+        results.push_back(r);
+    }
+
+    // Writes {"isa": ..., "results": [...]} with one case per line
+    bool write_json() const
+    {
+        if (options.json_file.empty())
+        {
+            return true;
+        }
+        std::ofstream out(options.json_file);
+        if (!out)
+        {
+            return false;
+        }
+        out << "{\n  \"isa\": \"" << simd::isa_name(simd::active_isa())
+            << "\",\n  \"min_seconds\": " << options.min_seconds
+            << ",\n  \"results\": [\n";
+        out << std::setprecision(6);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const bench_result& r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": "
+                << r.ns_per_op << ", \"gflops\": " << r.gflops
+                << ", \"allocs_per_op\": " << r.allocs_per_op << "}"
+                << (i + 1 < results.size() ? "," : "") << '\n';
+        }
+        out << "  ]\n}\n";
+        return out.good();
+    }
+};
+
+// helper: parses the command line; false on anything unexpected
+bool parse_options(int argc, char** argv, bench_options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        if (arg == "--json")
+        {
+            options.json_file = argv[++i];
+        }
+        else if (arg == "--filter")
+        {
+            options.filter = argv[++i];
+        }
+        else if (arg == "--min-time")
+        {
+            char* end = nullptr;
+            options.min_seconds = std::strtod(argv[++i], &end);
+            if (*end != '\0' || options.min_seconds <= 0)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns false if a blocked product disagrees with the naive one
+bool bench_gemm(BenchRunner& runner, std::mt19937& gen)
+{
+    bool correct = true;
+    for (const gemm_shape& s : SHAPES)
+    {
+        Matrix A(s.m, s.k), B(s.k, s.n), C(s.m, s.n);
+        fill_random(A, gen);
+        fill_random(B, gen);
+        const double flops = 2.0 * s.m * s.k * s.n;
+        const std::string shape = shape_name({s.m, s.k, s.n});
+
+        runner.run("gemm_naive/" + shape, flops,
+                   [&] { naive_multiply(A, B, C); });
+        Matrix result = A * B;
+        runner.run("gemm/" + shape, flops, [&] { result = A * B; });
+        Matrix result_tn = result;
+        if (s.n > 1)
+        {
+            // A^T stored, multiplied through the transposed view
+            Matrix At(A.transposed());
+            result_tn = At.transposed() * B;
+            runner.run("gemm_tn/" + shape, flops,
+                       [&] { result = At.transposed() * B; });
+        }
+
+        // the blocked kernels must match the triple loop (skipped, like
+        // the timings, when the filter excludes them)
+        if (runner.selected("gemm/" + shape)
+            || runner.selected("gemm_tn/" + shape))
+        {
+            if (!runner.selected("gemm_naive/" + shape))
+            {
+                naive_multiply(A, B, C);
+            }
+            const float err = std::max(max_abs_error(result, C),
+                                       max_abs_error(result_tn, C));
+            if (err > GEMM_TOLERANCE * s.k)
+            {
+                std::cerr << "Error: gemm/" << shape << " max |err| " << err
+                          << " against the naive product" << std::endl;
+                correct = false;
+            }
+        }
+    }
+    return correct;
+}
+
+void bench_matrix_ops(BenchRunner& runner, std::mt19937& gen)
+{
+    for (int n : TRANSPOSE_SIZES)
+    {
+        Matrix square(n, n), wide(n / 4 + 1, n);
+        fill_random(square, gen);
+        fill_random(wide, gen);
+        runner.run("transpose/" + shape_name({n, n}), 0,
+                   [&] { square.transpose(); });
+        runner.run("transpose/" + shape_name({wide.get_rows(), n}), 0,
+                   [&] { wide.transpose(); });
+        Matrix source(n / 4 + 1, n), out(n, n / 4 + 1);
+        fill_random(source, gen);
+        runner.run("transpose_into/" + shape_name({n / 4 + 1, n}), 0,
+                   [&] { source.transpose_into(out); });
+    }
+
+    // vectorize only changes the shape, so each op re-views the image
+    Matrix img(img_dims.rows, img_dims.cols);
+    fill_random(img, gen);
+    runner.run("vectorize/" + shape_name({img_dims.rows, img_dims.cols}), 0,
+               [&] {
+                   Matrix v = Matrix::view(img.data(), img_dims.rows,
+                                           img_dims.cols);
+                   v.vectorize();
+               });
+
+    ThreadPool pool;
+    for (int n : RREF_SIZES)
+    {
+        Matrix A(n, n), B(n, 1);
+        fill_random(A, gen);
+        fill_random(B, gen);
+        const std::string shape = shape_name({n, n});
+        // Gauss-Jordan: each pivot updates the other n - 1 rows; forward
+        // elimination (rank, LU) only the ones below it
+        const double flops = 2.0 * n * n * n;
+        runner.run("rref/" + shape, flops, [&] { Matrix r = A.rref(); });
+        runner.run("rref_parallel/" + shape, flops,
+                   [&] { Matrix r = A.rref(&pool); });
+        runner.run("rank/" + shape, flops / 3,
+                   [&] { volatile int r = A.rank(); (void) r; });
+        runner.run("solve/" + shape, flops / 3 + 2.0 * n * n,
+                   [&] { Matrix x = A.solve(B); });
+    }
+}
+
+// Activations count one flop per element, so GFLOP/s reads as
+// G elements/s
+void bench_activations(BenchRunner& runner, std::mt19937& gen)
+{
+    const struct
+    {
+        const char* name;
+        activation::softmax_mode mode;
+    } softmax_modes[] = {{"softmax", activation::softmax_mode::accurate},
+                         {"softmax_fast", activation::softmax_mode::fast},
+                         {"log_softmax", activation::softmax_mode::log}};
+
+    for (int n : {1, 64, 1024})
+    {
+        Matrix hidden(weights_dims[0].rows, n), logits(10, n);
+        fill_random(hidden, gen);
+        fill_random(logits, gen);
+        const double elements = hidden.get_rows() * n;
+        const std::string suffix = "/" + shape_name({hidden.get_rows(), n});
+
+        Matrix out(hidden.get_rows(), n);
+        runner.run("relu" + suffix, elements,
+                   [&] { out = activation::lazy::relu(hidden); });
+        runner.run("relu_copy" + suffix, elements,
+                   [&] { Matrix r = activation::relu(hidden); });
+
+        // relu(2 * h + b) fused into one pass over blocks, against one
+        // eager kernel call per operation
+        Matrix shift(hidden.get_rows(), n);
+        fill_random(shift, gen);
+        const int count = hidden.get_rows() * n;
+        runner.run("expr_fused" + suffix, 3 * elements, [&] {
+            out = activation::lazy::relu(2.0f * hidden + shift);
+        });
+        runner.run("expr_eager" + suffix, 3 * elements, [&] {
+            simd::scale(hidden.data(), 2.0f, out.data(), count);
+            simd::add(out.data(), shift.data(), out.data(), count);
+            out = activation::lazy::relu(out);
+        });
+        runner.run("expr_exp" + suffix, elements,
+                   [&] { out = activation::lazy::exp(hidden); });
+        for (const auto& s : softmax_modes)
+        {
+            Matrix scores = logits;
+            runner.run(std::string(s.name) + "/" + shape_name({10, n}),
+                       10.0 * n, [&] {
+                           std::copy(logits.data(), logits.data() + 10 * n,
+                                     scores.data());
+                           activation::softmax_inplace(scores, s.mode);
+                       });
+        }
+    }
+}
+
+void bench_dense(BenchRunner& runner, const MlpNetwork& mlp, std::mt19937& gen)
+{
+    const Dense& layer = mlp.get_layer(0);
+    const matrix_dims dims = layer.get_dims();
+    for (int n : {1, 64})
+    {
+        Matrix A(dims.cols, n), out(dims.rows, n);
+        fill_random(A, gen);
+        const double flops = 2.0 * dims.rows * dims.cols * n;
+        const std::string shape = shape_name({dims.rows, dims.cols, n});
+        runner.run("dense_fused/" + shape, flops, [&] { layer(A, out); });
+        runner.run("dense/" + shape, flops, [&] { Matrix r = layer(A); });
+    }
+
+    // one image with a given fraction of lit pixels, through the sparse
+    // path of a copy of the first layer and through the layer itself
+    Dense sparse_layer = layer;
+    sparse_layer.enable_sparse_input();
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    Matrix x(dims.cols, 1), out(dims.rows, 1);
+    for (int percent : {5, 20, 50})
+    {
+        int nnz = 0;
+        for (int p = 0; p < dims.cols; p++)
+        {
+            x.data()[p] = unit(gen) * 100 < percent ? unit(gen) : 0.0f;
+            nnz += x.data()[p] != 0.0f ? 1 : 0;
+        }
+        const std::string label = "/d" + std::to_string(percent);
+        runner.run("dense_sparse" + label, 2.0 * dims.rows * nnz,
+                   [&] { sparse_layer(x, out); });
+        runner.run("dense_gemv" + label, 2.0 * dims.rows * dims.cols,
+                   [&] { layer(x, out); });
+    }
+}
+
+void bench_network(BenchRunner& runner, const MlpNetwork& mlp,
+                   std::mt19937& gen)
+{
+    double flops_per_image = 0;
+    for (int i = 0; i < mlp.get_layer_count(); i++)
+    {
+        const matrix_dims dims = mlp.get_layer(i).get_dims();
+        flops_per_image += 2.0 * dims.rows * dims.cols;
+    }
+
+    Workspace ws(mlp, MAX_BATCH);
+    Matrix all(mlp.get_input_size(), MAX_BATCH);
+    fill_random(all, gen);
+    unsigned int sink = 0;
+    for (int n = 1; n <= MAX_BATCH; n *= 2)
+    {
+        Matrix batch(mlp.get_input_size(), n);
+        for (int p = 0; p < batch.get_rows(); p++)
+        {
+            std::copy(all.data() + p * MAX_BATCH,
+                      all.data() + p * MAX_BATCH + n,
+                      batch.data() + p * n);
+        }
+        const std::string size = "/b" + std::to_string(n);
+        runner.run("network" + size, flops_per_image * n,
+                   [&] { sink += mlp.classify_batch(batch, ws)[0].value; });
+        runner.run("network_alloc" + size, flops_per_image * n,
+                   [&] { sink += mlp.classify_batch(batch)[0].value; });
+    }
+
+    // one image at a time, for comparison with network/b1
+    Matrix img(mlp.get_input_size(), 1);
+    fill_random(img, gen);
+    runner.run("network_single", flops_per_image,
+               [&] { sink += mlp(img, ws).value; });
+
+    // an MNIST-like image (about 20% lit pixels) through a copy of the
+    // network with the sparse path enabled: every layer takes it, fed by
+    // the nonzero list of the layer before
+    MlpNetwork sparse = mlp;
+    sparse.enable_sparse_input();
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int p = 0; p < img.get_rows(); p++)
+    {
+        img.data()[p] = unit(gen) < 0.2f ? unit(gen) : 0.0f;
+    }
+    runner.run("network_single_sparse", flops_per_image,
+               [&] { sink += sparse(img, ws).value; });
+    if (sink == 0xFFFFFFFF)
+    {
+        std::cout << ' ';
+    }
+}
+
+void bench_training(BenchRunner& runner, const MlpNetwork& mlp,
+                    std::mt19937& gen)
+{
+    // forward + backward is about three forward passes per sample
+    double flops_per_image = 0;
+    for (int i = 0; i < mlp.get_layer_count(); i++)
+    {
+        const matrix_dims dims = mlp.get_layer(i).get_dims();
+        flops_per_image += 6.0 * dims.rows * dims.cols;
+    }
+    const int n = 64;
+    Matrix batch(mlp.get_input_size(), n);
+    fill_random(batch, gen);
+    std::vector<std::uint8_t> labels(n);
+    for (int j = 0; j < n; j++)
+    {
+        labels[j] = static_cast<std::uint8_t>(j % 10);
+    }
+    // He-initialized like real training (the uniform benchmark weights
+    // saturate the softmax)
+    std::vector<int> widths = {mlp.get_input_size()};
+    for (int i = 0; i < mlp.get_layer_count(); i++)
+    {
+        widths.push_back(mlp.get_layer(i).get_dims().rows);
+    }
+    for (optimizer method : {optimizer::sgd, optimizer::adam})
+    {
+        train_options options;
+        options.method = method;
+        options.batch_size = n;
+        Trainer trainer(widths, options);
+        runner.run(std::string(method == optimizer::sgd ? "train_sgd"
+                                                        : "train_adam")
+                   + "/b" + std::to_string(n), flops_per_image * n,
+                   [&] { trainer.step(batch, labels.data()); });
+    }
+}
+
+void bench_stream(BenchRunner& runner, const MlpNetwork& mlp,
+                  std::mt19937& gen)
+{
+    // read, classify and format a list of image files: one after the
+    // other, then through the three-stage pipeline
+    const std::string size = "/f" + std::to_string(STREAM_FILES);
+    if (!runner.selected("stream_sequential" + size)
+        && !runner.selected("stream_pipelined" + size))
+    {
+        return;
+    }
+
+    // per-process names, so concurrent runs keep their own inputs
+    const std::string prefix = (std::filesystem::temp_directory_path()
+                                / ("mlp_bench_" + std::to_string(::getpid())
+                                   + "_stream")).string();
+    const int pixels = mlp.get_input_size();
+    std::vector<std::string> paths;
+    Matrix img(pixels, 1);
+    for (int i = 0; i < STREAM_FILES; i++)
+    {
+        fill_random(img, gen);
+        paths.push_back(prefix + std::to_string(i) + ".bin");
+        std::ofstream out(paths.back(), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(img.data()),
+                  pixels * sizeof(float));
+    }
+    std::ostringstream sink;
+
+    Workspace ws(mlp);
+    runner.run("stream_sequential" + size, 0, [&] {
+        sink.str("");
+        for (const std::string& path : paths)
+        {
+            if (BatchClassifier::read_image(path, img.data(), pixels))
+            {
+                digit d = mlp(img, ws);
+                sink << path << ": " << d.value << ' ' << d.probability
+                     << '\n';
+            }
+        }
+    });
+
+    StreamClassifier stream(mlp);
+    runner.run("stream_pipelined" + size, 0, [&] {
+        sink.str("");
+        std::size_t next = 0;
+        stream.run(
+                [&](std::string& path) {
+                    if (next == paths.size())
+                    {
+                        return false;
+                    }
+                    path = paths[next++];
+                    return true;
+                },
+                [&](const std::string& path, const batch_result& r) {
+                    sink << path << ": " << r.prediction.value << ' '
+                         << r.prediction.probability << '\n';
+                });
+    });
+
+    for (const std::string& path : paths)
+    {
+        std::remove(path.c_str());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench_options options;
+    if (!parse_options(argc, argv, options))
+    {
+        std::cerr << BENCH_USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 gen(42);
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    for (int i = 0; i < MLP_SIZE; i++)
+    {
+        weights[i] = Matrix(weights_dims[i].rows, weights_dims[i].cols);
+        biases[i] = Matrix(bias_dims[i].rows, bias_dims[i].cols);
+        fill_random(weights[i], gen);
+        fill_random(biases[i], gen);
+    }
+    MlpNetwork mlp(weights, biases);
+
+    std::cout << "isa: " << simd::isa_name(simd::active_isa()) << '\n'
+              << std::left << std::setw(32) << "case" << std::right
+              << std::setw(16) << "ns/op"
+              << std::setw(12) << "GFLOP/s"
+              << std::setw(12) << "allocs/op" << '\n';
+
+    BenchRunner runner(options);
+    const bool gemm_correct = bench_gemm(runner, gen);
+    bench_matrix_ops(runner, gen);
+    bench_activations(runner, gen);
+    bench_dense(runner, mlp, gen);
+    bench_network(runner, mlp, gen);
+    bench_training(runner, mlp, gen);
+    bench_stream(runner, mlp, gen);
+
+    if (!runner.write_json())
+    {
+        std::cerr << "Error: cannot write " << options.json_file << std::endl;
+        return EXIT_FAILURE;
+    }
+    return gemm_correct ? EXIT_SUCCESS : EXIT_FAILURE;
+}
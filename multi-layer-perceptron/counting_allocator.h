@@ -0,0 +1,69 @@
+#ifndef COUNTING_ALLOCATOR_H
+#define COUNTING_ALLOCATOR_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/*
+ * Counting replacements of the global allocation functions, so tests and
+ * benchmarks can assert that a code path does not touch the heap. The
+ * array forms forward to these by default. Replacement functions must be
+ * defined once per program: include this header from exactly one
+ * translation unit of an executable (main.cpp, bench.cpp). The CLI build
+ * (RUN_CLI) keeps the library allocator and the counter stays at 0.
+ */
+
+// Allocations so far, from every thread (pools, servers, pipelines)
+static std::atomic<std::size_t> allocation_count{0};
+
+#ifndef RUN_CLI
+
+void* operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t al)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(al);
+    if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Every block above comes from malloc/aligned_alloc, so free() is the
+// matching release. GCC inlines these deletes into callers where it only
+// sees `operator new` and reports -Wmismatched-new-delete for the free()
+// call; the pairing is right, so the warning is silenced here alone.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif //RUN_CLI
+
+#endif //COUNTING_ALLOCATOR_H
@@ -3,62 +3,279 @@
  * 1. Automated-testing:  runs its self-checks automatically rather
  * than waiting for human input.
  * 2. Manual-testing: loads the network weights/biases, prompts you for an image file,
- * runs the MLP, and prints the predicted digit & probability.
+ * runs the MLP, and prints the predicted digit & probability; the next images
+ * are read while earlier ones are classified and printed.
+ * With --batch <list-file|dir> it instead classifies every listed image on
+ * all cores and prints the predictions in input order, and with
+ * --mnist <images> <labels> it streams an IDX test set and reports accuracy.
+ * With --serve <socket> it runs as a daemon answering raw images sent over a
+ * Unix socket in dynamic micro-batches, until SIGINT or SIGTERM.
  */
 // main.cpp - toggle between CLI and automated-tests at build-time
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <cmath>
+#include <vector>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "Matrix.h"
 #include "MlpNetwork.h"
+#include "Workspace.h"
+#include "BatchClassifier.h"
+#include "StreamClassifier.h"
+#include "SpscQueue.h"
+#include "MappedWeights.h"
+#include "ModelFile.h"
+#include "QuantizedNetwork.h"
+#include "StaticMlpNetwork.h"
+#include "IdxReader.h"
+#include "Trainer.h"
+#include "InferenceServer.h"
+#include "Simd.h"
 #include "autotest_utils.h"
+#include "counting_allocator.h"
 
 // --- global constants ---
 const int IMG_ROWS = 28;   // MNIST image size
 const int IMG_COLS = 28;
 
-// helper: read binary into Matrix
-bool readFileToMatrix(const std::string& path, Matrix& dst)
+// CLI MODE
+const char USAGE[] =
+        "Usage: ./mlp [--batch <list-file|dir> | --mnist <images> <labels>] "
+        "[--threads N] [--sparse] (--model <file> | w1 w2 w3 w4 b1 b2 b3 b4)\n"
+        "       ./mlp --serve <socket> [--max-batch N] [--max-delay-us U] "
+        "[--max-queue N] [--max-pending N]\n"
+        "             [--threads N] [--sparse] "
+        "(--model <file> | w1 w2 w3 w4 b1 b2 b3 b4)\n"
+        "       ./mlp --pack <file> w1 w2 w3 w4 b1 b2 b3 b4\n"
+        "       ./mlp --train <images> <labels> [--epochs N] [--lr X] "
+        "[--optimizer sgd|adam] [--threads N] w1 w2 w3 w4 b1 b2 b3 b4\n";
+
+// command-line options of the CLI
+struct cli_options
 {
-    std::ifstream in(path, std::ios::binary);
-    if (!in) { return false; }
+    std::vector<std::string> layer_files;   // w1..w4 then b1..b4
+    std::string model_file;                 // packed model to load
+    std::string pack_file;                  // convert layer files into it
+    std::string batch_source;               // empty: interactive mode
+    std::string idx_images;                 // IDX test set to evaluate
+    std::string idx_labels;
+    std::string serve_socket;               // run as a daemon on it
+    server_options serving;                 // its batching policy/limits
+    std::string train_images;               // IDX training set; the layer
+    std::string train_labels;               // files are then the output
+    int epochs = 1;
+    float learning_rate = 1e-3f;
+    optimizer method = optimizer::adam;
+    int threads = 0;                        // 0: every hardware thread
+    bool sparse = false;                    // single-image sparse path
+};
 
-    for (int r = 0; r < dst.get_rows(); ++r)
+// helper: split argv into options and the layer files
+bool parse_cli(int argc, char** argv, cli_options& opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc)
+        {
+            opts.batch_source = argv[++i];
+        }
+        else if (arg == "--mnist" && i + 2 < argc)
+        {
+            opts.idx_images = argv[++i];
+            opts.idx_labels = argv[++i];
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+        {
+            opts.serve_socket = argv[++i];
+        }
+        else if (arg == "--max-batch" && i + 1 < argc)
+        {
+            opts.serving.max_batch = std::atoi(argv[++i]);
+        }
+        else if (arg == "--max-delay-us" && i + 1 < argc)
+        {
+            opts.serving.max_delay_us = std::atoi(argv[++i]);
+        }
+        else if (arg == "--max-queue" && i + 1 < argc)
+        {
+            opts.serving.max_queue = std::atoi(argv[++i]);
+        }
+        else if (arg == "--max-pending" && i + 1 < argc)
+        {
+            opts.serving.max_pending = std::atoi(argv[++i]);
+        }
+        else if (arg == "--train" && i + 2 < argc)
+        {
+            opts.train_images = argv[++i];
+            opts.train_labels = argv[++i];
+        }
+        else if (arg == "--epochs" && i + 1 < argc)
+        {
+            opts.epochs = std::atoi(argv[++i]);
+        }
+        else if (arg == "--lr" && i + 1 < argc)
+        {
+            opts.learning_rate = std::strtof(argv[++i], nullptr);
+        }
+        else if (arg == "--optimizer" && i + 1 < argc)
+        {
+            std::string name = argv[++i];
+            if (name != "sgd" && name != "adam")
+            {
+                return false;
+            }
+            opts.method = name == "sgd" ? optimizer::sgd : optimizer::adam;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            opts.threads = std::atoi(argv[++i]);
+        }
+        else if (arg == "--model" && i + 1 < argc)
+        {
+            opts.model_file = argv[++i];
+        }
+        else if (arg == "--pack" && i + 1 < argc)
+        {
+            opts.pack_file = argv[++i];
+        }
+        else if (arg == "--sparse")
+        {
+            opts.sparse = true;
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            return false;
+        }
+        else
+        {
+            opts.layer_files.push_back(arg);
+        }
+    }
+    if (!opts.batch_source.empty() + !opts.idx_images.empty()
+        + !opts.serve_socket.empty() > 1)
+    {
+        return false;
+    }
+    if (!opts.train_images.empty())
     {
-        in.read(reinterpret_cast<char*>(&dst(r, 0)),
-                dst.get_cols() * sizeof(float));
+        return opts.batch_source.empty() && opts.idx_images.empty()
+               && opts.serve_socket.empty() && opts.model_file.empty()
+               && opts.pack_file.empty()
+               && opts.epochs > 0 && opts.learning_rate > 0.0f
+               && opts.layer_files.size() == 2 * MLP_SIZE;
     }
-    return in.good();
+    if (!opts.model_file.empty())
+    {
+        return opts.layer_files.empty() && opts.pack_file.empty();
+    }
+    return opts.layer_files.size() == 2 * MLP_SIZE;
 }
 
-// CLI MODE
-int run_cli(int argc, char** argv)
+// helper: prompt for image paths on stdin until the quit command; the
+// next images are read while earlier ones are classified and printed
+int run_interactive(const MlpNetwork& mlp)
 {
-    if (argc != 1 + MLP_SIZE * 2)
+    constexpr char QUIT_CMD[] = "q";
+    std::cout << "Enter image path (or '" << QUIT_CMD << "' to quit): "
+              << std::flush;
+
+    try
+    {
+        StreamClassifier stream(mlp);
+        stream.run(
+                [&](std::string& imgPath) {
+                    return std::cin >> imgPath && imgPath != QUIT_CMD;
+                },
+                [&](const std::string& imgPath, const batch_result& res) {
+                    if (!res.ok)
+                    {
+                        std::cerr << "Error: cannot open '" << imgPath << "'\n";
+                    }
+                    else
+                    {
+                        std::cout << "Prediction: " << res.prediction.value
+                                  << "  (p = " << res.prediction.probability
+                                  << ")\n";
+                    }
+                    std::cout << "\nEnter next image path (or '" << QUIT_CMD
+                              << "' to quit): " << std::flush;
+                });
+    }
+    catch (const std::exception& ex)
     {
-        std::cerr << "Usage: ./mlp w1 w2 w3 w4 b1 b2 b3 b4\n";
+        std::cerr << ex.what() << '\n';
         return EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
+}
 
-    Matrix weights[MLP_SIZE];
-    Matrix biases [MLP_SIZE];
-
+// helper: classify a whole list/directory on every core, print in order
+int run_batch(const MlpNetwork& mlp, const cli_options& opts)
+{
+    std::vector<std::string> paths;
+    std::vector<batch_result> results;
     try
     {
-        for (int i = 0; i < MLP_SIZE; ++i)
-        {
-            weights[i] = Matrix(weights_dims[i].rows, weights_dims[i].cols);
-            biases [i] = Matrix(bias_dims[i].rows,  bias_dims[i].cols);
+        paths = BatchClassifier::list_images(opts.batch_source);
+        ThreadPool pool(opts.threads);
+        BatchClassifier classifier(mlp, pool);
+        results = classifier.classify(paths);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
 
-            if (!readFileToMatrix(argv[1 + i],            weights[i]) ||
-                !readFileToMatrix(argv[1 + MLP_SIZE + i], biases [i]))
-            {
-                throw std::runtime_error("Failed reading layer "
-                                         + std::to_string(i + 1));
-            }
+    int failures = 0;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        if (!results[i].ok)
+        {
+            std::cerr << "Error: cannot open '" << paths[i] << "'\n";
+            ++failures;
+            continue;
         }
+        std::cout << paths[i] << ": Prediction: " << results[i].prediction.value
+                  << "  (p = " << results[i].prediction.probability << ")\n";
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// helper: stream an IDX image/label pair through the batch API
+int run_mnist(const MlpNetwork& mlp, const cli_options& opts)
+{
+    accuracy_report report;
+    double seconds;
+    try
+    {
+        std::vector<std::uint8_t> labels =
+                IdxReader::read_labels(opts.idx_labels);
+        IdxReader images(opts.idx_images);
+        auto start = std::chrono::steady_clock::now();
+        report = IdxReader::evaluate(mlp, images, labels);
+        seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
     }
     catch (const std::exception& ex)
     {
@@ -66,29 +283,163 @@ int run_cli(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    MlpNetwork mlp(weights, biases);
+    std::cout << "Accuracy: " << report.correct << "/" << report.total
+              << " (" << (report.total ? 100.0 * report.correct / report.total
+                                       : 0.0)
+              << "%)";
+    // an empty set has no rate (and 0 / 0 would not convert to long)
+    if (report.total > 0 && seconds > 0.0)
+    {
+        std::cout << ", " << static_cast<long>(report.total / seconds)
+                  << " img/s";
+    }
+    std::cout << '\n';
+    return EXIT_SUCCESS;
+}
 
-    std::string imgPath;
-    constexpr char QUIT_CMD[] = "q";
-    std::cout << "Enter image path (or '" << QUIT_CMD << "' to quit): ";
+// helper: serve the network on a Unix socket until SIGINT/SIGTERM
+int run_serve(const MlpNetwork& mlp, const cli_options& opts)
+{
+    // blocked before the server threads start, so they inherit the mask
+    // and the signals wait for sigwait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    server_options options = opts.serving;
+    options.workers = opts.threads > 0
+                      ? opts.threads
+                      : static_cast<int>(std::max(
+                              1u, std::thread::hardware_concurrency()));
+    try
+    {
+        InferenceServer server(mlp, opts.serve_socket, options);
+        std::cerr << "Serving on " << opts.serve_socket << '\n';
+        int signal = 0;
+        sigwait(&signals, &signal);
+        server.stop();
+        server_stats stats = server.get_stats();
+        std::cerr << "Served " << stats.requests << " requests in "
+                  << stats.batches << " batches\n";
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// helper: train the MNIST topology on an IDX set, write the layer files
+int run_train(const cli_options& opts)
+{
+    try
+    {
+        std::vector<std::uint8_t> labels =
+                IdxReader::read_labels(opts.train_labels);
+        IdxReader images(opts.train_images);
+        Matrix samples(images.get_rows() * images.get_cols(),
+                       images.get_count());
+        images.read(samples.data(), images.get_count());
+
+        train_options options;
+        options.method = opts.method;
+        options.learning_rate = opts.learning_rate;
+        options.threads = opts.threads;
+        std::vector<int> widths = {weights_dims[0].cols};
+        for (const matrix_dims& dims : weights_dims)
+        {
+            widths.push_back(dims.rows);
+        }
+        Trainer trainer(widths, options);
+        for (int epoch = 1; epoch <= opts.epochs; ++epoch)
+        {
+            auto start = std::chrono::steady_clock::now();
+            float loss = trainer.train_epoch(samples, labels);
+            double seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+            std::cout << "Epoch " << epoch << ": loss " << loss << ", "
+                      << static_cast<long>(samples.get_cols() / seconds)
+                      << " img/s\n";
+        }
+        trainer.save(opts.layer_files);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
 
-    while (std::cin >> imgPath && imgPath != QUIT_CMD)
+int run_cli(int argc, char** argv)
+{
+    cli_options opts;
+    if (!parse_cli(argc, argv, opts))
+    {
+        std::cerr << USAGE;
+        return EXIT_FAILURE;
+    }
+
+    if (!opts.train_images.empty())
     {
-        Matrix img(IMG_ROWS, IMG_COLS);
+        return run_train(opts);
+    }
 
-        if (!readFileToMatrix(imgPath, img))
+    // the layers are views into the mapped file(s): no reads, no copies
+    // (--sparse adds a transposed private copy of the sparse-path layers)
+    std::unique_ptr<ModelFile> model;
+    std::unique_ptr<MappedWeights> mapped;
+    try
+    {
+        if (!opts.pack_file.empty())
+        {
+            MappedWeights layers(opts.layer_files);
+            ModelFile::pack(opts.pack_file, layers.get_weights(),
+                            layers.get_biases(), default_activations,
+                            MLP_SIZE);
+            return EXIT_SUCCESS;
+        }
+        if (!opts.model_file.empty())
         {
-            std::cerr << "Error: cannot open '" << imgPath << "'\n";
+            model = std::make_unique<ModelFile>(opts.model_file);
         }
         else
         {
-            digit res = mlp(img.vectorize());
-            std::cout << "Prediction: " << res.value
-                      << "  (p = " << res.probability << ")\n";
+            mapped = std::make_unique<MappedWeights>(opts.layer_files);
         }
-        std::cout << "\nEnter next image path (or '" << QUIT_CMD << "' to quit): ";
     }
-    return EXIT_SUCCESS;
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    MlpNetwork mlp = model ? MlpNetwork(model->get_weights(),
+                                        model->get_biases(),
+                                        model->get_activations(),
+                                        model->get_layer_count())
+                           : MlpNetwork(mapped->get_weights(),
+                                        mapped->get_biases());
+    if (opts.sparse)
+    {
+        mlp.enable_sparse_input();
+    }
+    if (!opts.batch_source.empty())
+    {
+        return run_batch(mlp, opts);
+    }
+    if (!opts.idx_images.empty())
+    {
+        return run_mnist(mlp, opts);
+    }
+    if (!opts.serve_socket.empty())
+    {
+        return run_serve(mlp, opts);
+    }
+    return run_interactive(mlp);
 }
 
 
@@ -98,6 +449,7 @@ int run_cli(int argc, char** argv)
  *    - get_ordered_matrix()
  *    - test_reduced_matrix()
  */
+
 int test_transpose()
 {
     Matrix A = get_ordered_matrix(3, 5);
@@ -129,35 +481,1830 @@ int test_matrix_read()
     return 0;
 }
 
-int test_rref_simple()
+int test_matrix_multiply()
 {
-    float arr[] = {1,2,3, 4,5,6};
-    float sol[] = {1,0,-1, 0,1,2};
-    return test_reduced_matrix(arr, sol, 2, 3);            // 0 on success
+    // odd shapes exercise the partial register tiles and the GEMV path
+    const int shapes[][3] = {{7, 5, 19}, {13, 300, 3}, {9, 11, 1}};
+    for (const auto& s : shapes)
+    {
+        Matrix A = get_ordered_matrix(s[0], s[1]) * 0.01f;
+        Matrix B = get_ordered_matrix(s[1], s[2]) * 0.01f;
+        Matrix C = A * B;
+        if (C.get_rows() != s[0] || C.get_cols() != s[2])
+            return 1;
+        for (int i = 0; i < s[0]; ++i)
+            for (int j = 0; j < s[2]; ++j)
+            {
+                double expected = 0.0;
+                for (int k = 0; k < s[1]; ++k)
+                    expected += A(i, k) * B(k, j);
+                if (std::abs(C(i, j) - expected) > 1e-3 * std::abs(expected))
+                    return 2;
+            }
+    }
+    return 0;
 }
 
-int run_unit_tests()
+int test_elementwise()
 {
-    int rc = test_transpose();
-    if (rc) { std::cerr << "Transpose test failed\n"; return rc; }
+    // 3x37 leaves a remainder after every vector width
+    Matrix A = get_ordered_matrix(3, 37) * 0.01f;
+    Matrix B = get_ordered_matrix(3, 37) * -0.02f;
+    Matrix S = A + B;
+    Matrix D = A.dot(B);
+    Matrix C = A;
+    C += B;
 
-    rc = test_matrix_read();
-    if (rc) { std::cerr << "Matrix-read test failed\n"; return rc; }
+    double sum = 0.0, squares = 0.0;
+    for (int i = 0; i < 3 * 37; ++i)
+    {
+        if (!float_compare(S[i], -0.01f * i) || !float_compare(C[i], S[i]))
+            return 1;
+        if (!float_compare(D[i], -0.0002f * i * i))
+            return 2;
+        sum += A[i];
+        squares += A[i] * A[i];
+    }
+    if (std::abs(A.sum() - sum) > 1e-3 * sum)
+        return 3;
+    if (std::abs(A.norm() - std::sqrt(squares)) > 1e-3 * std::sqrt(squares))
+        return 4;
+    return 0;
+}
 
-    rc = test_rref_simple();
-    if (rc) { std::cerr << "RREF test failed\n";       return rc; }
+int test_expression_templates()
+{
+    Matrix A = get_ordered_matrix(4, 19) * 0.1f;
+    Matrix B = get_ordered_matrix(4, 19) * -0.05f;
+    Matrix bias(4, 19);
+    for (int i = 0; i < 4 * 19; ++i)
+        bias[i] = 0.25f;
 
-    std::cout << "All tests passed\n";
-    return EXIT_SUCCESS;
+    // a compound expression allocates only its result
+    std::size_t before = allocation_count;
+    Matrix R = activation::lazy::relu(A + 2.0f * B + A.dot(B) + bias);
+    if (allocation_count != before + 1)
+        return 1;
+    for (int i = 0; i < 4 * 19; ++i)
+    {
+        float x = 0.1f * i + 2.0f * -0.05f * i + 0.1f * i * -0.05f * i + 0.25f;
+        if (!float_compare(R[i], x > 0.0f ? x : 0.0f))
+            return 2;
+    }
+
+    // same-shape assignment (also into a view, also aliasing) is in place
+    Matrix view = Matrix::view(R.data(), 4, 19);
+    before = allocation_count;
+    R = R * 0.5f + A;
+    view = activation::lazy::exp(view * 0.0f);
+    R += A.dot(A) + B;
+    if (allocation_count != before)
+        return 3;
+    for (int i = 0; i < 4 * 19; ++i)
+        if (!float_compare(R[i], 1.0f + A[i] * A[i] + B[i]))
+            return 4;
+
+    // trees spanning several blocks (and a ragged tail) match the
+    // element-by-element result, also when the output is an operand
+    const int big = 33 * 40;
+    Matrix X(33, 40), Y(33, 40);
+    for (int i = 0; i < big; ++i)
+    {
+        X[i] = std::sin(0.37f * i);
+        Y[i] = std::cos(0.21f * i);
+    }
+    Matrix Z = Y;
+    Z = activation::lazy::relu(0.5f * X + Y.dot(X)) + Z;
+    Matrix E = activation::lazy::exp(X * 2.0f + Y);
+    for (int i = 0; i < big; ++i)
+    {
+        float x = 0.5f * X[i] + Y[i] * X[i];
+        if (!float_compare(Z[i], (x > 0.0f ? x : 0.0f) + Y[i])
+            || std::abs(E[i] - std::exp(2.0f * X[i] + Y[i]))
+               > 1e-5f * E[i])
+            return 7;
+    }
+
+    // products still materialize through GEMM, shape errors still throw
+    Matrix P = (A + B) * Matrix(19, 2);
+    if (P.get_rows() != 4 || P.get_cols() != 2)
+        return 5;
+    try { Matrix bad = A + Matrix(19, 4); return 6; }
+    catch (const std::invalid_argument&) {}
+    return 0;
+}
+
+// helper: deterministic pseudo-random values in [-scale, scale]
+void fill_pattern(Matrix& M, int seed, float scale)
+{
+    for (int i = 0; i < M.get_rows() * M.get_cols(); ++i)
+        M[i] = scale * std::sin(0.7f * i + 1.3f * seed);
 }
 
+// helper: uniform values in [-1, 1); unlike fill_pattern (rank 2 at most),
+// the result has full rank
+void fill_random(Matrix& M, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (int i = 0; i < M.get_rows() * M.get_cols(); ++i)
+        M[i] = dist(gen);
+}
 
-// entry point selector
-int main(int argc, char** argv)
+// helper: weights/biases with the MNIST topology from MlpNetwork.cpp
+void make_test_params(Matrix weights[], Matrix biases[])
 {
-    #ifdef RUN_CLI
-        return run_cli(argc, argv);
-    #else
-        return run_unit_tests();
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        weights[i] = Matrix(weights_dims[i].rows, weights_dims[i].cols);
+        biases [i] = Matrix(bias_dims[i].rows,  bias_dims[i].cols);
+        fill_pattern(weights[i], i, 1.0f / std::sqrt(weights_dims[i].cols));
+        fill_pattern(biases[i], i + MLP_SIZE, 0.1f);
+    }
+}
+
+int test_dense_fused()
+{
+    // K > GEMM_KC so the epilogue must wait for the last K block
+    Matrix W(13, 300), b(13, 1), A(300, 5);
+    fill_pattern(W, 1, 0.1f);
+    fill_pattern(b, 2, 0.5f);
+    fill_pattern(A, 3, 1.0f);
+
+    Matrix expected = W * A;
+    expected.add_to_columns(b);
+    expected = activation::relu(expected);
+
+    Dense layer(W, b, activation::relu);
+    Matrix out(13, 5);
+    layer(A, out);
+    if (check_equal(expected, out))
+        return 1;
+
+    Matrix x(300, 1);
+    fill_pattern(x, 4, 1.0f);
+    Matrix expected_vec = activation::relu(W * x + b);
+    Matrix out_vec = layer(x);
+    return check_equal(expected_vec, out_vec) ? 2 : 0;
+}
+
+int test_batch_inference()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+
+    std::vector<Matrix> imgs;
+    for (int n = 0; n < 9; ++n)
+    {
+        imgs.emplace_back(IMG_ROWS, IMG_COLS);
+        fill_pattern(imgs.back(), 100 + n, 0.5f);
+        imgs.back() = imgs.back().dot(imgs.back());     // pixels >= 0
+    }
+
+    std::vector<digit> batch = mlp(imgs);
+    if (batch.size() != imgs.size())
+        return 1;
+    for (size_t n = 0; n < imgs.size(); ++n)
+    {
+        Matrix img = imgs[n];
+        digit single = mlp(img.vectorize());
+        if (single.value != batch[n].value ||
+            !float_compare(single.probability, batch[n].probability))
+            return 2;
+    }
+    return 0;
+}
+
+int test_zero_allocation_inference()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+
+    const int batch_size = 9;
+    Workspace ws(mlp, batch_size);
+    Matrix img(IMG_ROWS * IMG_COLS, 1), batch(IMG_ROWS * IMG_COLS, batch_size);
+    fill_pattern(img, 7, 0.5f);
+    fill_pattern(batch, 8, 0.5f);
+
+    // warm-up: lazily created per-thread packing buffers and dispatch tables
+    digit expected = mlp(img, ws);
+    mlp.classify_batch(batch, ws);
+
+    std::size_t before = allocation_count;
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        digit d = mlp(img, ws);
+        if (d.value != expected.value)
+            return 1;
+        mlp.classify_batch(batch, ws);
+    }
+    return allocation_count == before ? 0 : 2;
+}
+
+int test_thread_pool()
+{
+    ThreadPool pool(4);
+    std::atomic<int> done{0};
+    for (int i = 0; i < 200; ++i)
+    {
+        // tasks that spawn tasks land on the spawning worker's deque
+        pool.submit([&pool, &done] {
+            pool.submit([&done] { ++done; });
+            ++done;
+        });
+    }
+    pool.wait();
+    if (done != 400)
+        return 1;
+
+    pool.submit([] { throw std::runtime_error("task failure"); });
+    try { pool.wait(); return 2; }
+    catch (const std::runtime_error&) {}
+
+    // a worker of one pool is a plain outside thread to another: its
+    // index there is -1, and its submissions go round-robin instead of
+    // to a deque that may not exist
+    ThreadPool other(1);
+    std::atomic<int> foreign{0};
+    for (int i = 0; i < 8; ++i)
+    {
+        pool.submit([&] {
+            if (other.worker_index() == -1 && pool.worker_index() >= 0)
+                other.submit([&foreign] { ++foreign; });
+        });
+    }
+    pool.wait();
+    other.wait();
+    if (foreign != 8 || pool.worker_index() != -1)
+        return 3;
+    return 0;
+}
+
+// helper: a path in the temp dir private to this process, so that the
+// ctest entries running this binary in parallel never share a file
+std::string temp_path(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path()
+            / ("mlp_test_" + std::to_string(::getpid()) + "_" + name))
+            .string();
+}
+
+// helper: removes its files when the test leaves, by return or exception
+struct TempFiles
+{
+    std::vector<std::string> paths;
+
+    std::string add(const std::string& name)
+    {
+        paths.push_back(temp_path(name));
+        return paths.back();
+    }
+
+    ~TempFiles()
+    {
+        for (const std::string& path : paths)
+            std::remove(path.c_str());
+    }
+};
+
+// helper: dump a matrix as a raw float file
+bool write_raw(const std::string& path, const Matrix& M)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(M.data()),
+              M.get_rows() * M.get_cols() * sizeof(float));
+    return out.good();
+}
+
+int test_batch_classifier()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+
+    // 11 images over 3 workers, two of them unreadable
+    TempFiles temp;
+    const int count = 11;
+    std::vector<std::string> paths;
+    std::vector<Matrix> images;
+    for (int i = 0; i < count; ++i)
+    {
+        images.emplace_back(IMG_ROWS * IMG_COLS, 1);
+        fill_random(images.back(), 900 + i);
+        if (i == 2 || i == 7)
+        {
+            paths.push_back(temp_path("batch_missing.bin"));
+            continue;
+        }
+        paths.push_back(temp.add("batch" + std::to_string(i) + ".bin"));
+        if (!write_raw(paths.back(), images.back()))
+            return 1;
+    }
+    std::string list = temp.add("batch_list.txt");
+    {
+        std::ofstream out(list);
+        for (const std::string& path : paths)
+            out << path << '\n';
+    }
+    if (BatchClassifier::list_images(list) != paths)
+        return 2;
+
+    ThreadPool pool(3);
+    BatchClassifier classifier(mlp, pool, 4);
+    std::vector<batch_result> results = classifier.classify(paths);
+    if (results.size() != paths.size())
+        return 3;
+    for (int i = 0; i < count; ++i)
+    {
+        const bool readable = i != 2 && i != 7;
+        if (results[i].ok != readable)
+            return 4;
+        digit expected = mlp(images[i]);
+        if (readable && (results[i].prediction.value != expected.value
+                         || !float_compare(results[i].prediction.probability,
+                                           expected.probability)))
+            return 5;
+    }
+
+    // chunks shrink until every worker has several tasks, but never below
+    // one image or above the chunk size
+    BatchClassifier defaults(mlp, pool);
+    if (classifier.chunk_for(11) != 1 || classifier.chunk_for(1000) != 4
+        || defaults.chunk_for(0) != 1 || defaults.chunk_for(320) != 27
+        || defaults.chunk_for(1000) != BATCH_CHUNK)
+        return 6;
+    return 0;
+}
+
+int test_mapped_weights()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+
+    TempFiles temp;
+    std::vector<std::string> files;
+    for (int i = 0; i < 2 * MLP_SIZE; ++i)
+    {
+        files.push_back(temp.add("layer" + std::to_string(i) + ".bin"));
+        const Matrix& M = i < MLP_SIZE ? weights[i] : biases[i - MLP_SIZE];
+        if (!write_raw(files.back(), M))
+            return 1;
+    }
+
+    int rc = 0;
+    {
+        MappedWeights mapped(files);
+        MlpNetwork owned(weights, biases);
+        MlpNetwork viewed(mapped.get_weights(), mapped.get_biases());
+
+        Matrix img(IMG_ROWS * IMG_COLS, 1);
+        fill_pattern(img, 11, 0.5f);
+        digit a = owned(img), b = viewed(img);
+        if (a.value != b.value || !float_compare(a.probability, b.probability))
+            rc = 2;
+        // the network's layers read the mapping itself, never a copy
+        // (the sparse path, which transposes the weights, is opt-in)
+        for (int i = 0; i < MLP_SIZE; ++i)
+        {
+            const Dense& layer = viewed.get_layer(i);
+            if (!layer.get_weights().is_view() || !layer.get_bias().is_view()
+                || layer.has_sparse_input()
+                || !layer.get_weights().is_read_only()
+                || layer.get_weights().data() != mapped.get_weights()[i].data())
+                rc = 3;
+        }
+
+        // a copy of a PROT_READ view refuses writes instead of faulting
+        // (element by element only in debug builds)
+        Matrix alias = mapped.get_weights()[0];
+        try { alias.data(); rc = 4; }
+        catch (const std::logic_error&) {}
+        if (MATRIX_BOUNDS_CHECK)
+        {
+            try { alias(0, 0) = 1.0f; rc = 4; }
+            catch (const std::logic_error&) {}
+        }
+        try { alias.transpose(); rc = 5; }
+        catch (const std::logic_error&) {}
+        if (!alias.is_read_only() || alias.get_rows() != weights[0].get_rows())
+            rc = 6;
+    }
+    return rc;
+}
+
+int test_model_file()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    TempFiles temp;
+    std::string path = temp.add("model.mlpm");
+    ModelFile::pack(path, weights, biases, default_activations, MLP_SIZE);
+
+    int rc = 0;
+    {
+        ModelFile model(path);
+        if (model.get_layer_count() != MLP_SIZE)
+            rc = 1;
+        for (int i = 0; !rc && i < MLP_SIZE; ++i)
+        {
+            const Matrix& W = model.get_weights()[i];
+            if (reinterpret_cast<std::uintptr_t>(W.data()) % 64 != 0
+                || check_equal(W, weights[i])
+                || check_equal(model.get_biases()[i], biases[i])
+                || model.get_activations()[i] != default_activations[i])
+                rc = 2;
+        }
+        if (!rc)
+        {
+            MlpNetwork owned(weights, biases);
+            MlpNetwork packed(model.get_weights(), model.get_biases(),
+                              model.get_activations(),
+                              model.get_layer_count());
+            Matrix img(IMG_ROWS * IMG_COLS, 1);
+            fill_pattern(img, 5, 0.5f);
+            digit a = owned(img), b = packed(img);
+            if (a.value != b.value
+                || !float_compare(a.probability, b.probability))
+                rc = 3;
+        }
+    }
+
+    // flip one weight bit: the checksum must reject the file
+    if (!rc)
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekg(200);
+        char byte = 0;
+        f.read(&byte, 1);
+        byte ^= 0x10;
+        f.seekp(200);
+        f.write(&byte, 1);
+        f.close();
+        try { ModelFile corrupt(path); rc = 4; }
+        catch (const std::runtime_error&) {}
+    }
+
+    // negate two weights of one layer (the top bit of two 8-byte words):
+    // the flips must not cancel out in the checksum
+    if (!rc)
+    {
+        ModelFile::pack(path, weights, biases, default_activations, MLP_SIZE);
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        model_layer layer{};
+        f.seekg(sizeof(model_header));
+        f.read(reinterpret_cast<char*>(&layer), sizeof(layer));
+        for (std::uint64_t weight : {1, 3})
+        {
+            const std::streamoff sign = static_cast<std::streamoff>(
+                    layer.weights_offset + weight * sizeof(float) + 3);
+            char byte = 0;
+            f.seekg(sign);
+            f.read(&byte, 1);
+            byte ^= static_cast<char>(0x80);
+            f.seekp(sign);
+            f.write(&byte, 1);
+        }
+        f.close();
+        try { ModelFile corrupt(path); rc = 5; }
+        catch (const std::runtime_error& e)
+        {
+            if (std::string(e.what()) != MODEL_CHECKSUM_ERROR)
+                rc = 6;
+        }
+    }
+    return rc;
+}
+
+int test_quantized_inference()
+{
+    // one layer, K not a multiple of the padding, inputs of both signs
+    Matrix W(13, 300), b(13, 1), x(300, 1);
+    fill_pattern(W, 1, 0.1f);
+    fill_pattern(b, 2, 0.5f);
+    fill_pattern(x, 3, 1.0f);
+    Dense layer(W, b, activation::relu);
+    QuantizedDense qlayer(layer);
+    if (qlayer.get_padded_cols() % QUANT_K_ALIGNMENT != 0)
+        return 1;
+
+    Matrix expected = layer(x);
+    std::vector<std::uint8_t> q(qlayer.get_padded_cols(), 0);
+    quantized_vector qx = QuantizedDense::quantize(x.data(), 300, q.data());
+    float out[13];
+    qlayer(qx, out);
+    float max_out = expected.data()[0];
+    for (int i = 0; i < 13; ++i)
+        max_out = std::max(max_out, expected.data()[i]);
+    for (int i = 0; i < 13; ++i)
+        if (out[i] < 0.0f || std::abs(out[i] - expected.data()[i])
+                             > 0.02f * max_out)
+            return 2;
+
+    // whole network: same digits as fp32, close probabilities
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    QuantizedNetwork quantized(mlp);
+    if (quantized.weight_bytes() * 3 >= sizeof(float)
+                                        * (128 * 784 + 64 * 128 + 20 * 64
+                                           + 10 * 20))
+        return 3;
+
+    Matrix batch(IMG_ROWS * IMG_COLS, 9);
+    fill_pattern(batch, 21, 0.5f);
+    batch = batch.dot(batch);       // pixels >= 0
+    std::vector<digit> reference = mlp.classify_batch(batch);
+    std::vector<digit> int8 = quantized.classify_batch(batch);
+    for (int n = 0; n < 9; ++n)
+        if (reference[n].value != int8[n].value
+            || std::abs(reference[n].probability - int8[n].probability)
+               > 0.02f)
+            return 4;
+    return 0;
+}
+
+int test_network_depth()
+{
+    // six layers of arbitrary widths, three output classes
+    const int widths[] = {30, 17, 9, 24, 5, 11, 3};
+    const int depth = 6;
+    Matrix weights[depth], biases[depth];
+    ActivationType activations[depth];
+    for (int i = 0; i < depth; ++i)
+    {
+        weights[i] = Matrix(widths[i + 1], widths[i]);
+        biases[i] = Matrix(widths[i + 1], 1);
+        fill_pattern(weights[i], 40 + i, 1.0f / std::sqrt(widths[i]));
+        fill_pattern(biases[i], 50 + i, 0.1f);
+        activations[i] = i + 1 < depth ? activation::relu
+                                       : activation::softmax;
+    }
+    MlpNetwork mlp(weights, biases, activations, depth);
+    if (mlp.get_layer_count() != depth || mlp.get_input_size() != 30
+        || mlp.max_activation_rows() != 24)
+        return 1;
+
+    Matrix batch(30, 7);
+    fill_pattern(batch, 60, 1.0f);
+    Matrix expected = batch;
+    for (int i = 0; i < depth; ++i)
+        expected = Dense(weights[i], biases[i], activations[i])(expected);
+    std::vector<digit> digits = mlp.classify_batch(batch);
+    for (int n = 0; n < 7; ++n)
+    {
+        unsigned int best = 0;
+        for (int c = 1; c < 3; ++c)
+            if (expected(c, n) > expected(best, n))
+                best = c;
+        if (digits[n].value != best
+            || !float_compare(digits[n].probability, expected(best, n)))
+            return 2;
+    }
+
+    // the packed model carries the topology
+    TempFiles files;
+    const std::string path = files.add("depth.mlpm");
+    ModelFile::pack(path, weights, biases, activations, depth);
+    {
+        ModelFile model(path);
+        MlpNetwork packed(model.get_weights(), model.get_biases(),
+                          model.get_activations(), model.get_layer_count());
+        std::vector<digit> again = packed.classify_batch(batch);
+        for (int n = 0; n < 7; ++n)
+            if (again[n].value != digits[n].value)
+                return 3;
+    }
+
+    // layers that do not chain, and an empty network, are rejected
+    Matrix skipped[] = {weights[0], weights[2]};
+    try { MlpNetwork bad(skipped, biases, activations, 2); return 4; }
+    catch (const std::invalid_argument&) {}
+    try { MlpNetwork empty(std::vector<Dense>{}); return 5; }
+    catch (const std::invalid_argument&) {}
+    return 0;
+}
+
+int test_move_semantics()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork built(weights, biases);
+
+    // moving matrices, layers and networks hands the buffers over
+    // without allocating
+    Matrix a(64, 64), c;
+    const float* buffer = a.data();
+    const float* built_weights = built.get_layer(0).get_weights().data();
+    std::vector<Dense> layers;
+    layers.reserve(1);
+    std::size_t before = allocation_count;
+    Matrix b(std::move(a));
+    c = std::move(b);
+    if (allocation_count != before)
+        return 1;
+    Dense layer(std::move(c), Matrix(64, 1), activation::relu);
+    before = allocation_count;
+    Dense moved_layer(std::move(layer));
+    layers.push_back(std::move(moved_layer));
+    MlpNetwork mlp(std::move(built));
+    if (allocation_count != before)
+        return 2;
+    for (int i = 0; i < 8; ++i)             // reallocations move, too
+        layers.emplace_back(Matrix(64, 64), Matrix(64, 1), activation::relu);
+    if (layers.front().get_weights().data() != buffer
+        || mlp.get_layer(0).get_weights().data() != built_weights)
+        return 3;
+
+    // the workspace inference paths neither copy nor allocate
+    Workspace ws(mlp, 4);
+    Matrix img(IMG_ROWS, IMG_COLS), batch(IMG_ROWS * IMG_COLS, 4);
+    fill_pattern(img, 7, 0.5f);
+    fill_pattern(batch, 8, 0.5f);
+    before = allocation_count;
+    mlp(img, ws);
+    mlp.classify_batch(batch, ws);
+    return allocation_count == before ? 0 : 4;
+}
+
+// helper: does A * B compile?
+template<typename A, typename B, typename = void>
+struct can_multiply : std::false_type {};
+
+template<typename A, typename B>
+struct can_multiply<A, B, std::void_t<decltype(std::declval<A>()
+                                               * std::declval<B>())>>
+        : std::true_type {};
+
+int test_static_network()
+{
+    static_assert(can_multiply<StaticMatrix<2, 3>, StaticMatrix<3, 4>>::value,
+                  "matching inner dimensions must multiply");
+    static_assert(!can_multiply<StaticMatrix<2, 3>, StaticMatrix<2, 3>>::value,
+                  "mismatched inner dimensions must not compile");
+
+    // fixed-size products agree with the runtime engine
+    StaticMatrix<5, 37> A;
+    StaticMatrix<37, 1> x;
+    StaticMatrix<37, 3> B;
+    Matrix a = A.view(), xv = x.view(), b = B.view();
+    fill_pattern(a, 1, 1.0f);
+    fill_pattern(xv, 2, 1.0f);
+    fill_pattern(b, 3, 1.0f);
+    StaticMatrix<5, 1> Ax = A * x;
+    StaticMatrix<5, 3> AB = A * B;
+    Matrix y = Ax.view(), expected_y = a * xv;
+    Matrix c = AB.view(), expected_c = a * b;
+    if (check_equal(y, expected_y) || check_equal(c, expected_c))
+        return 1;
+
+    // the MNIST network: same digits, no allocation per image
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    static MnistStaticNetwork net;
+    load_static_network(net, mlp);
+
+    static StaticMatrix<IMG_ROWS * IMG_COLS, 1> imgs[5];
+    std::vector<digit> expected;
+    for (int n = 0; n < 5; ++n)
+    {
+        Matrix img = imgs[n].view();
+        fill_pattern(img, 30 + n, 0.5f);
+        img = img.dot(img);
+        expected.push_back(mlp(img));
+    }
+    std::size_t before = allocation_count;
+    for (int n = 0; n < 5; ++n)
+    {
+        digit d = net(imgs[n]);
+        if (d.value != expected[n].value
+            || !float_compare(d.probability, expected[n].probability))
+            return 2;
+    }
+    if (allocation_count != before)
+        return 3;
+
+    // a runtime network of another topology is rejected at load time
+    MlpNetwork shallow(std::vector<Dense>{mlp.get_layer(0)});
+    try { load_static_network(net, shallow); return 4; }
+    catch (const std::invalid_argument&) {}
+    return 0;
+}
+
+int test_stable_softmax()
+{
+    // large logits would overflow a naive exp; the max is subtracted first
+    Matrix big(3, 2);
+    big(0, 0) = 1000; big(1, 0) = 1001; big(2, 0) = 999;
+    big(0, 1) = -1000; big(1, 1) = -1000; big(2, 1) = -1000;
+    const float e1 = std::exp(1.0f), em1 = std::exp(-1.0f);
+    const float total = 1 + e1 + em1;
+    Matrix probs = activation::softmax(big);
+    if (!float_compare(probs(0, 0), 1 / total)
+        || !float_compare(probs(1, 0), e1 / total)
+        || !float_compare(probs(2, 1), 1.0f / 3))
+        return 1;
+    Matrix single(3, 1);
+    single(0, 0) = 1000; single(1, 0) = 1001; single(2, 0) = 999;
+    activation::softmax_inplace(single);
+    if (!float_compare(single(1, 0), e1 / total))
+        return 2;
+
+    // both exp polynomials against std::exp across the clamped range
+    std::vector<float> x(1001), accurate(x.size()), fast(x.size());
+    for (size_t i = 0; i < x.size(); ++i)
+        x[i] = -87.0f + 175.0f * i / (x.size() - 1);
+    simd::exp(x.data(), accurate.data(), static_cast<int>(x.size()));
+    simd::exp(x.data(), fast.data(), static_cast<int>(x.size()),
+              simd::exp_accuracy::fast);
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        const float ref = std::exp(x[i]);
+        if (std::abs(accurate[i] - ref) > 1e-6f * ref
+            || std::abs(fast[i] - ref) > 1e-4f * ref)
+            return 3;
+    }
+
+    // log-softmax is log(softmax), in both the batch and column layouts;
+    // fast probabilities still sum to one
+    Matrix batch(10, 7);
+    fill_pattern(batch, 9, 20.0f);
+    Matrix reference = activation::softmax(batch);
+    Matrix logs = batch, quick = batch;
+    activation::softmax_inplace(logs, activation::softmax_mode::log);
+    activation::softmax_inplace(quick, activation::softmax_mode::fast);
+    for (int j = 0; j < batch.get_cols(); ++j)
+    {
+        float sum = 0;
+        for (int i = 0; i < batch.get_rows(); ++i)
+        {
+            if (!float_compare(std::exp(logs(i, j)), reference(i, j)))
+                return 4;
+            sum += quick(i, j);
+        }
+        if (!float_compare(sum, 1.0f))
+            return 5;
+    }
+    Matrix log_column(10, 1);
+    fill_pattern(log_column, 10, 20.0f);
+    Matrix prob_column = activation::softmax(log_column);
+    activation::softmax_inplace(log_column, activation::softmax_mode::log);
+    for (int i = 0; i < 10; ++i)
+        if (!float_compare(std::exp(log_column(i, 0)), prob_column(i, 0)))
+            return 6;
+
+    // argmax mode skips the exp but predicts the same digits
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    Matrix imgs(IMG_ROWS * IMG_COLS, 6);
+    fill_pattern(imgs, 11, 0.5f);
+    const std::vector<digit> expected = mlp.classify_batch(imgs);
+    for (activation::softmax_mode mode : {activation::softmax_mode::log,
+                                          activation::softmax_mode::argmax})
+    {
+        mlp.set_output_mode(mode);
+        const std::vector<digit> digits = mlp.classify_batch(imgs);
+        for (size_t n = 0; n < digits.size(); ++n)
+        {
+            if (digits[n].value != expected[n].value)
+                return 7;
+            if (mode == activation::softmax_mode::log
+                && !float_compare(digits[n].probability,
+                                  expected[n].probability))
+                return 8;
+        }
+    }
+
+    // a NaN input makes NaN scores; the digit must still be in range
+    mlp.set_output_mode(activation::softmax_mode::accurate);
+    imgs(0, 0) = std::nanf("");
+    for (const digit& d : mlp.classify_batch(imgs))
+        if (d.value >= 10)
+            return 9;
+    if (mlp(Matrix::view(imgs.data(), IMG_ROWS * IMG_COLS, 1)).value >= 10)
+        return 9;
+    return 0;
+}
+
+int test_blocked_transpose()
+{
+    // odd sizes exercise uneven splits around the leaf size
+    for (int n : {1, 7, 16, 67, 130})
+    {
+        Matrix A(n, n);
+        fill_pattern(A, n, 1.0f);
+        Matrix B = A;
+        std::size_t before = allocation_count;
+        B.transpose();
+        if (allocation_count != before)
+            return 1;
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                if (B(j, i) != A(i, j))
+                    return 2;
+    }
+
+    // non-square in place: the staging buffer is reused after the first call
+    Matrix wide(37, 130);
+    fill_pattern(wide, 4, 1.0f);
+    Matrix tall = wide;
+    tall.transpose();
+    tall.transpose();
+    std::size_t before = allocation_count;
+    tall.transpose();
+    if (allocation_count != before || tall.get_rows() != 130
+        || tall.get_cols() != 37)
+        return 3;
+    for (int i = 0; i < 37; ++i)
+        for (int j = 0; j < 130; ++j)
+            if (tall(j, i) != wide(i, j))
+                return 4;
+
+    // out of place into a reused buffer, and a materialized view
+    Matrix out(130, 37);
+    const float* buffer = out.data();
+    wide.transpose_into(out);
+    Matrix materialized(wide.transposed());
+    if (out.data() != buffer || check_equal(out, tall)
+        || check_equal(materialized, tall))
+        return 5;
+
+    // products with transposed views match explicit transposes
+    Matrix C(130, 20), D(20, 37);
+    fill_pattern(C, 5, 1.0f);
+    fill_pattern(D, 6, 1.0f);
+    Matrix Ct(C.transposed()), Dt(D.transposed());
+    Matrix tn = wide.transposed() * wide, tn_ref = tall * wide;
+    Matrix nt = wide * Ct.transposed(), nt_ref = wide * C;
+    Matrix tt = D.transposed() * C.transposed(), tt_ref = Dt * Ct;
+    if (check_equal(tn, tn_ref) || check_equal(nt, nt_ref)
+        || check_equal(tt, tt_ref))
+        return 6;
+    try { Matrix bad = wide.transposed() * C; return 7; }
+    catch (const std::invalid_argument&) {}
+    return 0;
+}
+
+int test_linear_solve()
+{
+    // a zero leading entry needs a row swap
+    float arr[] = {0,1,2, 1,2,3};
+    float sol[] = {1,0,-1, 0,1,2};
+    if (test_reduced_matrix(arr, sol, 2, 3))
+        return 1;
+
+    // partial pivoting: eliminating with the 1e-7 pivot would lose x0
+    Matrix A(2, 2), b(2, 1);
+    A(0, 0) = 1e-7f; A(0, 1) = 1; A(1, 0) = 1; A(1, 1) = 1;
+    b(0, 0) = 1; b(1, 0) = 2;
+    Matrix x = A.solve(b);
+    if (!float_compare(x(0, 0), 1) || !float_compare(x(1, 0), 1))
+        return 2;
+
+    // collinear features: column 3 = column 0 + column 1
+    Matrix features(6, 4);
+    fill_random(features, 12);
+    for (int i = 0; i < 6; ++i)
+        features(i, 3) = features(i, 0) + features(i, 1);
+    Matrix square(40, 40), rhs(40, 3);
+    fill_random(square, 13);
+    fill_random(rhs, 14);
+    Matrix zeros(5, 7);
+    zeros = zeros * 0.0f;
+    if (features.rank() != 3 || square.rank() != 40 || zeros.rank() != 0)
+        return 3;
+
+    // A X = B for several right-hand sides at once
+    Matrix X = square.solve(rhs);
+    Matrix residual = square * X + rhs * -1.0f;
+    if (residual.norm() > 1e-3f * rhs.norm())
+        return 4;
+
+    Matrix singular = features.transposed() * features;
+    try { singular.solve(Matrix(4, 1)); return 5; }
+    catch (const std::runtime_error&) {}
+    try { features.solve(Matrix(6, 1)); return 6; }
+    catch (const std::invalid_argument&) {}
+
+    // parallel row updates give the same result as the serial ones
+    ThreadPool pool(4);
+    Matrix big(300, 280);
+    fill_random(big, 15);
+    Matrix serial = big.rref(), parallel = big.rref(&pool);
+    if (check_equal(serial, parallel) || big.rank(&pool) != 280)
+        return 7;
+
+    // rref of a view leaves the viewed memory alone
+    Matrix source = features;
+    Matrix view = Matrix::view(source.data(), 6, 4);
+    Matrix reduced = view.rref();
+    if (check_equal(source, features))
+        return 8;
+    return 0;
+}
+
+int test_accessors()
+{
+    Matrix A = get_ordered_matrix(3, 4);
+
+    // row spans alias the matrix, the flat span covers every element
+    Span<float> r1 = A.row(1);
+    if (r1.size() != 4 || r1.data() != A.data() + 4)
+        return 1;
+    r1[2] = 100.0f;
+    const Matrix& C = A;
+    Span<const float> flat = C.flat();
+    float total = 0;
+    for (float v : flat)
+        total += v;
+    if (A(1, 2) != 100.0f || flat.size() != 12
+        || !float_compare(total, A.sum()))
+        return 2;
+    Span<const float> tail = C.row(2).subspan(1, 3);
+    if (tail[0] != A(2, 1) || tail.size() != 3)
+        return 3;
+    try { C.row(0).subspan(2, 3); return 4; }
+    catch (const std::out_of_range&) {}
+
+    // argmax finds the first largest element, also at index 0
+    Matrix v(5, 1);
+    v[0] = 7; v[1] = 3; v[2] = 7; v[3] = -1; v[4] = 2;
+    if (v.argmax() != 0 || A.argmax() != 6)
+        return 5;
+    // NaNs never win, wherever they are (also first, or in every lane)
+    Matrix w(37, 1);
+    for (int i = 0; i < 37; ++i)
+        w[i] = static_cast<float>(i % 5);
+    w[0] = w[11] = w[36] = std::nanf("");
+    if (w.argmax() != 4)
+        return 9;
+    for (int i = 0; i < 37; ++i)
+        w[i] = std::nanf("");
+    if (w.argmax() != 0)
+        return 9;
+
+    // at() always checks; the operators only in debug builds
+    try { A.at(3, 0); return 6; }
+    catch (const std::invalid_argument&) {}
+#ifndef NDEBUG
+    try { A(0, 4); return 7; }
+    catch (const std::invalid_argument&) {}
+    try { A[12]; return 8; }
+    catch (const std::out_of_range&) {}
+#endif
+    return 0;
+}
+
+// helper: writes a big-endian IDX header followed by `bytes`
+bool write_idx(const std::string& path, std::vector<std::uint32_t> header,
+               const std::vector<std::uint8_t>& bytes)
+{
+    std::ofstream out(path, std::ios::binary);
+    for (std::uint32_t field : header)
+    {
+        const char be[4] = {char(field >> 24), char(field >> 16),
+                            char(field >> 8), char(field)};
+        out.write(be, 4);
+    }
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return out.good();
+}
+
+int test_idx_reader()
+{
+    // 300 images: one full batch of 256 and a partial one
+    const int count = 300, pixels = IMG_ROWS * IMG_COLS;
+    std::vector<std::uint8_t> pixels_u8(count * pixels);
+    std::mt19937 gen(16);
+    for (std::uint8_t& p : pixels_u8)
+        p = static_cast<std::uint8_t>(gen() % 256);
+    TempFiles files;
+    const std::string images_path = files.add("images.idx");
+    const std::string labels_path = files.add("labels.idx");
+    if (!write_idx(images_path, {IDX_IMAGE_MAGIC, count, IMG_ROWS, IMG_COLS},
+                   pixels_u8))
+        return 1;
+
+    // columns hold the normalized pixels of one image each
+    {
+        IdxReader reader(images_path);
+        std::vector<float> batch(pixels * 4);
+        if (reader.get_count() != count || reader.read(batch.data(), 4) != 4
+            || reader.remaining() != count - 4)
+            return 2;
+        for (int n = 0; n < 4; ++n)
+            for (int p = 0; p < pixels; ++p)
+                if (!float_compare(batch[p * 4 + n],
+                                   pixels_u8[n * pixels + p] / 255.0f))
+                    return 3;
+    }
+
+    // labels = the network's own predictions, 7 of them changed
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    std::vector<std::uint8_t> labels;
+    for (int n = 0; n < count; ++n)
+    {
+        Matrix img(pixels, 1);
+        for (int p = 0; p < pixels; ++p)
+            img[p] = pixels_u8[n * pixels + p] / 255.0f;
+        labels.push_back(static_cast<std::uint8_t>(mlp(img).value));
+    }
+    for (int n : {0, 1, 100, 255, 256, 257, 299})
+        labels[n] = static_cast<std::uint8_t>((labels[n] + 1) % 10);
+    if (!write_idx(labels_path, {IDX_LABEL_MAGIC, count}, labels))
+        return 4;
+
+    IdxReader reader(images_path);
+    accuracy_report report = IdxReader::evaluate(
+            mlp, reader, IdxReader::read_labels(labels_path));
+    if (report.total != count || report.correct != count - 7)
+        return 5;
+
+    // a label file is not an image file, and counts must agree
+    try { IdxReader wrong(labels_path); return 6; }
+    catch (const std::runtime_error&) {}
+    labels.pop_back();
+    IdxReader again(images_path);
+    try { IdxReader::evaluate(mlp, again, labels); return 7; }
+    catch (const std::invalid_argument&) {}
+
+    // corrupt headers: counts past the file end, sizes beyond int
+    const std::uint32_t huge = 0x80000000u;
+    const std::vector<std::vector<std::uint32_t>> bad_images = {
+            {IDX_IMAGE_MAGIC, huge, 1, 1},
+            {IDX_IMAGE_MAGIC, 1, huge, 1},
+            {IDX_IMAGE_MAGIC, 1, 65536, 65536},     // rows * cols overflows
+            {IDX_IMAGE_MAGIC, count + 1, IMG_ROWS, IMG_COLS}};
+    for (const std::vector<std::uint32_t>& header : bad_images)
+    {
+        if (!write_idx(images_path, header, pixels_u8))
+            return 8;
+        try { IdxReader bad(images_path); return 9; }
+        catch (const std::runtime_error&) {}
+    }
+    for (std::uint32_t n : {huge, 0x7fffffffu, std::uint32_t(count + 1)})
+    {
+        if (!write_idx(labels_path, {IDX_LABEL_MAGIC, n}, labels))
+            return 10;
+        try { IdxReader::read_labels(labels_path); return 11; }
+        catch (const std::runtime_error&) {}
+    }
+    return 0;
+}
+
+int test_sparse_input()
+{
+    // 75 rows: a 64-row block, an 8-row block and a scalar tail
+    const int rows = 75, cols = 200;
+    Matrix W(rows, cols), b(rows, 1);
+    fill_random(W, 11);
+    fill_random(b, 12);
+    Dense dense(W, b, activation::relu);
+    Dense sparse(W, b, activation::relu);
+    sparse.enable_sparse_input();
+    if (dense.has_sparse_input() || !sparse.has_sparse_input())
+        return 1;
+
+    // blank, MNIST-like (~20% lit), at the threshold and fully dense
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (float density : {0.0f, 0.2f, 0.5f, 1.0f})
+    {
+        Matrix x(cols, 1);
+        for (int p = 0; p < cols; ++p)
+            x[p] = dist(gen) < density ? dist(gen) : 0.0f;
+
+        std::vector<int> idx(cols);
+        int nnz = simd::nonzero(x.data(), cols, idx.data());
+        int expected_nnz = 0;
+        for (int p = 0; p < cols; ++p)
+        {
+            if (x[p] != 0.0f && (expected_nnz >= nnz
+                                 || idx[expected_nnz++] != p))
+                return 2;
+        }
+        if (nnz != expected_nnz)
+            return 3;
+
+        Matrix expected = dense(x), actual = sparse(x);
+        if (check_equal(expected, actual))
+            return 4;
+    }
+
+    // a network enables it on its first layer only when asked to; single
+    // images still agree with the (dense GEMM) batch path
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    if (mlp.get_layer(0).has_sparse_input())
+        return 5;
+    mlp.enable_sparse_input();
+    if (!mlp.get_layer(0).has_sparse_input())
+        return 5;
+    Matrix batch(IMG_ROWS * IMG_COLS, 2);
+    for (int p = 0; p < IMG_ROWS * IMG_COLS; ++p)
+        batch(p, 0) = batch(p, 1) = (p % 7 == 0) ? dist(gen) : 0.0f;
+    Matrix img(IMG_ROWS * IMG_COLS, 1);
+    for (int p = 0; p < IMG_ROWS * IMG_COLS; ++p)
+        img[p] = batch(p, 0);
+    digit single = mlp(img);
+    digit batched = mlp.classify_batch(batch)[0];
+    return (single.value == batched.value
+            && float_compare(single.probability, batched.probability))
+           ? 0 : 6;
+}
+
+int test_activation_sparsity()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    mlp.enable_sparse_input();
+    for (int i = 0; i < MLP_SIZE; ++i)
+        if (!mlp.get_layer(i).has_sparse_input())       // all follow ReLU
+            return 1;
+
+    // forward() lists the nonzero outputs and accepts them as the input
+    // list of the next layer
+    const Dense& first = mlp.get_layer(0);
+    const Dense& second = mlp.get_layer(1);
+    Matrix img(IMG_ROWS * IMG_COLS, 1);
+    for (int p = 0; p < img.get_rows(); ++p)
+        img[p] = (p % 5 == 0) ? 0.5f + 0.5f * std::sin(0.3f * p) : 0.0f;
+    Matrix hidden(first.get_dims().rows, 1), next(second.get_dims().rows, 1);
+    std::vector<int> nz(hidden.get_rows());
+    int nnz = first.forward(img, nullptr, 0, hidden, nz.data());
+    int expected_nnz = 0;
+    for (int r = 0; r < hidden.get_rows(); ++r)
+    {
+        if (hidden[r] != 0.0f && (expected_nnz >= nnz
+                                  || nz[expected_nnz++] != r))
+            return 2;
+    }
+    if (nnz != expected_nnz || nnz == hidden.get_rows())
+        return 3;
+    second.forward(hidden, nz.data(), nnz, next, nullptr);
+    Matrix reference = second(hidden);
+    if (check_equal(reference, next))
+        return 4;
+
+    // single images (sparse chain) agree with the dense batch path, and
+    // every layer counts the images and nonzeros it saw
+    mlp.reset_sparsity();
+    const int images = 5;
+    Matrix batch(IMG_ROWS * IMG_COLS, images);
+    long long lit = 0;
+    Workspace ws(mlp);
+    for (int n = 0; n < images; ++n)
+    {
+        for (int p = 0; p < img.get_rows(); ++p)
+        {
+            img[p] = (p % (n + 3) == 0) ? 0.1f * (n + 1) : 0.0f;
+            batch(p, n) = img[p];
+            lit += img[p] != 0.0f ? 1 : 0;
+        }
+        mlp(img, ws);
+    }
+    const std::vector<digit>& batched = mlp.classify_batch(batch);
+    for (int n = 0; n < images; ++n)
+    {
+        for (int p = 0; p < img.get_rows(); ++p)
+            img[p] = batch(p, n);
+        digit single = mlp(img, ws);
+        if (single.value != batched[n].value
+            || !float_compare(single.probability, batched[n].probability))
+            return 5;
+    }
+    for (int i = 0; i < MLP_SIZE; ++i)
+    {
+        sparsity_stats stats = mlp.get_layer(i).get_sparsity();
+        long long width = mlp.get_layer(i).get_dims().cols;
+        if (stats.inputs != 2 * images || stats.sparse > stats.inputs
+            || stats.nonzeros > stats.inputs * width)
+            return 6;
+    }
+    sparsity_stats input_stats = first.get_sparsity();
+    if (input_stats.nonzeros != 2 * lit || input_stats.sparse != 2 * images)
+        return 7;
+
+    // copies keep the totals, resets clear them
+    Dense copy = first;
+    mlp.reset_sparsity();
+    if (copy.get_sparsity().inputs != 2 * images
+        || first.get_sparsity().inputs != 0)
+        return 8;
+
+    // a Workspace planned for a narrower network refuses a wider layer,
+    // even when one image of it would fit the slot padded for a batch
+    const int pixels = IMG_ROWS * IMG_COLS;
+    MlpNetwork narrow(std::vector<Dense>{
+            Dense(Matrix(16, pixels), Matrix(16, 1), activation::relu),
+            Dense(Matrix(10, 16), Matrix(10, 1), activation::softmax)});
+    Matrix wide_bias(1000, 1);
+    fill_random(wide_bias, 14);
+    MlpNetwork wide(std::vector<Dense>{
+            Dense(Matrix(1000, pixels), wide_bias, activation::relu),
+            Dense(Matrix(10, 1000), Matrix(10, 1), activation::softmax)});
+    wide.enable_sparse_input();
+    Workspace planned(narrow, 64);
+    try { wide(img, planned); return 9; }
+    catch (const std::invalid_argument&) {}
+    return 0;
+}
+
+int test_dense_backward()
+{
+    // L = sum(R .* relu(W A + b)) for a fixed R, so dL/d(out) = R;
+    // compare the analytic gradients with central differences
+    const int m = 5, k = 7, n = 3;
+    Matrix W(m, k), b(m, 1), A(k, n), R(m, n);
+    fill_random(W, 21);
+    fill_random(b, 22);
+    fill_random(A, 23);
+    fill_random(R, 24);
+    auto loss = [&](const Matrix& Wx, const Matrix& bx, const Matrix& Ax) {
+        Matrix out = Dense(Wx, bx, activation::relu)(Ax);
+        return Matrix(out.dot(R)).sum();
+    };
+
+    Dense layer(W, b, activation::relu);
+    Matrix out = layer(A), delta = R, grad_w(m, k), grad_b(m, 1), grad_a(k, n);
+    layer.backward(A, out, delta, grad_w, grad_b, &grad_a);
+
+    const float h = 1e-2f;
+    auto numeric = [&](Matrix& X, int idx) {
+        const float saved = X[idx];
+        X[idx] = saved + h;
+        float up = loss(W, b, A);
+        X[idx] = saved - h;
+        float down = loss(W, b, A);
+        X[idx] = saved;
+        return (up - down) / (2 * h);
+    };
+    for (int i = 0; i < m * k; ++i)
+        if (std::fabs(numeric(W, i) - grad_w[i]) > 1e-2f)
+            return 1;
+    for (int i = 0; i < m; ++i)
+        if (std::fabs(numeric(b, i) - grad_b[i]) > 1e-2f)
+            return 2;
+    for (int i = 0; i < k * n; ++i)
+        if (std::fabs(numeric(A, i) - grad_a[i]) > 1e-2f)
+            return 3;
+
+    // only ReLU and softmax layers have a backward pass
+    Dense custom(W, b, [](const Matrix& M) { return Matrix(M); });
+    try { custom.backward(A, out, delta, grad_w, grad_b, nullptr); return 4; }
+    catch (const std::invalid_argument&) {}
+    return 0;
+}
+
+// helper: `count` points around one of `classes` centres per column
+void make_clusters(Matrix& samples, std::vector<std::uint8_t>& labels,
+                   int classes, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.0f, 0.3f);
+    Matrix centres(samples.get_rows(), classes);
+    fill_random(centres, seed + 1);
+    labels.resize(samples.get_cols());
+    for (int j = 0; j < samples.get_cols(); ++j)
+    {
+        labels[j] = static_cast<std::uint8_t>(j % classes);
+        for (int p = 0; p < samples.get_rows(); ++p)
+            samples(p, j) = centres(p, labels[j]) + noise(gen);
+    }
+}
+
+int test_training()
+{
+    const int inputs = 16, classes = 4, count = 400;
+    Matrix samples(inputs, count);
+    std::vector<std::uint8_t> labels;
+    make_clusters(samples, labels, classes, 31);
+
+    // Adam on four workers learns the clusters
+    train_options options;
+    options.batch_size = 32;
+    options.threads = 4;
+    options.learning_rate = 1e-2f;
+    Trainer trainer({inputs, 24, classes}, options);
+    float first = trainer.train_epoch(samples, labels), last = first;
+    for (int epoch = 0; epoch < 4; ++epoch)
+        last = trainer.train_epoch(samples, labels);
+    if (!(last < 0.5f * first) || trainer.get_steps() != 5 * 13)
+        return 1;
+    MlpNetwork mlp = trainer.network();
+    const std::vector<digit>& predicted = mlp.classify_batch(samples);
+    int correct = 0;
+    for (int j = 0; j < count; ++j)
+        correct += predicted[j].value == labels[j] ? 1 : 0;
+    if (correct < 0.95 * count)
+        return 2;
+
+    // the data-parallel gradient is the single-threaded one, up to the
+    // summation order of the tree reduction
+    Matrix batch(inputs, 30);
+    for (int p = 0; p < inputs; ++p)
+        for (int j = 0; j < 30; ++j)
+            batch(p, j) = samples(p, j);
+    train_options sgd;
+    sgd.method = optimizer::sgd;
+    sgd.learning_rate = 0.1f;
+    sgd.threads = 1;
+    Trainer serial(mlp, sgd);
+    sgd.threads = 3;
+    Trainer parallel(mlp, sgd);
+    float serial_loss = serial.step(batch, labels.data());
+    float parallel_loss = parallel.step(batch, labels.data());
+    if (!float_compare(serial_loss, parallel_loss))
+        return 3;
+    MlpNetwork a = serial.network(), b = parallel.network();
+    for (int i = 0; i < a.get_layer_count(); ++i)
+    {
+        Matrix wa = a.get_layer(i).get_weights();
+        Matrix wb = b.get_layer(i).get_weights();
+        if (check_equal(wa, wb))
+            return 4;
+    }
+
+    // out-of-range labels are rejected before any update
+    std::vector<std::uint8_t> bad(30, classes);
+    try { serial.step(batch, bad.data()); return 5; }
+    catch (const std::invalid_argument&) {}
+    if (serial.get_steps() != 1)
+        return 6;
+
+    // saved in the raw layer-file layout: weights, then biases
+    TempFiles temp;
+    std::vector<std::string> files;
+    for (int i = 0; i < 4; ++i)
+        files.push_back(temp.add("trained" + std::to_string(i) + ".bin"));
+    trainer.save(files);
+    for (int i = 0; i < 4; ++i)
+    {
+        const Matrix& M = i < 2 ? mlp.get_layer(i).get_weights()
+                                : mlp.get_layer(i - 2).get_bias();
+        std::ifstream in(files[i], std::ios::binary);
+        std::vector<float> raw(M.get_rows() * M.get_cols() + 1);
+        in.read(reinterpret_cast<char*>(raw.data()),
+                raw.size() * sizeof(float));
+        if (in.gcount() != static_cast<std::streamsize>(
+                (raw.size() - 1) * sizeof(float))
+            || !std::equal(M.data(), M.data() + raw.size() - 1, raw.data()))
+            return 7;
+    }
+    return 0;
+}
+
+int test_inference_server()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    TempFiles files;
+    const std::string path = files.add("server.sock");
+
+    server_options bad;
+    bad.max_batch = 0;
+    try { InferenceServer server(mlp, path, bad); return 1; }
+    catch (const std::invalid_argument&) {}
+    try { InferenceServer server(mlp, std::string(200, 'x')); return 2; }
+    catch (const std::invalid_argument&) {}
+
+    // a regular file at the path is refused and kept
+    std::ofstream(path) << "not a socket";
+    try { InferenceServer server(mlp, path); return 6; }
+    catch (const std::runtime_error&) {}
+    if (!std::filesystem::is_regular_file(path))
+        return 6;
+    std::remove(path.c_str());
+
+    // the socket file of a server that is gone is replaced
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (::bind(stale, reinterpret_cast<const sockaddr*>(&address),
+               sizeof(address)) != 0)
+        return 7;
+    ::close(stale);
+    try { InferenceServer server(mlp, path); }
+    catch (const std::runtime_error&) { return 7; }
+
+    // a long deadline, so the pipelined requests of several clients are
+    // coalesced into batches of up to max_batch
+    server_options options;
+    options.max_batch = 8;
+    options.max_delay_us = 20000;
+    options.workers = 2;
+    InferenceServer server(mlp, path, options);
+
+    // a live server's socket is left alone
+    try { InferenceServer second(mlp, path); return 8; }
+    catch (const std::runtime_error&) {}
+
+    const int clients = 3, per_client = 20;
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; ++c)
+    {
+        threads.emplace_back([&, c] {
+            try
+            {
+                InferenceClient client(path);
+                std::vector<Matrix> images;
+                for (int i = 0; i < per_client; ++i)
+                {
+                    images.emplace_back(IMG_ROWS * IMG_COLS, 1);
+                    fill_random(images.back(), 100 * c + i);
+                    if (client.send(images.back()) != static_cast<unsigned>(i))
+                        failures++;
+                }
+                // replies may overtake each other across the two workers
+                std::vector<int> seen(per_client, 0);
+                for (int i = 0; i < per_client; ++i)
+                {
+                    server_response reply = client.receive();
+                    if (reply.sequence >= static_cast<unsigned>(per_client)
+                        || seen[reply.sequence]++)
+                    {
+                        failures++;
+                        continue;
+                    }
+                    digit expected = mlp(images[reply.sequence]);
+                    if (reply.value != expected.value
+                        || !float_compare(reply.probability,
+                                          expected.probability))
+                        failures++;
+                }
+                digit one = client.classify(images[0]);
+                if (one.value != mlp(images[0]).value)
+                    failures++;
+            }
+            catch (const std::exception&)
+            {
+                failures++;
+            }
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    if (failures != 0)
+        return 3;
+
+    server.stop();
+    server_stats stats = server.get_stats();
+    if (stats.requests != clients * (per_client + 1)
+        || stats.batches >= stats.requests)
+        return 4;
+    server.stop();                                      // idempotent
+    try { InferenceClient late(path); return 5; }       // socket removed
+    catch (const std::runtime_error&) {}
+
+    // a client that never reads its replies stops being read (and blocks
+    // on its socket buffer) while another client is still served; the
+    // queue stays within max_queue
+    server_options tight;
+    tight.max_batch = 4;
+    tight.max_delay_us = 1000;
+    tight.max_queue = 16;
+    tight.max_pending = 4;
+    InferenceServer throttled(mlp, path, tight);
+    const int flood = 4000;                 // far more than socket buffers
+    Matrix img(IMG_ROWS * IMG_COLS, 1);
+    fill_random(img, 21);
+    const digit expected = mlp(img);
+    InferenceClient greedy(path);
+    std::atomic<int> flooded{0};
+    std::thread flooder([&] {
+        try
+        {
+            for (int i = 0; i < flood; ++i, ++flooded)
+                greedy.send(img);
+        }
+        catch (const std::exception&)
+        {
+            failures++;
+        }
+    });
+    int last = -1;
+    for (int polls = 0; polls < 200 && flooded != last; ++polls)
+    {
+        last = flooded;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    const bool blocked = flooded < flood;
+    InferenceClient polite(path);
+    const digit answer = polite.classify(img);
+    std::vector<int> seen(flood, 0);
+    for (int i = 0; i < flood; ++i)
+    {
+        server_response reply = greedy.receive();
+        if (reply.sequence >= static_cast<unsigned>(flood)
+            || seen[reply.sequence]++ || reply.value != expected.value)
+            failures++;
+    }
+    flooder.join();
+    if (!blocked || answer.value != expected.value || failures != 0)
+        return 9;
+    throttled.stop();
+    if (throttled.get_stats().peak_queue > tight.max_queue
+        || throttled.get_stats().requests != flood + 1)
+        return 10;
+    return 0;
+}
+
+int test_spsc_queue()
+{
+    try { SpscQueue<int> empty(0); return 1; }
+    catch (const std::invalid_argument&) {}
+    SpscQueue<int> small(3);
+    if (small.capacity() != 4)
+        return 2;
+    for (int i = 0; i < 4; ++i)
+        if (!small.try_push(std::move(i)))
+            return 3;
+    int v = 99;
+    if (small.try_push(std::move(v)) || v != 99)        // full: untouched
+        return 4;
+
+    // a producer much faster than the ring is deep: every item arrives
+    // once, in order
+    const int count = 100000;
+    SpscQueue<std::vector<int>> queue(8);
+    long long mismatches = 0;
+    std::thread consumer([&] {
+        std::vector<int> item;
+        for (int i = 0; i < count; ++i)
+        {
+            queue.pop(item);
+            if (item.size() != 1 || item[0] != i)
+                mismatches++;
+        }
+    });
+    for (int i = 0; i < count; ++i)
+        queue.push(std::vector<int>{i});
+    consumer.join();
+    if (mismatches != 0)
+        return 5;
+    std::vector<int> rest;
+    if (queue.try_pop(rest))
+        return 6;
+
+    // an end left waiting blocks once (instead of napping over and over),
+    // and the other end's next push wakes it
+    SpscQueue<int> idle(4);
+    rusage waited{};
+    int received = 0;
+    std::thread sleeper([&] {
+        idle.pop(received);
+        getrusage(RUSAGE_THREAD, &waited);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    int value = 7;
+    idle.push(std::move(value));
+    sleeper.join();
+    if (received != 7)
+        return 7;
+    return waited.ru_nvcsw < 50 ? 0 : 8;
+}
+
+int test_stream_classifier()
+{
+    Matrix weights[MLP_SIZE], biases[MLP_SIZE];
+    make_test_params(weights, biases);
+    MlpNetwork mlp(weights, biases);
+    try { StreamClassifier bad(mlp, 0); return 1; }
+    catch (const std::invalid_argument&) {}
+
+    TempFiles temp;
+    const int count = 40;
+    std::vector<std::string> paths;
+    std::vector<Matrix> images;
+    for (int i = 0; i < count; ++i)
+    {
+        if (i % 7 == 3)
+        {
+            paths.push_back(temp_path("stream_missing.bin"));
+            images.emplace_back();
+            continue;
+        }
+        images.emplace_back(IMG_ROWS * IMG_COLS, 1);
+        fill_random(images.back(), 500 + i);
+        paths.push_back(temp.add("stream" + std::to_string(i) + ".bin"));
+        write_raw(paths.back(), images.back());
+    }
+
+    // small batches and shallow queues, so every stage has to wait on
+    // the others; results come back in order, unreadable files as !ok
+    StreamClassifier stream(mlp, 4, 2);
+    int rc = 0;
+    for (int pass = 0; pass < 2 && rc == 0; ++pass)    // reusable
+    {
+        std::size_t next = 0;
+        int emitted = 0;
+        stream.run(
+                [&](std::string& path) {
+                    if (next == paths.size())
+                        return false;
+                    path = paths[next++];
+                    return true;
+                },
+                [&](const std::string& path, const batch_result& res) {
+                    const int i = emitted++;
+                    if (rc != 0)
+                        return;
+                    if (i >= count || path != paths[i]
+                        || res.ok != (i % 7 != 3))
+                        rc = 2;
+                    else if (res.ok
+                             && (res.prediction.value != mlp(images[i]).value
+                                 || !float_compare(
+                                         res.prediction.probability,
+                                         mlp(images[i]).probability)))
+                        rc = 3;
+                });
+        if (rc == 0 && emitted != count)
+            rc = 4;
+    }
+
+    // a failing sink surfaces from run() once the stages have stopped
+    if (rc == 0)
+    {
+        std::size_t next = 0;
+        try
+        {
+            stream.run(
+                    [&](std::string& path) {
+                        if (next == paths.size())
+                            return false;
+                        path = paths[next++];
+                        return true;
+                    },
+                    [](const std::string&, const batch_result&) {
+                        throw std::runtime_error("sink");
+                    });
+            rc = 5;
+        }
+        catch (const std::runtime_error&) {}
+        if (rc == 0 && next != paths.size())
+            rc = 6;
+    }
+
+    // a failing network (here: grown past the Workspace planned for it)
+    // stops the other stages and surfaces from run()
+    if (rc == 0)
+    {
+        MlpNetwork narrow(std::vector<Dense>{
+                Dense(Matrix(4, IMG_ROWS * IMG_COLS), Matrix(4, 1),
+                      activation::relu),
+                Dense(Matrix(10, 4), Matrix(10, 1), activation::softmax)});
+        StreamClassifier failing(narrow, 4, 2);
+        narrow = mlp;
+        int emitted = 0;
+        try
+        {
+            std::size_t next = 0;
+            failing.run(
+                    [&](std::string& path) {
+                        if (next == paths.size())
+                            return false;
+                        path = paths[next++];
+                        return true;
+                    },
+                    [&](const std::string&, const batch_result&) {
+                        emitted++;
+                    });
+            rc = 7;
+        }
+        catch (const std::invalid_argument&) {}
+        if (rc == 0 && emitted != 0)
+            rc = 8;
+    }
+    return rc;
+}
+
+int test_rref_simple()
+{
+    float arr[] = {1,2,3, 4,5,6};
+    float sol[] = {1,0,-1, 0,1,2};
+    return test_reduced_matrix(arr, sol, 2, 3);            // 0 on success
+}
+
+int run_unit_tests()
+{
+    int rc = test_transpose();
+    if (rc) { std::cerr << "Transpose test failed\n"; return rc; }
+
+    rc = test_matrix_read();
+    if (rc) { std::cerr << "Matrix-read test failed\n"; return rc; }
+
+    rc = test_matrix_multiply();
+    if (rc) { std::cerr << "Multiply test failed\n"; return rc; }
+
+    rc = test_elementwise();
+    if (rc) { std::cerr << "Element-wise test failed\n"; return rc; }
+
+    rc = test_expression_templates();
+    if (rc) { std::cerr << "Expression-template test failed\n"; return rc; }
+
+    rc = test_dense_fused();
+    if (rc) { std::cerr << "Fused Dense test failed\n"; return rc; }
+
+    rc = test_batch_inference();
+    if (rc) { std::cerr << "Batch inference test failed\n"; return rc; }
+
+    rc = test_zero_allocation_inference();
+    if (rc) { std::cerr << "Zero-allocation test failed\n"; return rc; }
+
+    rc = test_thread_pool();
+    if (rc) { std::cerr << "Thread-pool test failed\n"; return rc; }
+
+    rc = test_batch_classifier();
+    if (rc) { std::cerr << "Batch classifier test failed\n"; return rc; }
+
+    rc = test_mapped_weights();
+    if (rc) { std::cerr << "Mapped-weights test failed\n"; return rc; }
+
+    rc = test_model_file();
+    if (rc) { std::cerr << "Model-file test failed\n"; return rc; }
+
+    rc = test_quantized_inference();
+    if (rc) { std::cerr << "INT8 inference test failed\n"; return rc; }
+
+    rc = test_network_depth();
+    if (rc) { std::cerr << "Network-depth test failed\n"; return rc; }
+
+    rc = test_move_semantics();
+    if (rc) { std::cerr << "Move-semantics test failed\n"; return rc; }
+
+    rc = test_static_network();
+    if (rc) { std::cerr << "Static-network test failed\n"; return rc; }
+
+    rc = test_stable_softmax();
+    if (rc) { std::cerr << "Stable softmax test failed\n"; return rc; }
+
+    rc = test_blocked_transpose();
+    if (rc) { std::cerr << "Blocked transpose test failed\n"; return rc; }
+
+    rc = test_linear_solve();
+    if (rc) { std::cerr << "Linear solve test failed\n"; return rc; }
+
+    rc = test_accessors();
+    if (rc) { std::cerr << "Accessor test failed\n"; return rc; }
+
+    rc = test_idx_reader();
+    if (rc) { std::cerr << "IDX reader test failed\n"; return rc; }
+
+    rc = test_sparse_input();
+    if (rc) { std::cerr << "Sparse input test failed\n"; return rc; }
+
+    rc = test_activation_sparsity();
+    if (rc) { std::cerr << "Activation sparsity test failed\n"; return rc; }
+
+    rc = test_dense_backward();
+    if (rc) { std::cerr << "Dense backward test failed\n"; return rc; }
+
+    rc = test_training();
+    if (rc) { std::cerr << "Training test failed\n"; return rc; }
+
+    rc = test_inference_server();
+    if (rc) { std::cerr << "Inference server test failed\n"; return rc; }
+
+    rc = test_spsc_queue();
+    if (rc) { std::cerr << "SPSC queue test failed\n"; return rc; }
+
+    rc = test_stream_classifier();
+    if (rc) { std::cerr << "Stream classifier test failed\n"; return rc; }
+
+    rc = test_rref_simple();
+    if (rc) { std::cerr << "RREF test failed\n";       return rc; }
+
+    std::cout << "All tests passed\n";
+    return EXIT_SUCCESS;
+}
+
+
+// entry point selector
+int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
+{
+    #ifdef RUN_CLI
+        return run_cli(argc, argv);
+    #else
+        // an exception escaping a test fails the run instead of terminating
+        try
+        {
+            return run_unit_tests();
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << "Unit test threw: " << ex.what() << '\n';
+            return EXIT_FAILURE;
+        }
     #endif
 }
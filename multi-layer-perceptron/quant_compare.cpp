@@ -0,0 +1,171 @@
+/**
+ * Accuracy check of the INT8 inference mode: classifies every image with
+ * both the fp32 MlpNetwork and its QuantizedNetwork and reports how often
+ * the predicted digits agree, how far the reported probabilities drift,
+ * and the throughput and weight footprint of each path.
+ */
+// quant_compare.cpp - build with the mlp_quant_compare target
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+#include "MlpNetwork.h"
+#include "Workspace.h"
+#include "QuantizedNetwork.h"
+#include "BatchClassifier.h"
+#include "MappedWeights.h"
+#include "ModelFile.h"
+
+const char USAGE[] =
+        "Usage: ./mlp_quant_compare (--model <file> | w1 w2 w3 w4 b1 b2 b3 b4) "
+        "<list-file|dir>\n";
+
+// helper: the images as the columns of one pixels x N batch
+bool read_batch(const std::vector<std::string>& paths, Matrix& batch)
+{
+    const int n = static_cast<int>(paths.size());
+    Matrix img(batch.get_rows(), 1);
+    for (int col = 0; col < n; col++)
+    {
+        std::ifstream in(paths[col], std::ios::binary);
+        in.read(reinterpret_cast<char*>(img.data()),
+                img.get_rows() * sizeof(float));
+        if (!in)
+        {
+            std::cerr << "Error: cannot open '" << paths[col] << "'\n";
+            return false;
+        }
+        for (int p = 0; p < img.get_rows(); p++)
+        {
+            batch.data()[p * n + col] = img.data()[p];
+        }
+    }
+    return true;
+}
+
+// helper: seconds taken by f()
+template<typename F>
+double seconds(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    const bool packed = args.size() == 3 && args[0] == "--model";
+    if (!packed && args.size() != 2 * MLP_SIZE + 1)
+    {
+        std::cerr << USAGE;
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<ModelFile> model;
+    std::unique_ptr<MappedWeights> mapped;
+    std::vector<std::string> paths;
+    try
+    {
+        if (packed)
+        {
+            model = std::make_unique<ModelFile>(args[1]);
+        }
+        else
+        {
+            mapped = std::make_unique<MappedWeights>(std::vector<std::string>(
+                    args.begin(), args.begin() + 2 * MLP_SIZE));
+        }
+        paths = BatchClassifier::list_images(args.back());
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    MlpNetwork mlp = model ? MlpNetwork(model->get_weights(),
+                                        model->get_biases(),
+                                        model->get_activations(),
+                                        model->get_layer_count())
+                           : MlpNetwork(mapped->get_weights(),
+                                        mapped->get_biases());
+    QuantizedNetwork quantized(mlp);
+
+    if (paths.empty())
+    {
+        std::cerr << USAGE;
+        return EXIT_FAILURE;
+    }
+    Matrix batch(mlp.get_input_size(), static_cast<int>(paths.size()));
+    if (!read_batch(paths, batch))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<digit> reference, int8;
+    double fp32_time = seconds([&] { reference = mlp.classify_batch(batch); });
+    Workspace ws(mlp);
+    Matrix img(batch.get_rows(), 1);
+    double fp32_single_time = seconds([&] {
+        for (int col = 0; col < batch.get_cols(); col++)
+        {
+            for (int p = 0; p < img.get_rows(); p++)
+            {
+                img.data()[p] = batch.data()[p * batch.get_cols() + col];
+            }
+            mlp(img, ws);
+        }
+    });
+    double int8_time = seconds([&] { int8 = quantized.classify_batch(batch); });
+
+    int agree = 0;
+    double max_drift = 0.0, sum_drift = 0.0;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (reference[i].value == int8[i].value)
+        {
+            ++agree;
+            double drift = std::abs(reference[i].probability
+                                    - int8[i].probability);
+            max_drift = std::max(max_drift, drift);
+            sum_drift += drift;
+        }
+        else
+        {
+            std::cout << paths[i] << ": fp32 " << reference[i].value
+                      << " (p = " << reference[i].probability << "), int8 "
+                      << int8[i].value << " (p = " << int8[i].probability
+                      << ")\n";
+        }
+    }
+
+    std::size_t fp32_bytes = 0;
+    for (int i = 0; i < mlp.get_layer_count(); i++)
+    {
+        matrix_dims dims = mlp.get_layer(i).get_dims();
+        fp32_bytes += static_cast<std::size_t>(dims.rows) * dims.cols
+                      * sizeof(float);
+    }
+
+    const double n = static_cast<double>(paths.size());
+    std::cout << std::fixed << std::setprecision(2)
+              << "images:           " << paths.size() << '\n'
+              << "top-1 agreement:  " << 100.0 * agree / n << "%\n"
+              << std::setprecision(5)
+              << "probability drift (agreeing images): mean "
+              << (agree ? sum_drift / agree : 0.0) << ", max " << max_drift
+              << '\n' << std::setprecision(0)
+              << "fp32 batched:   " << std::setw(10) << n / fp32_time
+              << " img/s, " << fp32_bytes << " weight bytes\n"
+              << "fp32 per image: " << std::setw(10) << n / fp32_single_time
+              << " img/s\n"
+              << "int8 per image: " << std::setw(10) << n / int8_time
+              << " img/s, "
+              << quantized.weight_bytes() << " weight bytes\n";
+    return EXIT_SUCCESS;
+}